@@ -1,8 +1,30 @@
+#include <algorithm>
+#include <array>
 #include <benchmark/benchmark.h>
+#include <chrono>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <optional>
 #include <random>
 #include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_set>
 
+#include "concurrent-sparse-set.hpp"
+#include "direct-sparse-set.hpp"
+#include "handle-key-set.hpp"
+#include "lockfree-sparse-set.hpp"
+#include "mapped-arena.hpp"
+#include "shared-sparse-set.hpp"
+#include "snapshot-sparse-set.hpp"
+#include "sparse-group-set.hpp"
+#include "sparse-key-set.hpp"
 #include "sparse-set.hpp"
 
 // Random number generator setup
@@ -19,6 +41,43 @@ static std::vector<int> generate_random_ints(size_t count, int min = 0, int max
     return result;
 }
 
+// Generate random strings long enough to defeat small-string optimisation
+static std::vector<std::string>
+generate_random_strings(size_t count, int min = 0, int max = 1000000) {
+    std::vector<std::string> result;
+    result.reserve(count);
+    for (int val : generate_random_ints(count, min, max)) {
+        result.push_back("sparse-set-benchmark-key-" + std::to_string(val));
+    }
+    return result;
+}
+
+// Allocator that tracks live bytes, used to report container memory footprint
+static size_t allocated_bytes = 0;
+
+template <class T>
+struct counting_allocator {
+    using value_type = T;
+
+    counting_allocator() = default;
+    template <class U>
+    counting_allocator(const counting_allocator<U> &) {}
+
+    auto allocate(size_t n) -> T * {
+        allocated_bytes += n * sizeof(T);
+        return std::allocator<T>{}.allocate(n);
+    }
+    auto deallocate(T *p, size_t n) -> void {
+        allocated_bytes -= n * sizeof(T);
+        std::allocator<T>{}.deallocate(p, n);
+    }
+
+    template <class U>
+    auto operator==(const counting_allocator<U> &) const -> bool {
+        return true;
+    }
+};
+
 // ============================================================================
 // INSERTION BENCHMARKS
 // ============================================================================
@@ -66,6 +125,60 @@ BENCHMARK(BM_SparseSet_Insert)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_StdSet_Insert)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_UnorderedSet_Insert)->Range(64, 1 << 16)->Complexity();
 
+// ============================================================================
+// BULK LOAD BENCHMARKS
+// ============================================================================
+
+// Distinct keys so the unchecked path loads the same contents as the checked ones
+static std::vector<int> generate_distinct_ints(size_t count) {
+    auto data = generate_random_ints(count, 0, std::numeric_limits<int>::max());
+    std::ranges::sort(data);
+    data.erase(std::ranges::unique(data).begin(), data.end());
+    std::ranges::shuffle(data, rng);
+    return data;
+}
+
+static void BM_SparseSet_BulkLoad_SingleInserts(benchmark::State &state) {
+    auto data = generate_distinct_ints(state.range(0));
+
+    for (auto _ : state) {
+        sparse_set<int> s;
+        for (int val : data) {
+            benchmark::DoNotOptimize(s.insert(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+}
+
+static void BM_SparseSet_BulkLoad_InsertRange(benchmark::State &state) {
+    auto data = generate_distinct_ints(state.range(0));
+
+    for (auto _ : state) {
+        sparse_set<int> s;
+        s.insert_range(data);
+        benchmark::DoNotOptimize(s.size());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+}
+
+static void BM_SparseSet_BulkLoad_Unchecked(benchmark::State &state) {
+    auto data = generate_distinct_ints(state.range(0));
+
+    for (auto _ : state) {
+        sparse_set<int> s;
+        s.insert_unique_unchecked(data);
+        benchmark::DoNotOptimize(s.size());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(data.size()));
+}
+
+BENCHMARK(BM_SparseSet_BulkLoad_SingleInserts)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_SparseSet_BulkLoad_InsertRange)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_SparseSet_BulkLoad_Unchecked)->Range(1 << 10, 1 << 20);
+
 // ============================================================================
 // LOOKUP BENCHMARKS (with data present)
 // ============================================================================
@@ -178,9 +291,144 @@ static void BM_UnorderedSet_Find_Miss(benchmark::State &state) {
 }
 
 BENCHMARK(BM_SparseSet_Find_Miss)->Range(64, 1 << 16)->Complexity();
+
+static void BM_SparseSet_Find_Miss_String(benchmark::State &state) {
+    auto                    data      = generate_random_strings(state.range(0));
+    auto                    miss_data = generate_random_strings(state.range(0), 2000000, 3000000);
+    sparse_set<std::string> s;
+    for (const auto &val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (const auto &val : miss_data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(state.range(0));
+}
+
+static void BM_SparseKeySet_Find_Miss_String(benchmark::State &state) {
+    auto data      = generate_random_strings(state.range(0));
+    auto miss_data = generate_random_strings(state.range(0), 2000000, 3000000);
+    sparse_key_set<std::string, int> s;
+    for (const auto &val : data) {
+        s.insert(val, 0);
+    }
+
+    for (auto _ : state) {
+        for (const auto &val : miss_data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(state.range(0));
+}
+
+static void BM_UnorderedSet_Find_Miss_String(benchmark::State &state) {
+    auto data      = generate_random_strings(state.range(0));
+    auto miss_data = generate_random_strings(state.range(0), 2000000, 3000000);
+    std::unordered_set<std::string> s;
+    for (const auto &val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (const auto &val : miss_data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_SparseSet_Find_Miss_String)->Range(64, 1 << 16)->Complexity();
+BENCHMARK(BM_SparseKeySet_Find_Miss_String)->Range(64, 1 << 16)->Complexity();
+BENCHMARK(BM_UnorderedSet_Find_Miss_String)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_StdSet_Find_Miss)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_UnorderedSet_Find_Miss)->Range(64, 1 << 16)->Complexity();
 
+// ============================================================================
+// STRING VIEW LOOKUP BENCHMARKS
+// ============================================================================
+
+// Half hits, half misses, all as views into one buffer like keys parsed out of a request
+static auto generate_string_views(const std::vector<std::string> &data, std::string &buffer)
+    -> std::vector<std::string_view> {
+    auto misses = generate_random_strings(data.size(), 2000000, 3000000);
+    for (size_t i = 0; i < data.size(); ++i) {
+        buffer += (i % 2 == 0 ? data[i] : misses[i]);
+    }
+
+    std::vector<std::string_view> views;
+    size_t                        offset = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        size_t len = (i % 2 == 0 ? data[i] : misses[i]).size();
+        views.emplace_back(buffer.data() + offset, len);
+        offset += len;
+    }
+    return views;
+}
+
+static void BM_SparseSet_Find_StringView_Convert(benchmark::State &state) {
+    auto                    data = generate_random_strings(state.range(0));
+    std::string             buffer;
+    auto                    views = generate_string_views(data, buffer);
+    sparse_set<std::string> s;
+    for (const auto &val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (auto view : views) {
+            benchmark::DoNotOptimize(s.find(std::string(view)));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_SparseSet_Find_StringView_Transparent(benchmark::State &state) {
+    auto        data = generate_random_strings(state.range(0));
+    std::string buffer;
+    auto        views = generate_string_views(data, buffer);
+    sparse_set<std::string, string_hash, std::equal_to<>> s;
+    for (const auto &val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (auto view : views) {
+            benchmark::DoNotOptimize(s.find(view));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_UnorderedSet_Find_StringView_Transparent(benchmark::State &state) {
+    auto        data = generate_random_strings(state.range(0));
+    std::string buffer;
+    auto        views = generate_string_views(data, buffer);
+    std::unordered_set<std::string, string_hash, std::equal_to<>> s;
+    for (const auto &val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (auto view : views) {
+            benchmark::DoNotOptimize(s.find(view));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_SparseSet_Find_StringView_Convert)->Range(64, 1 << 16);
+BENCHMARK(BM_SparseSet_Find_StringView_Transparent)->Range(64, 1 << 16);
+BENCHMARK(BM_UnorderedSet_Find_StringView_Transparent)->Range(64, 1 << 16);
+
 // ============================================================================
 // CONTAINS BENCHMARKS
 // ============================================================================
@@ -237,6 +485,98 @@ BENCHMARK(BM_SparseSet_Contains)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_StdSet_Contains)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_UnorderedSet_Contains)->Range(64, 1 << 16)->Complexity();
 
+// ============================================================================
+// BATCHED LOOKUP BENCHMARKS (working set well beyond the last level cache)
+// ============================================================================
+
+static constexpr size_t batch_probe_count = 4096;
+
+// Half hits, half misses drawn uniformly over the whole set so nearly every probe misses cache
+static std::vector<int> generate_batch_probes(const std::vector<int> &data) {
+    std::vector<int> probes;
+    probes.reserve(batch_probe_count);
+    std::uniform_int_distribution<size_t> pick(0, data.size() - 1);
+    for (size_t i = 0; i < batch_probe_count; ++i) {
+        probes.push_back(i % 2 == 0 ? data[pick(rng)] : -static_cast<int>(pick(rng)) - 1);
+    }
+    return probes;
+}
+
+static void BM_SparseSet_Contains_OneByOne(benchmark::State &state) {
+    auto            data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    sparse_set<int> s;
+    s.insert_range(data);
+    auto probes = generate_batch_probes(data);
+
+    for (auto _ : state) {
+        size_t hits = 0;
+        for (int val : probes) {
+            hits += s.contains(val) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+static void BM_SparseSet_Contains_Many(benchmark::State &state) {
+    auto            data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    sparse_set<int> s;
+    s.insert_range(data);
+    auto                                probes = generate_batch_probes(data);
+    std::array<bool, batch_probe_count> out{};
+
+    for (auto _ : state) {
+        s.contains_many(probes, out);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+static void BM_SparseKeySet_Find_OneByOne(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    sparse_key_set<int, int> m;
+    for (int val : data) {
+        m.insert(val, val);
+    }
+    auto probes = generate_batch_probes(data);
+
+    for (auto _ : state) {
+        int sum = 0;
+        for (int val : probes) {
+            auto it = m.find(val);
+            if (it != m.end()) sum += *it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+static void BM_SparseKeySet_Find_Many(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    sparse_key_set<int, int> m;
+    for (int val : data) {
+        m.insert(val, val);
+    }
+    auto                                            probes = generate_batch_probes(data);
+    std::vector<sparse_key_set<int, int>::iterator> out(probes.size());
+
+    for (auto _ : state) {
+        m.find_many(probes, out);
+        int sum = 0;
+        for (auto it : out) {
+            if (it != m.end()) sum += *it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+BENCHMARK(BM_SparseSet_Contains_OneByOne)->RangeMultiplier(8)->Range(1 << 16, 1 << 24);
+BENCHMARK(BM_SparseSet_Contains_Many)->RangeMultiplier(8)->Range(1 << 16, 1 << 24);
+BENCHMARK(BM_SparseKeySet_Find_OneByOne)->RangeMultiplier(8)->Range(1 << 16, 1 << 24);
+BENCHMARK(BM_SparseKeySet_Find_Many)->RangeMultiplier(8)->Range(1 << 16, 1 << 24);
+
 // ============================================================================
 // ERASE BENCHMARKS
 // ============================================================================
@@ -260,6 +600,45 @@ static void BM_SparseSet_Erase(benchmark::State &state) {
     state.SetComplexityN(state.range(0));
 }
 
+// Drains the set through erase(const_iterator), which needs no hashing at all
+static void BM_SparseSet_Erase_Iterator(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        sparse_set<int> s;
+        for (int val : data) {
+            s.insert(val);
+        }
+        state.ResumeTiming();
+
+        while (!s.empty()) {
+            benchmark::DoNotOptimize(s.erase(s.cbegin()));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(state.range(0));
+}
+
+static void BM_SparseSet_Erase_String(benchmark::State &state) {
+    auto data = generate_random_strings(state.range(0));
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        sparse_set<std::string> s;
+        for (const auto &val : data) {
+            s.insert(val);
+        }
+        state.ResumeTiming();
+
+        for (const auto &val : data) {
+            benchmark::DoNotOptimize(s.erase(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(state.range(0));
+}
+
 static void BM_StdSet_Erase(benchmark::State &state) {
     auto data = generate_random_ints(state.range(0));
 
@@ -299,6 +678,8 @@ static void BM_UnorderedSet_Erase(benchmark::State &state) {
 }
 
 BENCHMARK(BM_SparseSet_Erase)->Range(64, 1 << 16)->Complexity();
+BENCHMARK(BM_SparseSet_Erase_Iterator)->Range(64, 1 << 16)->Complexity();
+BENCHMARK(BM_SparseSet_Erase_String)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_StdSet_Erase)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_UnorderedSet_Erase)->Range(64, 1 << 16)->Complexity();
 
@@ -447,4 +828,999 @@ BENCHMARK(BM_SparseSet_Mixed)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_StdSet_Mixed)->Range(64, 1 << 16)->Complexity();
 BENCHMARK(BM_UnorderedSet_Mixed)->Range(64, 1 << 16)->Complexity();
 
+// ============================================================================
+// SLOT POLICY BENCHMARKS
+// ============================================================================
+
+template <class Policy>
+using policy_set = sparse_set<int, std::hash<int>, std::equal_to<int>, std::allocator<int>, Policy>;
+
+template <class Policy>
+static void BM_SparseSet_Insert_Policy(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0));
+
+    for (auto _ : state) {
+        policy_set<Policy> s;
+        for (int val : data) {
+            benchmark::DoNotOptimize(s.insert(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Policy>
+static void BM_SparseSet_Find_Hit_Policy(benchmark::State &state) {
+    auto               data = generate_random_ints(state.range(0));
+    policy_set<Policy> s;
+    for (int val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (int val : data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Policy>
+static void BM_SparseSet_Find_Miss_Policy(benchmark::State &state) {
+    auto               data      = generate_random_ints(state.range(0));
+    auto               miss_data = generate_random_ints(state.range(0), 2000000, 3000000);
+    policy_set<Policy> s;
+    for (int val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (int val : miss_data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_SparseSet_Insert_Policy, modulo_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Insert_Policy, mask_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Insert_Policy, fibonacci_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Find_Hit_Policy, modulo_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Find_Hit_Policy, mask_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Find_Hit_Policy, fibonacci_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Find_Miss_Policy, modulo_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Find_Miss_Policy, mask_slot_policy)->Range(64, 1 << 16);
+BENCHMARK_TEMPLATE(BM_SparseSet_Find_Miss_Policy, fibonacci_slot_policy)->Range(64, 1 << 16);
+
+// ============================================================================
+// STORED HASH BENCHMARKS
+// ============================================================================
+
+template <bool StoreHash>
+using string_set = sparse_set<
+    std::string,
+    std::hash<std::string>,
+    std::equal_to<std::string>,
+    std::allocator<std::string>,
+    fibonacci_slot_policy,
+    StoreHash>;
+
+template <bool StoreHash>
+static void BM_SparseSet_Insert_String_StoreHash(benchmark::State &state) {
+    auto data = generate_random_strings(state.range(0), 0, std::numeric_limits<int>::max());
+
+    for (auto _ : state) {
+        string_set<StoreHash> s;
+        for (const auto &val : data) {
+            benchmark::DoNotOptimize(s.insert(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <bool StoreHash>
+static void BM_SparseSet_Erase_String_StoreHash(benchmark::State &state) {
+    auto data = generate_random_strings(state.range(0), 0, std::numeric_limits<int>::max());
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        string_set<StoreHash> s;
+        for (const auto &val : data) {
+            s.insert(val);
+        }
+        state.ResumeTiming();
+
+        for (const auto &val : data) {
+            benchmark::DoNotOptimize(s.erase(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_SparseSet_Insert_String_StoreHash, false)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(BM_SparseSet_Insert_String_StoreHash, true)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(BM_SparseSet_Erase_String_StoreHash, false)->Range(1 << 10, 1 << 18);
+BENCHMARK_TEMPLATE(BM_SparseSet_Erase_String_StoreHash, true)->Range(1 << 10, 1 << 18);
+
+// ============================================================================
+// INSERT LATENCY BENCHMARKS (stop-the-world vs incremental rehash)
+// ============================================================================
+
+// Times every insert individually and reports tail percentiles; range(1) is the rehash step
+static void BM_SparseSet_Insert_Latency(benchmark::State &state) {
+    auto                data
+        = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    std::vector<double> latencies;
+    latencies.reserve(data.size());
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        latencies.clear();
+        sparse_set<int> s;
+        s.rehash_step(static_cast<size_t>(state.range(1)));
+        state.ResumeTiming();
+
+        for (int val : data) {
+            auto start = std::chrono::steady_clock::now();
+            benchmark::DoNotOptimize(s.insert(val));
+            auto stop = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::nano>(stop - start).count());
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+    };
+    state.counters["p50_ns"]  = percentile(0.5);
+    state.counters["p99_ns"]  = percentile(0.99);
+    state.counters["p999_ns"] = percentile(0.999);
+    state.counters["max_ns"]  = latencies.back();
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_SparseSet_Insert_Latency)->ArgsProduct({{1 << 14, 1 << 20}, {0, 4, 16}});
+
+// ============================================================================
+// PARALLEL REHASH BENCHMARKS (thread-count scaling of one full rebuild)
+// ============================================================================
+
+// range(1) is the rehash thread count; hashes are recomputed so the rebuild is not memory-only
+static void BM_SparseSet_Rehash_Threads(benchmark::State &state) {
+    auto data = generate_random_strings(state.range(0));
+    sparse_set<std::string, std::hash<std::string>, std::equal_to<std::string>,
+               std::allocator<std::string>, fibonacci_slot_policy, false>
+        s;
+    s.insert_range(data);
+    s.rehash_threads(static_cast<size_t>(state.range(1)));
+    size_t sparse_size = s.sparse_size();
+
+    for (auto _ : state) {
+        s.rehash(sparse_size * 2);
+        state.PauseTiming();
+        s.rehash(sparse_size);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(s.size()));
+}
+
+BENCHMARK(BM_SparseSet_Rehash_Threads)
+    ->ArgsProduct({{1 << 18, 1 << 22}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+// ============================================================================
+// READ-MOSTLY CONCURRENCY BENCHMARKS (thread 0 writes, every other thread reads)
+// ============================================================================
+
+static constexpr int  read_mostly_size          = 1 << 16;
+static constexpr int  read_mostly_batch_updates = 16;
+static constexpr auto read_mostly_write_period  = std::chrono::microseconds(100);
+
+// Background writer applying one batch of toggles per period until stopped; only the benchmark
+// threads, all of them readers, are timed
+template <class Apply>
+static auto start_read_mostly_writer(Apply apply) -> std::jthread {
+    return std::jthread([apply](std::stop_token stop) mutable {
+        std::mt19937                       writer_rng(7);
+        std::uniform_int_distribution<int> pick(0, read_mostly_size * 2);
+        while (!stop.stop_requested()) {
+            std::array<int, read_mostly_batch_updates> batch;
+            for (int &val : batch) {
+                val = pick(writer_rng);
+            }
+            apply(batch);
+            std::this_thread::sleep_for(read_mostly_write_period);
+        }
+    });
+}
+
+static void BM_SharedMutexSet_ReadMostly(benchmark::State &state) {
+    static sparse_set<int>   *s;
+    static std::shared_mutex *mutex;
+    static std::jthread       writer;
+    if (state.thread_index() == 0) {
+        s     = new sparse_set<int>();
+        mutex = new std::shared_mutex();
+        for (int i = 0; i < read_mostly_size; ++i) {
+            s->insert(i);
+        }
+        writer = start_read_mostly_writer([](const auto &batch) {
+            std::unique_lock lock(*mutex);
+            for (int val : batch) {
+                if (s->erase(val) == 0) s->insert(val);
+            }
+        });
+    }
+    std::mt19937                       local_rng(static_cast<unsigned>(state.thread_index()));
+    std::uniform_int_distribution<int> pick(0, read_mostly_size * 2);
+
+    for (auto _ : state) {
+        std::shared_lock lock(*mutex);
+        benchmark::DoNotOptimize(s->contains(pick(local_rng)));
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        writer = std::jthread();
+        delete s;
+        delete mutex;
+    }
+}
+
+static void BM_SnapshotSet_ReadMostly(benchmark::State &state) {
+    static snapshot_sparse_set<int> *s;
+    static std::jthread              writer;
+    if (state.thread_index() == 0) {
+        s = new snapshot_sparse_set<int>();
+        for (int i = 0; i < read_mostly_size; ++i) {
+            s->insert(i);
+        }
+        s->publish();
+        writer = start_read_mostly_writer([](const auto &batch) {
+            s->update([&](auto &staged) {
+                for (int val : batch) {
+                    if (staged.erase(val) == 0) staged.insert(val);
+                }
+            });
+            s->publish();
+        });
+    }
+    std::mt19937                       local_rng(static_cast<unsigned>(state.thread_index()));
+    std::uniform_int_distribution<int> pick(0, read_mostly_size * 2);
+
+    // Claimed on the first pass: only then is every thread guaranteed to see the set
+    std::optional<snapshot_sparse_set<int>::reader> reader;
+    for (auto _ : state) {
+        if (!reader) reader.emplace(s->make_reader());
+        benchmark::DoNotOptimize(reader->contains(pick(local_rng)));
+    }
+    state.SetItemsProcessed(state.iterations());
+    reader.reset();
+
+    if (state.thread_index() == 0) {
+        writer = std::jthread();
+        delete s;
+    }
+}
+
+BENCHMARK(BM_SharedMutexSet_ReadMostly)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_SnapshotSet_ReadMostly)->ThreadRange(1, 16)->UseRealTime();
+
+// ============================================================================
+// PARALLEL INGESTION BENCHMARKS (every thread inserts, keys toggle so size stays bounded)
+// ============================================================================
+
+static constexpr int ingestion_key_range = 1 << 20;
+
+static void BM_MutexSet_Ingest(benchmark::State &state) {
+    static sparse_set<int> *s;
+    static std::mutex      *mutex;
+    if (state.thread_index() == 0) {
+        s     = new sparse_set<int>();
+        mutex = new std::mutex();
+    }
+    std::mt19937                       local_rng(static_cast<unsigned>(state.thread_index()));
+    std::uniform_int_distribution<int> pick(0, ingestion_key_range);
+
+    for (auto _ : state) {
+        int             val = pick(local_rng);
+        std::lock_guard lock(*mutex);
+        if (!s->insert(val).second) s->erase(val);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        delete s;
+        delete mutex;
+    }
+}
+
+static void BM_ConcurrentSet_Ingest(benchmark::State &state) {
+    static concurrent_sparse_set<int> *s;
+    if (state.thread_index() == 0) s = new concurrent_sparse_set<int>();
+    std::mt19937                       local_rng(static_cast<unsigned>(state.thread_index()));
+    std::uniform_int_distribution<int> pick(0, ingestion_key_range);
+
+    for (auto _ : state) {
+        int val = pick(local_rng);
+        if (!s->insert(val)) s->erase(val);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) delete s;
+}
+
+BENCHMARK(BM_MutexSet_Ingest)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK(BM_ConcurrentSet_Ingest)->ThreadRange(1, 16)->UseRealTime();
+
+// ============================================================================
+// PARALLEL DEDUPLICATION BENCHMARKS (half the input is duplicates, range(1) = threads)
+// ============================================================================
+
+static constexpr int dedup_input_size = 1 << 20;
+
+static void BM_SparseSet_Dedup(benchmark::State &state) {
+    auto data = generate_random_ints(dedup_input_size, 0, dedup_input_size / 2);
+    for (auto _ : state) {
+        sparse_set<int> s;
+        for (int val : data) {
+            s.insert(val);
+        }
+        benchmark::DoNotOptimize(s.size());
+    }
+    state.SetItemsProcessed(state.iterations() * dedup_input_size);
+}
+
+template <class Set>
+static void BM_Parallel_Dedup(benchmark::State &state) {
+    auto   data    = generate_random_ints(dedup_input_size, 0, dedup_input_size / 2);
+    size_t threads = static_cast<size_t>(state.range(0));
+    for (auto _ : state) {
+        Set s;
+        sparse_parallel_for(threads, [&](size_t idx) {
+            size_t first = data.size() * idx / threads;
+            size_t last  = data.size() * (idx + 1) / threads;
+            for (size_t i = first; i < last; ++i) {
+                s.insert(data[i]);
+            }
+        });
+        benchmark::DoNotOptimize(s.size());
+    }
+    state.SetItemsProcessed(state.iterations() * dedup_input_size);
+}
+
+BENCHMARK(BM_SparseSet_Dedup)->UseRealTime();
+BENCHMARK(BM_Parallel_Dedup<concurrent_sparse_set<int>>)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+BENCHMARK(BM_Parallel_Dedup<lockfree_sparse_set<int>>)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+// ============================================================================
+// DENSE STORAGE BENCHMARKS (256-byte values, std::vector vs segmented growth)
+// ============================================================================
+
+using big_value = std::array<char, 256>;
+
+template <class Storage>
+using big_value_map = sparse_key_set<
+    int, big_value, std::hash<int>, std::equal_to<int>, std::allocator<big_value>,
+    fibonacci_slot_policy, false, Storage>;
+
+template <class Storage>
+static void BM_DenseStorage_Grow(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    for (auto _ : state) {
+        big_value_map<Storage> m;
+        for (int val : data) {
+            m.insert({val, big_value{}});
+        }
+        benchmark::DoNotOptimize(m.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Storage>
+static void BM_DenseStorage_Iterate(benchmark::State &state) {
+    big_value_map<Storage> m;
+    for (int val : generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max())) {
+        m.insert({val, big_value{}});
+    }
+    for (auto _ : state) {
+        long sum = 0;
+        for (const auto &value : m) {
+            sum += value[0];
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(m.size()));
+}
+
+BENCHMARK(BM_DenseStorage_Grow<vector_storage>)->Range(1 << 12, 1 << 18);
+BENCHMARK(BM_DenseStorage_Grow<segmented_storage<>>)->Range(1 << 12, 1 << 18);
+BENCHMARK(BM_DenseStorage_Iterate<vector_storage>)->Range(1 << 12, 1 << 18);
+BENCHMARK(BM_DenseStorage_Iterate<segmented_storage<>>)->Range(1 << 12, 1 << 18);
+
+// ============================================================================
+// SMALL SET BENCHMARKS (build a tiny set, then probe it; range(0) = elements)
+// ============================================================================
+
+template <class Set>
+static void small_set_round(benchmark::State &state, size_t bucket_count) {
+    auto count = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        Set set(bucket_count);
+        for (int i = 0; i < count; ++i) {
+            set.insert(i * 7);
+        }
+        int hits = 0;
+        for (int i = 0; i < 2 * count; ++i) {
+            hits += set.contains(i * 7) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_SmallSet_Indexed(benchmark::State &state) {
+    small_set_round<sparse_set<int>>(state, INIT_SPARSE_SIZE);
+}
+
+static void BM_SmallSet_Scan(benchmark::State &state) {
+    small_set_round<sparse_set<int>>(state, 0);
+}
+
+static void BM_SmallSet_ScanInline(benchmark::State &state) {
+    small_set_round<sparse_set<
+        int, std::hash<int>, std::equal_to<int>, std::allocator<int>, fibonacci_slot_policy,
+        false, inline_storage<SMALL_SET_SIZE>>>(state, 0);
+}
+
+static void BM_UnorderedSet_Small(benchmark::State &state) {
+    small_set_round<std::unordered_set<int>>(state, 0);
+}
+
+BENCHMARK(BM_SmallSet_Indexed)->DenseRange(2, 8, 3);
+BENCHMARK(BM_SmallSet_Scan)->DenseRange(2, 8, 3);
+BENCHMARK(BM_SmallSet_ScanInline)->DenseRange(2, 8, 3);
+BENCHMARK(BM_UnorderedSet_Small)->DenseRange(2, 8, 3);
+
+// ============================================================================
+// INDEX ENGINE BENCHMARKS (Robin Hood vs group probing, near max load)
+// ============================================================================
+
+// Element counts just below each engine's growth threshold, so both run at their maximum load
+static void high_load_args(benchmark::internal::Benchmark *b, double load_factor) {
+    for (int shift = 12; shift <= 20; shift += 4) {
+        b->Arg(static_cast<int64_t>(static_cast<double>(1 << shift) * load_factor) - 1);
+    }
+}
+
+template <class Set>
+static void BM_Engine_Find_Hit(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    Set  s;
+    for (int val : data) {
+        s.insert(val);
+    }
+    std::shuffle(data.begin(), data.end(), rng);
+
+    for (auto _ : state) {
+        for (int val : data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.counters["load"] = static_cast<double>(s.size()) / static_cast<double>(s.sparse_size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Set>
+static void BM_Engine_Find_Miss(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, 1 << 30);
+    auto miss_data
+        = generate_random_ints(state.range(0), (1 << 30) + 1, std::numeric_limits<int>::max());
+    Set s;
+    for (int val : data) {
+        s.insert(val);
+    }
+
+    for (auto _ : state) {
+        for (int val : miss_data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.counters["load"] = static_cast<double>(s.size()) / static_cast<double>(s.sparse_size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_Engine_Find_Hit, sparse_set<int>)->Apply([](auto *b) {
+    high_load_args(b, LOAD_FACTOR);
+});
+BENCHMARK_TEMPLATE(BM_Engine_Find_Hit, group_sparse_set<int>)->Apply([](auto *b) {
+    high_load_args(b, GROUP_LOAD_FACTOR);
+});
+BENCHMARK_TEMPLATE(BM_Engine_Find_Miss, sparse_set<int>)->Apply([](auto *b) {
+    high_load_args(b, LOAD_FACTOR);
+});
+BENCHMARK_TEMPLATE(BM_Engine_Find_Miss, group_sparse_set<int>)->Apply([](auto *b) {
+    high_load_args(b, GROUP_LOAD_FACTOR);
+});
+
+template <class Set>
+static void BM_KeyEngine_Find_Hit(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    Set  s;
+    for (int val : data) {
+        s.insert(val, val);
+    }
+    std::shuffle(data.begin(), data.end(), rng);
+
+    for (auto _ : state) {
+        for (int val : data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.counters["load"] = static_cast<double>(s.size()) / static_cast<double>(s.sparse_size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Set>
+static void BM_KeyEngine_Find_Miss(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, 1 << 30);
+    auto miss_data
+        = generate_random_ints(state.range(0), (1 << 30) + 1, std::numeric_limits<int>::max());
+    Set s;
+    for (int val : data) {
+        s.insert(val, val);
+    }
+
+    for (auto _ : state) {
+        for (int val : miss_data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.counters["load"] = static_cast<double>(s.size()) / static_cast<double>(s.sparse_size());
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_KeyEngine_Find_Hit, sparse_key_set<int, int>)->Apply([](auto *b) {
+    high_load_args(b, LOAD_FACTOR);
+});
+BENCHMARK_TEMPLATE(BM_KeyEngine_Find_Hit, group_sparse_key_set<int, int>)->Apply([](auto *b) {
+    high_load_args(b, GROUP_LOAD_FACTOR);
+});
+BENCHMARK_TEMPLATE(BM_KeyEngine_Find_Miss, sparse_key_set<int, int>)->Apply([](auto *b) {
+    high_load_args(b, LOAD_FACTOR);
+});
+BENCHMARK_TEMPLATE(BM_KeyEngine_Find_Miss, group_sparse_key_set<int, int>)->Apply([](auto *b) {
+    high_load_args(b, GROUP_LOAD_FACTOR);
+});
+
+// ============================================================================
+// DIRECT INDEX BENCHMARKS (entity ids drawn from a universe twice the set size)
+// ============================================================================
+
+template <class Set>
+static void BM_Direct_Contains(benchmark::State &state) {
+    auto universe = static_cast<unsigned>(2 * state.range(0));
+    Set  s;
+    for (unsigned id = 0; id < universe; id += 2) {
+        s.insert(id);
+    }
+    // Half hits, half misses, in random order
+    std::vector<unsigned> probes(universe);
+    std::iota(probes.begin(), probes.end(), 0U);
+    std::shuffle(probes.begin(), probes.end(), rng);
+
+    for (auto _ : state) {
+        size_t hits = 0;
+        for (unsigned id : probes) {
+            hits += s.contains(id) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(universe));
+}
+
+template <class Set>
+static void BM_Direct_Churn(benchmark::State &state) {
+    auto ids = generate_random_ints(state.range(0), 0, static_cast<int>(2 * state.range(0)));
+    Set  s;
+    for (auto _ : state) {
+        for (int id : ids) {
+            s.insert(static_cast<unsigned>(id));
+        }
+        for (int id : ids) {
+            s.erase(static_cast<unsigned>(id));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 2 * state.range(0));
+}
+
+BENCHMARK_TEMPLATE(BM_Direct_Contains, sparse_set<unsigned>)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Direct_Contains, direct_sparse_set<unsigned>)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Direct_Churn, sparse_set<unsigned>)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Direct_Churn, direct_sparse_set<unsigned>)->Range(1 << 10, 1 << 20);
+
+// ============================================================================
+// GENERATIONAL HANDLE BENCHMARKS (half of the probed handles are stale)
+// ============================================================================
+
+static void BM_Handle_KeySet(benchmark::State &state) {
+    handle_key_set<int>          set;
+    std::vector<sparse_handle<>> probes;
+    for (int i = 0; i < state.range(0); ++i) {
+        probes.push_back(set.create(i));
+    }
+    // Recycle every index once, so the first half of probes is stale
+    for (int i = 0; i < state.range(0); ++i) {
+        set.destroy(probes[static_cast<size_t>(i)]);
+        probes.push_back(set.create(i));
+    }
+    std::shuffle(probes.begin(), probes.end(), rng);
+
+    for (auto _ : state) {
+        long sum = 0;
+        for (auto handle : probes) {
+            if (auto it = set.find(handle); it != set.end()) sum += *it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+// The pattern handle_key_set replaces: values keyed by index plus a map of live generations
+static void BM_Handle_ValidationMap(benchmark::State &state) {
+    sparse_key_set<std::uint32_t, int>                   values;
+    sparse_key_set<std::uint32_t, std::uint32_t>         generations;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> probes;
+    for (int i = 0; i < state.range(0); ++i) {
+        auto index = static_cast<std::uint32_t>(i);
+        values.insert({index, i});
+        generations.insert({index, 2});
+        probes.emplace_back(index, 1);
+        probes.emplace_back(index, 2);
+    }
+    std::shuffle(probes.begin(), probes.end(), rng);
+
+    for (auto _ : state) {
+        long sum = 0;
+        for (auto [index, generation] : probes) {
+            auto live = generations.find(index);
+            if (live == generations.end() || *live != generation) continue;
+            if (auto it = values.find(index); it != values.end()) sum += *it;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+BENCHMARK(BM_Handle_KeySet)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_Handle_ValidationMap)->Range(1 << 10, 1 << 20);
+
+// ============================================================================
+// BINARY IMAGE BENCHMARKS (restore a saved set from memory)
+// ============================================================================
+
+static auto saved_image(int64_t count, sparse_image_encoding encoding) -> std::string {
+    sparse_set<int> s;
+    for (int val : generate_random_ints(count, 0, std::numeric_limits<int>::max())) {
+        s.insert(val);
+    }
+    std::ostringstream stream;
+    s.save(stream, encoding);
+    return stream.str();
+}
+
+static void BM_Image_Load(benchmark::State &state) {
+    std::string image = saved_image(state.range(0), sparse_image_encoding::image);
+
+    for (auto _ : state) {
+        std::istringstream stream(image);
+        sparse_set<int>    s;
+        s.load(stream);
+        benchmark::DoNotOptimize(s.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_Image_LoadCompact(benchmark::State &state) {
+    std::string image = saved_image(state.range(0), sparse_image_encoding::compact);
+
+    for (auto _ : state) {
+        std::istringstream stream(image);
+        sparse_set<int>    s;
+        s.load(stream);
+        benchmark::DoNotOptimize(s.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Rebuilding from the element list by inserting each one, the way a set was restored before
+static void BM_Image_Reinsert(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+
+    for (auto _ : state) {
+        sparse_set<int> s;
+        s.reserve(data.size());
+        for (int val : data) {
+            s.insert(val);
+        }
+        benchmark::DoNotOptimize(s.size());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_Image_Load)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_Image_LoadCompact)->Range(1 << 10, 1 << 20);
+BENCHMARK(BM_Image_Reinsert)->Range(1 << 10, 1 << 20);
+
+// ============================================================================
+// MAPPED ARENA BENCHMARKS (open a stored key set, then look up range(1) random keys)
+// ============================================================================
+
+using mapped_bench_set = sparse_key_set<
+    std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>,
+    mapped_allocator<std::uint64_t>>;
+
+static auto mapped_bench_root(mapped_arena &arena) -> mapped_bench_set & {
+    return arena.root<mapped_bench_set>(
+        size_t{0}, std::hash<std::uint64_t>{}, std::equal_to<std::uint64_t>{},
+        arena.get_allocator<std::uint64_t>()
+    );
+}
+
+static auto mapped_bench_probes(const benchmark::State &state) -> std::vector<std::uint64_t> {
+    auto                                         keys = static_cast<std::uint64_t>(state.range(0));
+    std::uniform_int_distribution<std::uint64_t> dist(0, keys - 1);
+    std::vector<std::uint64_t>                   probes(static_cast<size_t>(state.range(1)));
+    for (auto &probe : probes) {
+        probe = dist(rng);
+    }
+    return probes;
+}
+
+// The file is dropped from the page cache before every open, so lookups fault pages in from disk
+static void BM_Mapped_ColdOpen(benchmark::State &state) {
+    auto path = std::filesystem::temp_directory_path() / "sparse-bench-arena";
+    std::filesystem::remove(path);
+    {
+        mapped_arena      arena(path);
+        mapped_bench_set &map = mapped_bench_root(arena);
+        for (std::uint64_t i = 0; i < static_cast<std::uint64_t>(state.range(0)); ++i) {
+            map.insert({i, i});
+        }
+        arena.sync();
+    }
+    auto probes = mapped_bench_probes(state);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+        state.ResumeTiming();
+
+        mapped_arena      arena(path);
+        mapped_bench_set &map = mapped_bench_root(arena);
+        std::uint64_t     sum = 0;
+        for (std::uint64_t key : probes) {
+            sum += map.at(key);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    std::filesystem::remove(path);
+}
+
+static void BM_Mapped_Rebuild(benchmark::State &state) {
+    auto probes = mapped_bench_probes(state);
+
+    for (auto _ : state) {
+        sparse_key_set<std::uint64_t, std::uint64_t> map;
+        for (std::uint64_t i = 0; i < static_cast<std::uint64_t>(state.range(0)); ++i) {
+            map.insert({i, i});
+        }
+        std::uint64_t sum = 0;
+        for (std::uint64_t key : probes) {
+            sum += map.at(key);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK(BM_Mapped_ColdOpen)
+    ->ArgsProduct({benchmark::CreateRange(1 << 16, 1 << 22, 4), {0, 1000}});
+BENCHMARK(BM_Mapped_Rebuild)->ArgsProduct({benchmark::CreateRange(1 << 16, 1 << 22, 4), {0, 1000}});
+
+// ============================================================================
+// SHARED SET BENCHMARKS (reader-side lookups, half hits, in a segment of range(0) elements)
+// ============================================================================
+
+static auto shared_bench_probes(int64_t count) -> std::vector<std::uint64_t> {
+    std::uniform_int_distribution<std::uint64_t> dist(0, 2 * static_cast<std::uint64_t>(count));
+    std::vector<std::uint64_t>                   probes(4096);
+    for (auto &probe : probes) {
+        probe = dist(rng);
+    }
+    return probes;
+}
+
+static auto shared_bench_writer(int64_t count) -> shared_sparse_set<std::uint64_t> {
+    auto writer = shared_sparse_set<std::uint64_t>::create("/sparse-bench-shared");
+    writer.update([&](auto &set) {
+        for (std::uint64_t i = 0; i < static_cast<std::uint64_t>(count); ++i) {
+            set.insert(2 * i);
+        }
+    });
+    return writer;
+}
+
+// Every lookup takes and drops the shared lock
+static void BM_Shared_Contains(benchmark::State &state) {
+    auto writer = shared_bench_writer(state.range(0));
+    auto reader = shared_sparse_set<std::uint64_t>::open("/sparse-bench-shared");
+    auto probes = shared_bench_probes(state.range(0));
+
+    for (auto _ : state) {
+        size_t found = 0;
+        for (std::uint64_t key : probes) {
+            found += reader.contains(key) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+    shared_sparse_set<std::uint64_t>::remove("/sparse-bench-shared");
+}
+
+// One shared lock per batch of lookups
+static void BM_Shared_ContainsBatch(benchmark::State &state) {
+    auto writer = shared_bench_writer(state.range(0));
+    auto reader = shared_sparse_set<std::uint64_t>::open("/sparse-bench-shared");
+    auto probes = shared_bench_probes(state.range(0));
+
+    for (auto _ : state) {
+        auto   set   = reader.read();
+        size_t found = 0;
+        for (std::uint64_t key : probes) {
+            found += set->contains(key) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+    shared_sparse_set<std::uint64_t>::remove("/sparse-bench-shared");
+}
+
+// The private copy each worker process holds today
+static void BM_Shared_LocalCopy(benchmark::State &state) {
+    sparse_set<std::uint64_t> set;
+    for (std::uint64_t i = 0; i < static_cast<std::uint64_t>(state.range(0)); ++i) {
+        set.insert(2 * i);
+    }
+    auto probes = shared_bench_probes(state.range(0));
+
+    for (auto _ : state) {
+        size_t found = 0;
+        for (std::uint64_t key : probes) {
+            found += set.contains(key) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(found);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(probes.size()));
+}
+
+BENCHMARK(BM_Shared_Contains)->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_Shared_ContainsBatch)->Range(1 << 10, 1 << 22);
+BENCHMARK(BM_Shared_LocalCopy)->Range(1 << 10, 1 << 22);
+
+// ============================================================================
+// MEMORY AND LARGE TABLE BENCHMARKS
+// ============================================================================
+
+static void BM_SparseSet_Memory(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+
+    for (auto _ : state) {
+        size_t base = allocated_bytes;
+        sparse_set<int, std::hash<int>, std::equal_to<int>, counting_allocator<int>> s;
+        for (int val : data) {
+            s.insert(val);
+        }
+        state.counters["bytes"]          = static_cast<double>(allocated_bytes - base);
+        state.counters["bytes_per_elem"] = static_cast<double>(allocated_bytes - base)
+                                           / static_cast<double>(s.size());
+        state.counters["index_bytes"]
+            = static_cast<double>(s.sparse_size() * sizeof(sparse_entry));
+    }
+}
+
+static void BM_UnorderedSet_Memory(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+
+    for (auto _ : state) {
+        size_t base = allocated_bytes;
+        std::unordered_set<int, std::hash<int>, std::equal_to<int>, counting_allocator<int>> s;
+        for (int val : data) {
+            s.insert(val);
+        }
+        state.counters["bytes"]          = static_cast<double>(allocated_bytes - base);
+        state.counters["bytes_per_elem"] = static_cast<double>(allocated_bytes - base)
+                                           / static_cast<double>(s.size());
+    }
+}
+
+// 32-bit entity ids in clusters of 256 consecutive ids scattered over the whole range
+static void BM_DirectSparseSet_ClusteredMemory(benchmark::State &state) {
+    auto starts = generate_random_ints(state.range(0) / 256, 0, std::numeric_limits<int>::max());
+
+    for (auto _ : state) {
+        size_t base = allocated_bytes;
+        direct_sparse_set<std::uint32_t, counting_allocator<std::uint32_t>> s;
+        for (int start : starts) {
+            std::uint32_t first = (static_cast<std::uint32_t>(start) * 2) & ~255U;
+            for (std::uint32_t i = 0; i < 256; ++i) {
+                s.insert(first + i);
+            }
+        }
+        state.counters["bytes"]          = static_cast<double>(allocated_bytes - base);
+        state.counters["bytes_per_elem"] = static_cast<double>(allocated_bytes - base)
+                                           / static_cast<double>(s.size());
+        state.counters["pages"]          = static_cast<double>(s.page_count());
+        state.counters["flat_bytes"]
+            = static_cast<double>(s.sparse_size() * sizeof(sparse_entry::pos_type));
+    }
+}
+
+BENCHMARK(BM_SparseSet_Memory)->Range(1 << 16, 1 << 22)->Iterations(1);
+BENCHMARK(BM_UnorderedSet_Memory)->Range(1 << 16, 1 << 22)->Iterations(1);
+BENCHMARK(BM_DirectSparseSet_ClusteredMemory)->Range(1 << 16, 1 << 22)->Iterations(1);
+
+static void BM_SparseSet_Find_Hit_Large(benchmark::State &state) {
+    auto            data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    sparse_set<int> s;
+    for (int val : data) {
+        s.insert(val);
+    }
+    std::shuffle(data.begin(), data.end(), rng);
+
+    for (auto _ : state) {
+        for (int val : data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_UnorderedSet_Find_Hit_Large(benchmark::State &state) {
+    auto data = generate_random_ints(state.range(0), 0, std::numeric_limits<int>::max());
+    std::unordered_set<int> s;
+    for (int val : data) {
+        s.insert(val);
+    }
+    std::shuffle(data.begin(), data.end(), rng);
+
+    for (auto _ : state) {
+        for (int val : data) {
+            benchmark::DoNotOptimize(s.find(val));
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_SparseSet_Find_Hit_Large)->Range(1 << 18, 1 << 22);
+BENCHMARK(BM_UnorderedSet_Find_Hit_Large)->Range(1 << 18, 1 << 22);
+
 BENCHMARK_MAIN();
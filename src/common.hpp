@@ -1,7 +1,25 @@
 #ifndef _COMMON_HPP
 #define _COMMON_HPP
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <random>
 #include <ranges>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// The compact index entry addresses at most 2^32 - 1 elements; past that the sets throw
+// std::length_error. Define SPARSE_WIDE_ENTRY to 1 for 16-byte entries with 64-bit positions.
+#ifndef SPARSE_WIDE_ENTRY
+#    define SPARSE_WIDE_ENTRY 0
+#endif
 
 template <class R, class T>
 concept container_compatible_range
@@ -11,4 +29,231 @@ concept container_compatible_range
           || std::convertible_to<T, std::ranges::range_rvalue_reference_t<R>>
           || std::constructible_from<T, std::ranges::range_rvalue_reference_t<R>>);
 
+// Heterogeneous lookup is enabled when both the hasher and key_equal declare is_transparent
+template <class Hash, class KeyEqual>
+concept transparent_lookup = requires {
+    typename Hash::is_transparent;
+    typename KeyEqual::is_transparent;
+};
+
+// Placeholder for an optional parallel dense array that is compiled out
+struct empty_dense_arr {
+    empty_dense_arr() = default;
+    template <class Alloc>
+    explicit empty_dense_arr(const Alloc &) {}
+};
+
+// Slot policies map a full hash code to a home slot and step the probe sequence.
+// valid_size() rounds a requested index size up to one the policy can address.
+struct modulo_slot_policy {
+    static constexpr auto valid_size(size_t size) -> size_t {
+        return std::max<size_t>(size, 1);
+    }
+    static constexpr auto slot(size_t hash_code, size_t size) -> size_t {
+        return hash_code % size;
+    }
+    static constexpr auto next(size_t slot, size_t size) -> size_t {
+        return slot + 1 == size ? 0 : slot + 1;
+    }
+};
+
+struct mask_slot_policy {
+    static constexpr auto valid_size(size_t size) -> size_t {
+        return std::bit_ceil(std::max<size_t>(size, 2));
+    }
+    static constexpr auto slot(size_t hash_code, size_t size) -> size_t {
+        return hash_code & (size - 1);
+    }
+    static constexpr auto next(size_t slot, size_t size) -> size_t {
+        return (slot + 1) & (size - 1);
+    }
+};
+
+// Multiplies by 2^64 / phi and keeps the top bits, so identity hashes still spread well
+struct fibonacci_slot_policy {
+    static constexpr auto valid_size(size_t size) -> size_t {
+        return std::bit_ceil(std::max<size_t>(size, 2));
+    }
+    static constexpr auto slot(size_t hash_code, size_t size) -> size_t {
+        auto mixed = static_cast<std::uint64_t>(hash_code) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<size_t>(mixed >> (64 - std::countr_zero(size)));
+    }
+    static constexpr auto next(size_t slot, size_t size) -> size_t {
+        return (slot + 1) & (size - 1);
+    }
+};
+
+// Dense storage policies pick the container a set keeps its elements in, in insertion order.
+// vector_storage is one contiguous block; segmented_storage (segmented-vector.hpp) never moves
+// elements when it grows.
+struct vector_storage {
+    template <class U, class Alloc>
+    using type = std::vector<U, Alloc>;
+};
+
+// 8 bytes per slot: 32-bit dense position, 8-bit probe distance, 24-bit hash fingerprint.
+// A distance of max_dist means "at least max_dist"; probes keep going past it.
+struct compact_sparse_entry {
+    using pos_type = std::uint32_t;
+
+    static constexpr size_t        max_pos          = std::numeric_limits<pos_type>::max();
+    static constexpr size_t        max_dist         = (1U << 8U) - 1;
+    static constexpr std::uint32_t fingerprint_mask = (1U << 24U) - 1;
+
+    pos_type      pos{0};
+    std::uint32_t dist        : 8 {0};
+    std::uint32_t fingerprint : 24 {0};
+};
+
+// 16 bytes per slot, for sets that outgrow 32-bit dense positions
+struct wide_sparse_entry {
+    using pos_type = size_t;
+
+    static constexpr size_t        max_pos          = std::numeric_limits<pos_type>::max();
+    static constexpr size_t        max_dist         = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::uint32_t fingerprint_mask = std::numeric_limits<std::uint32_t>::max();
+
+    pos_type      pos{0};
+    std::uint32_t dist{0};
+    std::uint32_t fingerprint{0};
+};
+
+using sparse_entry
+    = std::conditional_t<SPARSE_WIDE_ENTRY != 0, wide_sparse_entry, compact_sparse_entry>;
+
+static_assert(sizeof(compact_sparse_entry) == 8);
+
+constexpr auto sparse_fingerprint(size_t hash_code) -> std::uint32_t {
+    auto mixed = static_cast<std::uint64_t>(hash_code);
+    mixed      = (mixed ^ (mixed >> 32U)) * 0xD6E8FEB86659FD93ULL;
+    return static_cast<std::uint32_t>(mixed >> 32U);
+}
+
+// 64-bit finalizer from MurmurHash3; its top bits are independent of the ones the fibonacci
+// policy and sparse_fingerprint take, so they can route keys between tables
+constexpr auto sparse_mix64(size_t hash_code) -> std::uint64_t {
+    auto mixed = static_cast<std::uint64_t>(hash_code);
+    mixed      = (mixed ^ (mixed >> 33U)) * 0xFF51AFD7ED558CCDULL;
+    mixed      = (mixed ^ (mixed >> 33U)) * 0xC4CEB9FE1A85EC53ULL;
+    return mixed ^ (mixed >> 33U);
+}
+
+// Read hint for a line the caller will touch shortly; a no-op where the builtin is missing
+inline auto sparse_prefetch(const void *addr) -> void {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr, 0, 3);
+#else
+    (void)addr;
+#endif
+}
+
+// Runs fn(0) .. fn(count - 1) on count threads, index 0 on the calling thread, and rethrows
+// the first exception once every thread has finished
+template <class F>
+auto sparse_parallel_for(size_t count, F &&fn) -> void {
+    std::vector<std::exception_ptr> errors(count);
+    auto                             run = [&](size_t idx) {
+        try {
+            fn(idx);
+        } catch (...) {
+            errors[idx] = std::current_exception();
+        }
+    };
+    {
+        std::vector<std::jthread> workers;
+        workers.reserve(count);
+        for (size_t idx = 1; idx < count; ++idx) {
+            workers.emplace_back(run, idx);
+        }
+        run(0);
+    }
+    for (auto &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+// SipHash-1-3 keyed with 128 bits, read little-endian
+inline auto sip_hash_13(const void *data, size_t len, std::uint64_t k0, std::uint64_t k1)
+    -> std::uint64_t {
+    std::uint64_t v0 = k0 ^ 0x736F6D6570736575ULL;
+    std::uint64_t v1 = k1 ^ 0x646F72616E646F6DULL;
+    std::uint64_t v2 = k0 ^ 0x6C7967656E657261ULL;
+    std::uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+    auto round = [&] {
+        v0 += v1;
+        v1  = std::rotl(v1, 13) ^ v0;
+        v0  = std::rotl(v0, 32);
+        v2 += v3;
+        v3  = std::rotl(v3, 16) ^ v2;
+        v0 += v3;
+        v3  = std::rotl(v3, 21) ^ v0;
+        v2 += v1;
+        v1  = std::rotl(v1, 17) ^ v2;
+        v2  = std::rotl(v2, 32);
+    };
+
+    const auto *bytes = static_cast<const unsigned char *>(data);
+    size_t      tail  = len & ~size_t{7};
+    for (size_t i = 0; i < tail; i += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        v3 ^= word;
+        round();
+        v0 ^= word;
+    }
+
+    std::uint64_t last = static_cast<std::uint64_t>(len) << 56U;
+    for (size_t i = tail; i < len; ++i) {
+        last |= static_cast<std::uint64_t>(bytes[i]) << (8 * (i - tail));
+    }
+    v3 ^= last;
+    round();
+    v0 ^= last;
+
+    v2 ^= 0xFF;
+    round();
+    round();
+    round();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// std::hash over string views, so string sets can be probed with std::string_view and const char *
+struct string_hash {
+    using is_transparent = void;
+
+    auto operator()(std::string_view value) const -> size_t {
+        return std::hash<std::string_view>{}(value);
+    }
+};
+
+// Hash keyed from std::random_device per instance, so colliding keys cannot be chosen in advance.
+// Strings and trivially comparable types are hashed by bytes; anything else keys std::hash output.
+template <class T>
+struct seeded_hash {
+    seeded_hash() : k0(random_key()), k1(random_key()) {}
+    seeded_hash(std::uint64_t key0, std::uint64_t key1) : k0(key0), k1(key1) {}
+
+    auto operator()(const T &value) const -> size_t {
+        if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+            std::string_view bytes = value;
+            return static_cast<size_t>(sip_hash_13(bytes.data(), bytes.size(), k0, k1));
+        } else if constexpr (std::has_unique_object_representations_v<T>) {
+            return static_cast<size_t>(sip_hash_13(&value, sizeof(T), k0, k1));
+        } else {
+            size_t hash_code = std::hash<T>{}(value);
+            return static_cast<size_t>(sip_hash_13(&hash_code, sizeof(hash_code), k0, k1));
+        }
+    }
+
+private:
+    static auto random_key() -> std::uint64_t {
+        std::random_device device;
+        return (static_cast<std::uint64_t>(device()) << 32U) | device();
+    }
+
+    std::uint64_t k0;
+    std::uint64_t k1;
+};
+
 #endif
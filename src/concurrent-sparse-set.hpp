@@ -0,0 +1,460 @@
+#ifndef _CONCURRENT_SPARSE_SET_HPP
+#define _CONCURRENT_SPARSE_SET_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+
+#include "./common.hpp"
+#include "./sparse-key-set.hpp"
+#include "./sparse-set.hpp"
+
+#ifndef CONCURRENT_SHARDS
+#    define CONCURRENT_SHARDS 16
+#endif
+
+template <class Mutex>
+concept shared_lockable = requires(Mutex &mutex) {
+    mutex.lock_shared();
+    mutex.unlock_shared();
+};
+
+// Readers share the shard when its mutex allows it and take it exclusively otherwise
+template <class Mutex>
+using sparse_read_lock = std::conditional_t<
+    shared_lockable<Mutex>, std::shared_lock<Mutex>, std::unique_lock<Mutex>>;
+
+// One lock per shard, padded so neighbouring shards never share a cache line
+template <class Set, class Mutex>
+struct alignas(64) sparse_shard {
+    mutable Mutex mutex;
+    Set           set;
+};
+
+// Routes a hash code to one of shard_count (a power of two) shards by its remixed top bits
+inline auto sparse_shard_index(size_t hash_code, size_t shard_count) -> size_t {
+    if (shard_count == 1) return 0;
+    return static_cast<size_t>(sparse_mix64(hash_code) >> (64 - std::countr_zero(shard_count)));
+}
+
+// Lock-striped set: keys are split across independently locked sparse_set shards, so threads
+// working on different shards never contend. Every call locks exactly one shard, except size(),
+// empty(), clear(), reserve() and for_each(), which visit the shards one at a time and so are
+// not atomic snapshots while writers are running. Mutex defaults to std::mutex, which is cheaper
+// than std::shared_mutex under write-heavy load; pass std::shared_mutex for read-heavy use.
+template <
+    typename T,
+    typename Hash      = std::hash<T>,
+    typename KeyEqual  = std::equal_to<T>,
+    typename Allocator = std::allocator<T>,
+    typename Mutex     = std::mutex>
+class concurrent_sparse_set {
+public:
+    using value_type     = T;
+    using hasher         = Hash;
+    using key_equal      = KeyEqual;
+    using allocator_type = Allocator;
+    using set_type       = sparse_set<T, Hash, KeyEqual, Allocator>;
+
+    // shard_count is rounded up to a power of two
+    explicit concurrent_sparse_set(
+        size_t                shard_count = CONCURRENT_SHARDS,
+        const hasher         &hash        = hasher(),
+        const key_equal      &equal       = key_equal(),
+        const allocator_type &alloc       = allocator_type()
+    );
+
+    concurrent_sparse_set(const concurrent_sparse_set &)                     = delete;
+    auto operator=(const concurrent_sparse_set &) -> concurrent_sparse_set & = delete;
+
+    [[nodiscard]] auto shard_count() const -> size_t { return shard_total; }
+    [[nodiscard]] auto size() const -> size_t;
+    [[nodiscard]] auto empty() const -> bool;
+
+    auto clear() -> void;
+    // Reserves count / shard_count() elements in every shard
+    auto reserve(size_t count) -> void;
+
+    auto insert(const value_type &value) -> bool;
+    auto insert(value_type &&value) -> bool;
+    template <class... Args>
+    auto emplace(Args &&...args) -> bool;
+
+    auto erase(const value_type &value) -> size_t;
+
+    [[nodiscard]] auto count(const value_type &value) const -> size_t;
+    [[nodiscard]] auto contains(const value_type &value) const -> bool;
+
+    // Calls fn(const value_type &) for every element, holding each shard's read lock while
+    // walking its dense array. With threads > 1 the shards are split across that many threads
+    // and fn must be safe to call concurrently.
+    template <class F>
+    auto for_each(F &&fn, size_t threads = 1) const -> void;
+
+private:
+    using shard_type = sparse_shard<set_type, Mutex>;
+    using read_lock  = sparse_read_lock<Mutex>;
+
+    size_t                        shard_total;
+    std::unique_ptr<shard_type[]> shards;
+    [[no_unique_address]] hasher  hash_fn;
+
+private:
+    // The hash picks the shard and is handed on to it, so each operation hashes its value once
+    auto shard_of(size_t hash_code) const -> shard_type & {
+        return shards[sparse_shard_index(hash_code, shard_total)];
+    }
+};
+
+#define _concurrent_sparse_set_template \
+    template <typename T, typename Hash, typename KeyEqual, typename Allocator, typename Mutex>
+#define _concurrent_sparse_set_def concurrent_sparse_set<T, Hash, KeyEqual, Allocator, Mutex>
+
+_concurrent_sparse_set_template
+inline _concurrent_sparse_set_def::concurrent_sparse_set(
+    size_t shard_count, const hasher &hash, const key_equal &equal, const allocator_type &alloc
+)
+    : shard_total(std::bit_ceil(std::max<size_t>(shard_count, 1)))
+    , shards(std::make_unique<shard_type[]>(shard_total))
+    , hash_fn(hash) {
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        shards[idx].set = set_type(INIT_SPARSE_SIZE, hash, equal, alloc);
+    }
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::size() const -> size_t {
+    size_t total = 0;
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        read_lock lock(shards[idx].mutex);
+        total += shards[idx].set.size();
+    }
+    return total;
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::empty() const -> bool {
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        read_lock lock(shards[idx].mutex);
+        if (!shards[idx].set.empty()) return false;
+    }
+    return true;
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::clear() -> void {
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        std::unique_lock lock(shards[idx].mutex);
+        shards[idx].set.clear();
+    }
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::reserve(size_t count) -> void {
+    size_t per_shard = (count + shard_total - 1) / shard_total;
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        std::unique_lock lock(shards[idx].mutex);
+        shards[idx].set.reserve(per_shard);
+    }
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::insert(const value_type &value) -> bool {
+    size_t           hash_code = hash_fn(value);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    return shard.set.insert_hashed(value, hash_code).second;
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::insert(value_type &&value) -> bool {
+    size_t           hash_code = hash_fn(value);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    return shard.set.insert_hashed(std::move(value), hash_code).second;
+}
+
+_concurrent_sparse_set_template
+template <class... Args>
+inline auto _concurrent_sparse_set_def::emplace(Args &&...args) -> bool {
+    // The shard is only known from the value, so it is built before any lock is taken
+    return insert(value_type(std::forward<Args>(args)...));
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::erase(const value_type &value) -> size_t {
+    size_t           hash_code = hash_fn(value);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    return shard.set.erase_hashed(value, hash_code);
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::count(const value_type &value) const -> size_t {
+    return contains(value) ? 1 : 0;
+}
+
+_concurrent_sparse_set_template
+inline auto _concurrent_sparse_set_def::contains(const value_type &value) const -> bool {
+    size_t     hash_code = hash_fn(value);
+    auto      &shard     = shard_of(hash_code);
+    read_lock  lock(shard.mutex);
+    return shard.set.contains_hashed(value, hash_code);
+}
+
+_concurrent_sparse_set_template
+template <class F>
+inline auto _concurrent_sparse_set_def::for_each(F &&fn, size_t threads) const -> void {
+    threads = std::clamp<size_t>(threads, 1, shard_total);
+    sparse_parallel_for(threads, [&](size_t thread) {
+        for (size_t idx = thread; idx < shard_total; idx += threads) {
+            read_lock lock(shards[idx].mutex);
+            for (const auto &value : shards[idx].set) {
+                fn(value);
+            }
+        }
+    });
+}
+
+#undef _concurrent_sparse_set_template
+#undef _concurrent_sparse_set_def
+
+// Lock-striped map counterpart. Lookups copy the mapped value out, or run a callback on it
+// under the shard lock, because a reference would outlive the lock that protects it.
+template <
+    typename Key,
+    typename T,
+    typename Hash      = std::hash<Key>,
+    typename KeyEqual  = std::equal_to<Key>,
+    typename Allocator = std::allocator<T>,
+    typename Mutex     = std::mutex>
+class concurrent_sparse_key_set {
+public:
+    using key_type       = Key;
+    using mapped_type    = T;
+    using value_type     = T;
+    using hasher         = Hash;
+    using key_equal      = KeyEqual;
+    using allocator_type = Allocator;
+    using set_type       = sparse_key_set<Key, T, Hash, KeyEqual, Allocator>;
+
+    // shard_count is rounded up to a power of two
+    explicit concurrent_sparse_key_set(
+        size_t                shard_count = CONCURRENT_SHARDS,
+        const hasher         &hash        = hasher(),
+        const key_equal      &equal       = key_equal(),
+        const allocator_type &alloc       = allocator_type()
+    );
+
+    concurrent_sparse_key_set(const concurrent_sparse_key_set &) = delete;
+    auto operator=(const concurrent_sparse_key_set &) -> concurrent_sparse_key_set & = delete;
+
+    [[nodiscard]] auto shard_count() const -> size_t { return shard_total; }
+    [[nodiscard]] auto size() const -> size_t;
+    [[nodiscard]] auto empty() const -> bool;
+
+    auto clear() -> void;
+    // Reserves count / shard_count() elements in every shard
+    auto reserve(size_t count) -> void;
+
+    // All three return whether the key was newly inserted
+    template <class V>
+    auto insert(const key_type &key, V &&value) -> bool;
+    template <class... Args>
+    auto try_emplace(const key_type &key, Args &&...args) -> bool;
+    template <class M>
+    auto insert_or_assign(const key_type &key, M &&obj) -> bool;
+
+    auto erase(const key_type &key) -> size_t;
+
+    [[nodiscard]] auto contains(const key_type &key) const -> bool;
+    [[nodiscard]] auto find(const key_type &key) const -> std::optional<value_type>;
+
+    // Calls fn(value_type &) under the shard's exclusive lock; false when the key is absent
+    template <class F>
+    auto visit(const key_type &key, F &&fn) -> bool;
+    // Calls fn(const value_type &) under the shard's read lock
+    template <class F>
+    auto visit(const key_type &key, F &&fn) const -> bool;
+
+    // Calls fn(const key_type &, const value_type &) for every pair, holding each shard's
+    // read lock while walking its dense arrays. With threads > 1 the shards are split across
+    // that many threads and fn must be safe to call concurrently.
+    template <class F>
+    auto for_each(F &&fn, size_t threads = 1) const -> void;
+
+private:
+    using shard_type = sparse_shard<set_type, Mutex>;
+    using read_lock  = sparse_read_lock<Mutex>;
+
+    size_t                        shard_total;
+    std::unique_ptr<shard_type[]> shards;
+    [[no_unique_address]] hasher  hash_fn;
+
+private:
+    // The hash picks the shard and is handed on to it, so each operation hashes its key once
+    auto shard_of(size_t hash_code) const -> shard_type & {
+        return shards[sparse_shard_index(hash_code, shard_total)];
+    }
+};
+
+#define _concurrent_sparse_key_set_template                                                  \
+    template <                                                                           \
+        typename Key, typename T, typename Hash, typename KeyEqual, typename Allocator, \
+        typename Mutex>
+#define _concurrent_sparse_key_set_def \
+    concurrent_sparse_key_set<Key, T, Hash, KeyEqual, Allocator, Mutex>
+
+_concurrent_sparse_key_set_template
+inline _concurrent_sparse_key_set_def::concurrent_sparse_key_set(
+    size_t shard_count, const hasher &hash, const key_equal &equal, const allocator_type &alloc
+)
+    : shard_total(std::bit_ceil(std::max<size_t>(shard_count, 1)))
+    , shards(std::make_unique<shard_type[]>(shard_total))
+    , hash_fn(hash) {
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        shards[idx].set = set_type(INIT_SPARSE_SIZE, hash, equal, alloc);
+    }
+}
+
+_concurrent_sparse_key_set_template
+inline auto _concurrent_sparse_key_set_def::size() const -> size_t {
+    size_t total = 0;
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        read_lock lock(shards[idx].mutex);
+        total += shards[idx].set.size();
+    }
+    return total;
+}
+
+_concurrent_sparse_key_set_template
+inline auto _concurrent_sparse_key_set_def::empty() const -> bool {
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        read_lock lock(shards[idx].mutex);
+        if (!shards[idx].set.empty()) return false;
+    }
+    return true;
+}
+
+_concurrent_sparse_key_set_template
+inline auto _concurrent_sparse_key_set_def::clear() -> void {
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        std::unique_lock lock(shards[idx].mutex);
+        shards[idx].set.clear();
+    }
+}
+
+_concurrent_sparse_key_set_template
+inline auto _concurrent_sparse_key_set_def::reserve(size_t count) -> void {
+    size_t per_shard = (count + shard_total - 1) / shard_total;
+    for (size_t idx = 0; idx < shard_total; ++idx) {
+        std::unique_lock lock(shards[idx].mutex);
+        shards[idx].set.reserve(per_shard);
+    }
+}
+
+_concurrent_sparse_key_set_template
+template <class V>
+inline auto _concurrent_sparse_key_set_def::insert(const key_type &key, V &&value) -> bool {
+    size_t           hash_code = hash_fn(key);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    return shard.set.try_emplace_hashed(key, hash_code, std::forward<V>(value)).second;
+}
+
+_concurrent_sparse_key_set_template
+template <class... Args>
+inline auto _concurrent_sparse_key_set_def::try_emplace(const key_type &key, Args &&...args)
+    -> bool {
+    size_t           hash_code = hash_fn(key);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    return shard.set.try_emplace_hashed(key, hash_code, std::forward<Args>(args)...).second;
+}
+
+_concurrent_sparse_key_set_template
+template <class M>
+inline auto _concurrent_sparse_key_set_def::insert_or_assign(const key_type &key, M &&obj)
+    -> bool {
+    size_t           hash_code = hash_fn(key);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    return shard.set.insert_or_assign_hashed(key, hash_code, std::forward<M>(obj)).second;
+}
+
+_concurrent_sparse_key_set_template
+inline auto _concurrent_sparse_key_set_def::erase(const key_type &key) -> size_t {
+    size_t           hash_code = hash_fn(key);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    return shard.set.erase_hashed(key, hash_code);
+}
+
+_concurrent_sparse_key_set_template
+inline auto _concurrent_sparse_key_set_def::contains(const key_type &key) const -> bool {
+    size_t     hash_code = hash_fn(key);
+    auto      &shard     = shard_of(hash_code);
+    read_lock  lock(shard.mutex);
+    return shard.set.contains_hashed(key, hash_code);
+}
+
+_concurrent_sparse_key_set_template
+inline auto _concurrent_sparse_key_set_def::find(const key_type &key) const
+    -> std::optional<value_type> {
+    size_t     hash_code = hash_fn(key);
+    auto      &shard     = shard_of(hash_code);
+    read_lock  lock(shard.mutex);
+    auto       it = shard.set.find_hashed(key, hash_code);
+    if (it == shard.set.end()) return std::nullopt;
+    return *it;
+}
+
+_concurrent_sparse_key_set_template
+template <class F>
+inline auto _concurrent_sparse_key_set_def::visit(const key_type &key, F &&fn) -> bool {
+    size_t           hash_code = hash_fn(key);
+    auto            &shard     = shard_of(hash_code);
+    std::unique_lock lock(shard.mutex);
+    auto             it = shard.set.find_hashed(key, hash_code);
+    if (it == shard.set.end()) return false;
+    std::forward<F>(fn)(*it);
+    return true;
+}
+
+_concurrent_sparse_key_set_template
+template <class F>
+inline auto _concurrent_sparse_key_set_def::visit(const key_type &key, F &&fn) const -> bool {
+    size_t      hash_code = hash_fn(key);
+    const auto &shard     = shard_of(hash_code);
+    read_lock   lock(shard.mutex);
+    auto        it = std::as_const(shard.set).find_hashed(key, hash_code);
+    if (it == shard.set.end()) return false;
+    std::forward<F>(fn)(*it);
+    return true;
+}
+
+_concurrent_sparse_key_set_template
+template <class F>
+inline auto _concurrent_sparse_key_set_def::for_each(F &&fn, size_t threads) const -> void {
+    threads = std::clamp<size_t>(threads, 1, shard_total);
+    sparse_parallel_for(threads, [&](size_t thread) {
+        for (size_t idx = thread; idx < shard_total; idx += threads) {
+            read_lock   lock(shards[idx].mutex);
+            const auto &set  = shards[idx].set;
+            auto        keys = set.keys();
+            for (size_t pos = 0; pos < keys.size(); ++pos) {
+                fn(keys[pos], set.begin()[static_cast<std::ptrdiff_t>(pos)]);
+            }
+        }
+    });
+}
+
+#undef _concurrent_sparse_key_set_template
+#undef _concurrent_sparse_key_set_def
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef _DIRECT_SPARSE_SET_HPP
+#define _DIRECT_SPARSE_SET_HPP
+
+#include <algorithm>
+#include <concepts>
+#include <initializer_list>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "./common.hpp"
+#include "./paged-array.hpp"
+
+#ifndef INIT_SPARSE_SIZE
+#    define INIT_SPARSE_SIZE 32
+#endif
+
+// Classic sparse set for unsigned integer keys: the sparse array is indexed by the key itself and
+// holds its dense position, so there is no hashing or probing. A key is present when its sparse
+// entry points at a dense slot that holds that same key, which lets stale entries stay behind
+// after erase. Same dense layout and swap-remove erase as sparse_set.
+// The sparse array is paged (paged-array.hpp): pages of PageSize entries are allocated when a key
+// in them is inserted and freed when the last one is erased, so clustered ids from a huge
+// universe cost memory per occupied page plus one page pointer per PageSize keys of range.
+template <
+    typename T,
+    typename Allocator    = std::allocator<T>,
+    typename DenseStorage = vector_storage,
+    size_t PageSize       = SPARSE_PAGE_SIZE>
+class direct_sparse_set {
+    static_assert(std::unsigned_integral<T>, "direct_sparse_set keys must be unsigned integers");
+
+public:
+    using key_type       = T;
+    using value_type     = T;
+    using allocator_type = Allocator;
+    using dense_storage  = DenseStorage;
+
+private:
+    using dense_arr_type = typename dense_storage::template type<value_type, allocator_type>;
+
+    using pos_type        = sparse_entry::pos_type;
+    using sparse_arr_type = paged_array<
+        pos_type,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<pos_type>,
+        PageSize>;
+
+public:
+    using iterator               = typename dense_arr_type::iterator;
+    using const_iterator         = typename dense_arr_type::const_iterator;
+    using reverse_iterator       = typename dense_arr_type::reverse_iterator;
+    using const_reverse_iterator = typename dense_arr_type::const_reverse_iterator;
+
+public:
+    direct_sparse_set() : direct_sparse_set(INIT_SPARSE_SIZE) {}
+    // universe: the page table covers keys below it up front, larger ones grow it on insert
+    explicit direct_sparse_set(size_t universe, const allocator_type &alloc = allocator_type())
+      : dense_arr(alloc), sparse_arr(alloc) {
+        sparse_arr.resize(universe);
+    }
+    ~direct_sparse_set() = default;
+
+    direct_sparse_set(const direct_sparse_set &)                     = default;
+    auto operator=(const direct_sparse_set &) -> direct_sparse_set & = default;
+
+    direct_sparse_set(direct_sparse_set &&) noexcept            = default;
+    auto operator=(direct_sparse_set &&) -> direct_sparse_set & = default;
+
+public:
+    [[nodiscard]] auto size() const -> size_t { return dense_arr.size(); }
+    [[nodiscard]] auto empty() const -> bool { return dense_arr.empty(); }
+    [[nodiscard]] auto capacity() const -> size_t { return dense_arr.capacity(); }
+
+    // One past the largest key the page table currently covers
+    [[nodiscard]] auto sparse_size() const -> size_t { return sparse_arr.size(); }
+    // Sparse pages currently allocated, each of sparse_arr_type::page_size entries
+    [[nodiscard]] auto page_count() const -> size_t { return sparse_arr.page_count(); }
+
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return dense_arr.get_allocator(); }
+
+    auto begin() -> iterator { return dense_arr.begin(); }
+    auto end() -> iterator { return dense_arr.end(); }
+    auto begin() const -> const_iterator { return dense_arr.begin(); }
+    auto end() const -> const_iterator { return dense_arr.end(); }
+    auto cbegin() const -> const_iterator { return dense_arr.cbegin(); }
+    auto cend() const -> const_iterator { return dense_arr.cend(); }
+
+    auto rbegin() -> reverse_iterator { return dense_arr.rbegin(); }
+    auto rend() -> reverse_iterator { return dense_arr.rend(); }
+    auto rbegin() const -> const_reverse_iterator { return dense_arr.rbegin(); }
+    auto rend() const -> const_reverse_iterator { return dense_arr.rend(); }
+    auto crbegin() const -> const_reverse_iterator { return dense_arr.crbegin(); }
+    auto crend() const -> const_reverse_iterator { return dense_arr.crend(); }
+
+    // Frees every sparse page; the page table keeps its size
+    auto clear() noexcept -> void {
+        dense_arr.clear();
+        sparse_arr.clear();
+    }
+
+    auto insert(const value_type &value) -> std::pair<iterator, bool>;
+    template <class InputIt>
+    auto insert(InputIt first, InputIt last) -> void;
+    auto insert(std::initializer_list<value_type> ilist) -> void;
+
+    auto insert_range(container_compatible_range<value_type> auto &&rg) -> void;
+
+    template <class... Args>
+    auto emplace(Args &&...args) -> std::pair<iterator, bool>;
+
+    auto erase(const value_type &value) -> size_t;
+    // Moves the last element into the erased slot; returns an iterator to that slot
+    auto erase(const_iterator pos) -> iterator;
+
+    auto find(const value_type &value) -> iterator;
+    auto find(const value_type &value) const -> const_iterator;
+    auto count(const value_type &value) const -> size_t;
+    auto contains(const value_type &value) const -> bool;
+
+    auto swap(direct_sparse_set &other) noexcept(
+        std::allocator_traits<allocator_type>::is_always_equal::value
+    ) -> void;
+
+    // Extends the page table over every key below new_sparse_size without allocating pages
+    auto rehash(size_t new_sparse_size) -> void;
+
+    auto reserve(size_t count) -> void;
+
+private:
+    dense_arr_type  dense_arr;
+    sparse_arr_type sparse_arr;
+
+private:
+    // Dense position of value, or size() when absent
+    auto find_pos(const value_type &value) const -> size_t {
+        const pos_type *entry = sparse_arr.find(value);
+        if (entry == nullptr) return size();
+        size_t pos = *entry;
+        return pos < size() && dense_arr[pos] == value ? pos : size();
+    }
+
+    auto erase_pos(size_t pos) -> void;
+};
+
+#define _direct_sparse_set_template \
+    template <typename T, typename Allocator, typename DenseStorage, size_t PageSize>
+#define _direct_sparse_set_def direct_sparse_set<T, Allocator, DenseStorage, PageSize>
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::insert(const value_type &value) -> std::pair<iterator, bool> {
+    size_t pos = find_pos(value);
+    if (pos < size()) return {begin() + static_cast<std::ptrdiff_t>(pos), false};
+
+    if (size() >= sparse_entry::max_pos) {
+        throw std::length_error("direct_sparse_set: size exceeds the sparse entry position range");
+    }
+    sparse_arr.acquire(value) = static_cast<pos_type>(size());
+    try {
+        dense_arr.push_back(value);
+    } catch (...) {
+        sparse_arr.release(value);
+        throw;
+    }
+
+    return {end() - 1, true};
+}
+
+_direct_sparse_set_template
+template <class InputIt>
+inline auto _direct_sparse_set_def::insert(InputIt first, InputIt last) -> void {
+    for (; first != last; ++first) {
+        (void)insert(*first);
+    }
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::insert(std::initializer_list<value_type> ilist) -> void {
+    insert(ilist.begin(), ilist.end());
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::insert_range(container_compatible_range<value_type> auto &&rg)
+    -> void {
+    for (auto &&v : rg) {
+        (void)insert(v);
+    }
+}
+
+_direct_sparse_set_template
+template <class... Args>
+inline auto _direct_sparse_set_def::emplace(Args &&...args) -> std::pair<iterator, bool> {
+    return insert(value_type{std::forward<Args>(args)...});
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::erase(const value_type &value) -> size_t {
+    size_t pos = find_pos(value);
+    if (pos == size()) return 0;
+    erase_pos(pos);
+    return 1;
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::erase(const_iterator pos) -> iterator {
+    auto idx = static_cast<size_t>(pos - cbegin());
+    erase_pos(idx);
+    return begin() + static_cast<std::ptrdiff_t>(idx);
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::find(const value_type &value) -> iterator {
+    return begin() + static_cast<std::ptrdiff_t>(find_pos(value));
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::find(const value_type &value) const -> const_iterator {
+    return begin() + static_cast<std::ptrdiff_t>(find_pos(value));
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::count(const value_type &value) const -> size_t {
+    return (find_pos(value) < size() ? 1 : 0);
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::contains(const value_type &value) const -> bool {
+    return find_pos(value) < size();
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::swap(direct_sparse_set &other) noexcept(
+    std::allocator_traits<allocator_type>::is_always_equal::value
+) -> void {
+    dense_arr.swap(other.dense_arr);
+    sparse_arr.swap(other.sparse_arr);
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::rehash(size_t new_sparse_size) -> void {
+    sparse_arr.resize(new_sparse_size);
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::reserve(size_t count) -> void {
+    dense_arr.reserve(count);
+}
+
+_direct_sparse_set_template
+inline auto _direct_sparse_set_def::erase_pos(size_t pos) -> void {
+    value_type key   = dense_arr[pos];
+    value_type back  = dense_arr.back();
+    dense_arr[pos]   = back;
+    sparse_arr[back] = static_cast<pos_type>(pos);
+    dense_arr.pop_back();
+    sparse_arr.release(key);
+}
+
+_direct_sparse_set_template
+auto swap(_direct_sparse_set_def &lhs, _direct_sparse_set_def &rhs)
+    noexcept(noexcept(lhs.swap(rhs))) -> void {
+    lhs.swap(rhs);
+}
+
+#undef _direct_sparse_set_template
+#undef _direct_sparse_set_def
+
+#endif
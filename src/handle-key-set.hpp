@@ -0,0 +1,238 @@
+#ifndef _HANDLE_KEY_SET_HPP
+#define _HANDLE_KEY_SET_HPP
+
+#include <concepts>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "./sparse-key-set.hpp"
+
+// Entity handle packing a slot index into the low IndexBits bits of U and a generation into the
+// rest. Generations start at 1, so a default-constructed handle is null and never matches.
+template <std::unsigned_integral U = std::uint64_t, size_t IndexBits = 32>
+struct sparse_handle {
+    static_assert(
+        IndexBits > 0 && IndexBits < std::numeric_limits<U>::digits,
+        "sparse_handle needs both index and generation bits"
+    );
+
+    using value_type = U;
+
+    static constexpr size_t     index_bits     = IndexBits;
+    static constexpr value_type max_index      = (value_type{1} << IndexBits) - 1;
+    static constexpr value_type max_generation = std::numeric_limits<value_type>::max()
+                                                 >> IndexBits;
+
+    value_type bits{0};
+
+    constexpr sparse_handle() = default;
+    constexpr sparse_handle(value_type index, value_type generation)
+        : bits(static_cast<value_type>((generation << IndexBits) | index)) {}
+
+    [[nodiscard]] constexpr auto index() const -> value_type { return bits & max_index; }
+    [[nodiscard]] constexpr auto generation() const -> value_type { return bits >> IndexBits; }
+    [[nodiscard]] constexpr auto is_null() const -> bool { return bits == 0; }
+
+    friend constexpr auto operator==(sparse_handle, sparse_handle) -> bool = default;
+};
+
+template <std::unsigned_integral U, size_t IndexBits>
+struct std::hash<sparse_handle<U, IndexBits>> {
+    auto operator()(sparse_handle<U, IndexBits> handle) const noexcept -> size_t {
+        return std::hash<U>{}(handle.bits);
+    }
+};
+
+// Free-list allocator of handle indices. A released index is handed out again with its
+// generation bumped, so every handle issued for it before compares unequal to the new one. An
+// index whose generation is exhausted is retired instead of wrapping around.
+template <class Handle = sparse_handle<>, class Allocator = std::allocator<Handle>>
+class handle_pool {
+public:
+    using handle_type    = Handle;
+    using allocator_type = Allocator;
+
+private:
+    using index_type     = typename handle_type::value_type;
+    using index_arr_type = std::vector<
+        index_type,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<index_type>>;
+
+public:
+    handle_pool() : handle_pool(allocator_type()) {}
+    explicit handle_pool(const allocator_type &alloc) : generations(alloc), free_list(alloc) {}
+
+    // Indices ever handed out, live or not
+    [[nodiscard]] auto capacity() const -> size_t { return generations.size(); }
+    // Released indices waiting to be reused
+    [[nodiscard]] auto free_count() const -> size_t { return free_list.size(); }
+
+    // Handle for a recycled index, or a fresh one when none is free
+    auto acquire() -> handle_type;
+    // Its index comes back from acquire() under the next generation; a handle that is not live
+    // (stale, already released, null or from another pool) is ignored
+    auto release(handle_type handle) -> void;
+
+    // Frees every index under a new generation, retiring exhausted ones, so no handle issued so
+    // far is valid again once its index is reissued
+    auto clear() -> void;
+    auto reserve(size_t count) -> void { generations.reserve(count); }
+
+private:
+    // Per index: generation of its live handle, or of the next one issued once it is released
+    index_arr_type generations;
+    index_arr_type free_list;
+};
+
+// sparse_key_set keyed by generational handles, with the handles issued by a handle_pool. A
+// stale handle carries an old generation, so it simply compares unequal to the live key: the
+// check rides on the key compare every hit already does, with no extra cache line and no
+// separate validation lookup.
+template <
+    typename T,
+    typename Handle       = sparse_handle<>,
+    typename Allocator    = std::allocator<T>,
+    typename DenseStorage = vector_storage>
+class handle_key_set {
+public:
+    using handle_type    = Handle;
+    using value_type     = T;
+    using allocator_type = Allocator;
+    using map_type       = sparse_key_set<
+        Handle, T, std::hash<Handle>, std::equal_to<Handle>, Allocator, fibonacci_slot_policy,
+        false, DenseStorage>;
+
+    using iterator       = typename map_type::iterator;
+    using const_iterator = typename map_type::const_iterator;
+
+public:
+    handle_key_set() : handle_key_set(allocator_type()) {}
+    explicit handle_key_set(const allocator_type &alloc) : map(0, {}, {}, alloc), pool(alloc) {}
+
+public:
+    [[nodiscard]] auto size() const -> size_t { return map.size(); }
+    [[nodiscard]] auto empty() const -> bool { return map.empty(); }
+    [[nodiscard]] auto capacity() const -> size_t { return map.capacity(); }
+    // Released handle indices waiting to be reissued
+    [[nodiscard]] auto free_count() const -> size_t { return pool.free_count(); }
+
+    auto begin() -> iterator { return map.begin(); }
+    auto end() -> iterator { return map.end(); }
+    auto begin() const -> const_iterator { return map.begin(); }
+    auto end() const -> const_iterator { return map.end(); }
+    auto cbegin() const -> const_iterator { return map.cbegin(); }
+    auto cend() const -> const_iterator { return map.cend(); }
+
+    // Live handles in dense order, parallel to [begin(), end())
+    [[nodiscard]] auto handles() const -> std::span<const handle_type> { return map.keys(); }
+
+    // Constructs a value under a new handle, reusing a released index when there is one
+    template <class... Args>
+    auto create(Args &&...args) -> handle_type;
+    // Erases the value and recycles its index; false when handle is stale or null
+    auto destroy(handle_type handle) -> bool;
+    // Destroys every value, recycling all their indices
+    auto clear() -> void;
+
+    auto find(handle_type handle) -> iterator { return map.find(handle); }
+    auto find(handle_type handle) const -> const_iterator { return map.find(handle); }
+    auto contains(handle_type handle) const -> bool { return map.contains(handle); }
+    auto at(handle_type handle) -> value_type & { return map.at(handle); }
+    auto at(handle_type handle) const -> const value_type & { return map.at(handle); }
+
+    auto reserve(size_t count) -> void {
+        map.reserve(count);
+        pool.reserve(count);
+    }
+
+private:
+    map_type                            map;
+    handle_pool<handle_type, Allocator> pool;
+};
+
+#define _handle_pool_template template <class Handle, class Allocator>
+#define _handle_pool_def handle_pool<Handle, Allocator>
+
+_handle_pool_template
+inline auto _handle_pool_def::acquire() -> handle_type {
+    if (!free_list.empty()) {
+        index_type index = free_list.back();
+        free_list.pop_back();
+        return handle_type(index, generations[index]);
+    }
+    if (generations.size() > handle_type::max_index) {
+        throw std::length_error("handle_pool: handle index range exhausted");
+    }
+    generations.push_back(1);
+    return handle_type(static_cast<index_type>(generations.size() - 1), 1);
+}
+
+_handle_pool_template
+inline auto _handle_pool_def::release(handle_type handle) -> void {
+    if (handle.index() >= generations.size()) return;
+    index_type &generation = generations[handle.index()];
+    // Releasing twice would put the index on the free list twice, and hand it out twice
+    if (handle.generation() != generation) return;
+    // Retired for good: the next generation would wrap around to handles still out there
+    if (generation == handle_type::max_generation) return;
+    generation++;
+    free_list.push_back(handle.index());
+}
+
+_handle_pool_template
+inline auto _handle_pool_def::clear() -> void {
+    free_list.reserve(generations.size());
+    free_list.clear();
+    // Highest index first, so acquire() hands the low ones out again first
+    for (size_t index = generations.size(); index-- > 0;) {
+        if (generations[index] == handle_type::max_generation) continue;
+        generations[index]++;
+        free_list.push_back(static_cast<index_type>(index));
+    }
+}
+
+#undef _handle_pool_template
+#undef _handle_pool_def
+
+#define _handle_key_set_template \
+    template <typename T, typename Handle, typename Allocator, typename DenseStorage>
+#define _handle_key_set_def handle_key_set<T, Handle, Allocator, DenseStorage>
+
+_handle_key_set_template
+template <class... Args>
+inline auto _handle_key_set_def::create(Args &&...args) -> handle_type {
+    handle_type handle = pool.acquire();
+    try {
+        map.try_emplace(handle, std::forward<Args>(args)...);
+    } catch (...) {
+        pool.release(handle);
+        throw;
+    }
+    return handle;
+}
+
+_handle_key_set_template
+inline auto _handle_key_set_def::destroy(handle_type handle) -> bool {
+    if (map.erase(handle) == 0) return false;
+    pool.release(handle);
+    return true;
+}
+
+_handle_key_set_template
+inline auto _handle_key_set_def::clear() -> void {
+    for (handle_type handle : map.keys()) {
+        pool.release(handle);
+    }
+    map.clear();
+}
+
+#undef _handle_key_set_template
+#undef _handle_key_set_def
+
+#endif
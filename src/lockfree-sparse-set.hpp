@@ -0,0 +1,488 @@
+#ifndef _LOCKFREE_SPARSE_SET_HPP
+#define _LOCKFREE_SPARSE_SET_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "./common.hpp"
+
+#ifndef INIT_SPARSE_SIZE
+#    define INIT_SPARSE_SIZE 32
+#endif
+#ifndef SPARSE_SIZE_GROW
+#    define SPARSE_SIZE_GROW 2
+#endif
+#ifndef LOCKFREE_LOAD_FACTOR
+#    define LOCKFREE_LOAD_FACTOR 0.5
+#endif
+#ifndef LOCKFREE_MIGRATE_CHUNK
+#    define LOCKFREE_MIGRATE_CHUNK 256
+#endif
+
+// Grow-only set for concurrent insert and lookup, with no erase. Elements are appended to a
+// dense array made of geometrically sized segments that never move, and a linear-probing index
+// of 64-bit words (32-bit dense position, 31-bit fingerprint, moved bit) is updated by CAS.
+//
+// An insert reserves its index slot first and only then bumps the dense tail and constructs the
+// element, so a duplicate never takes a dense position. Another thread inserting an equal value
+// meanwhile waits for that slot to be published. When the index passes LOCKFREE_LOAD_FACTOR, a
+// table twice the size is linked behind it and every thread that touches the old table helps
+// copy it over in LOCKFREE_MIGRATE_CHUNK-slot chunks. Replaced tables are kept until the set is
+// destroyed, since a reader may still be probing one; they add up to less than the live index.
+template <
+    typename T,
+    typename Hash      = std::hash<T>,
+    typename KeyEqual  = std::equal_to<T>,
+    typename Allocator = std::allocator<T>>
+class lockfree_sparse_set {
+public:
+    using value_type     = T;
+    using hasher         = Hash;
+    using key_equal      = KeyEqual;
+    using allocator_type = Allocator;
+
+    static_assert(
+        std::is_nothrow_move_constructible_v<value_type>,
+        "lockfree_sparse_set moves values into place after their slot is claimed"
+    );
+
+    // Sizes the index and the dense segments for capacity elements up front. Growing the dense
+    // array later allocates while other threads may be waiting on the claimed slot, so running
+    // out of memory there terminates instead of throwing.
+    explicit lockfree_sparse_set(
+        size_t                capacity = INIT_SPARSE_SIZE,
+        const hasher         &hash     = hasher(),
+        const key_equal      &equal    = key_equal(),
+        const allocator_type &alloc    = allocator_type()
+    );
+    ~lockfree_sparse_set();
+
+    lockfree_sparse_set(const lockfree_sparse_set &)                     = delete;
+    auto operator=(const lockfree_sparse_set &) -> lockfree_sparse_set & = delete;
+
+    // Counts elements whose insert has claimed a dense position, including ones still in flight
+    [[nodiscard]] auto size() const -> size_t { return tail.load(std::memory_order_acquire); }
+    [[nodiscard]] auto empty() const -> bool { return size() == 0; }
+    [[nodiscard]] auto sparse_size() const -> size_t;
+
+    [[nodiscard]] static constexpr auto max_size() -> size_t { return busy_pos - 1; }
+
+    // Safe to call from any number of threads at once, together with contains()
+    auto insert(const value_type &value) -> bool;
+    auto insert(value_type &&value) -> bool;
+    template <class... Args>
+    auto emplace(Args &&...args) -> bool;
+
+    [[nodiscard]] auto count(const value_type &value) const -> size_t;
+    [[nodiscard]] auto contains(const value_type &value) const -> bool;
+
+    // Calls fn(const value_type &) for every element in insertion order, or split into threads
+    // contiguous runs of the dense array. Only valid once every insert has returned.
+    template <class F>
+    auto for_each(F &&fn, size_t threads = 1) const -> void;
+
+private:
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+    static constexpr std::uint64_t busy_pos         = 0xFFFFFFFFULL;
+    static constexpr std::uint64_t moved_bit        = 1;
+    static constexpr std::uint64_t moved_empty      = moved_bit;
+    static constexpr std::uint64_t fingerprint_mask = 0xFFFFFFFEULL;
+
+    // The first segment holds 2^first_segment_bits elements and each next one doubles, which
+    // covers every 32-bit dense position
+    static constexpr size_t first_segment_bits = 5;
+    static constexpr size_t segment_total      = 33 - first_segment_bits;
+
+    struct index_table {
+        explicit index_table(size_t size_)
+            : slots(std::make_unique<std::atomic<std::uint64_t>[]>(size_)), size(size_) {}
+
+        std::unique_ptr<std::atomic<std::uint64_t>[]> slots;
+        size_t                                        size;
+        std::atomic<index_table *>                    next{nullptr};
+        std::atomic<size_t>                           migrate_claimed{0};
+        std::atomic<size_t>                           migrate_done{0};
+    };
+
+    std::array<std::atomic<value_type *>, segment_total> segments{};
+    alignas(64) std::atomic<size_t> tail{0};
+
+    // head owns the chain of tables; root is the oldest one still being migrated from
+    index_table               *head;
+    std::atomic<index_table *> root;
+
+    [[no_unique_address]] allocator_type alloc;
+    [[no_unique_address]] hasher         hash_fn;
+    [[no_unique_address]] key_equal      equal_fn;
+
+private:
+    static auto pos_of(std::uint64_t word) -> std::uint64_t { return word >> 32U; }
+    static auto fingerprint_of(size_t hash_code) -> std::uint64_t {
+        return sparse_fingerprint(hash_code) & fingerprint_mask;
+    }
+    static auto home_slot(size_t hash_code, const index_table *table) -> size_t {
+        return fibonacci_slot_policy::slot(hash_code, table->size);
+    }
+    static auto next_slot(size_t slot, const index_table *table) -> size_t {
+        return fibonacci_slot_policy::next(slot, table->size);
+    }
+    static auto max_load(const index_table *table) -> size_t {
+        return static_cast<size_t>(static_cast<double>(table->size) * LOCKFREE_LOAD_FACTOR);
+    }
+
+    static auto segment_of(size_t pos) -> size_t {
+        return static_cast<size_t>(std::bit_width((pos >> first_segment_bits) + 1)) - 1;
+    }
+    static auto segment_begin(size_t segment) -> size_t {
+        return ((size_t{1} << segment) - 1) << first_segment_bits;
+    }
+    static auto segment_length(size_t segment) -> size_t {
+        return size_t{1} << (segment + first_segment_bits);
+    }
+
+    auto element(std::uint64_t word) const -> const value_type & {
+        size_t pos     = static_cast<size_t>(pos_of(word)) - 1;
+        size_t segment = segment_of(pos);
+        return segments[segment].load(std::memory_order_acquire)[pos - segment_begin(segment)];
+    }
+    auto ensure_segment(size_t segment) -> value_type *;
+
+    auto insert_value(value_type &&value) -> bool;
+    auto publish(std::atomic<std::uint64_t> &cell, std::uint64_t fingerprint, value_type &&value)
+        noexcept -> void;
+
+    auto grow(index_table *table) -> index_table *;
+    auto help_migrate(index_table *table) -> void;
+    auto migrate_slot(std::atomic<std::uint64_t> &cell, index_table *next) -> void;
+    auto place(index_table *table, std::uint64_t word) -> void;
+    auto advance_root() -> void;
+
+    template <class F>
+    auto for_each_in(size_t first, size_t last, F &fn) const -> void;
+};
+
+#define _lockfree_sparse_set_template \
+    template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+#define _lockfree_sparse_set_def lockfree_sparse_set<T, Hash, KeyEqual, Allocator>
+
+_lockfree_sparse_set_template
+inline _lockfree_sparse_set_def::lockfree_sparse_set(
+    size_t capacity, const hasher &hash, const key_equal &equal, const allocator_type &alloc_
+)
+    : alloc(alloc_), hash_fn(hash), equal_fn(equal) {
+    size_t needed
+        = static_cast<size_t>(static_cast<double>(capacity) / LOCKFREE_LOAD_FACTOR) + 1;
+    head = new index_table(fibonacci_slot_policy::valid_size(std::max<size_t>(needed, 2)));
+    root.store(head);
+
+    if (capacity == 0) return;
+    size_t last = segment_of(std::min(capacity, max_size()) - 1);
+    try {
+        for (size_t segment = 0; segment <= last; ++segment) {
+            ensure_segment(segment);
+        }
+    } catch (...) {
+        for (size_t segment = 0; segment <= last; ++segment) {
+            value_type *data = segments[segment].load();
+            if (data != nullptr) alloc_traits::deallocate(alloc, data, segment_length(segment));
+        }
+        delete head;
+        throw;
+    }
+}
+
+_lockfree_sparse_set_template
+inline _lockfree_sparse_set_def::~lockfree_sparse_set() {
+    size_t count = tail.load();
+    for (size_t segment = 0; segment < segment_total; ++segment) {
+        value_type *data = segments[segment].load();
+        if (data == nullptr) continue;
+        size_t begin = segment_begin(segment);
+        size_t end   = std::min(count, begin + segment_length(segment));
+        for (size_t pos = begin; pos < end; ++pos) {
+            alloc_traits::destroy(alloc, data + (pos - begin));
+        }
+        alloc_traits::deallocate(alloc, data, segment_length(segment));
+    }
+
+    for (index_table *table = head; table != nullptr;) {
+        index_table *next = table->next.load();
+        delete table;
+        table = next;
+    }
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::sparse_size() const -> size_t {
+    const index_table *table = root.load(std::memory_order_acquire);
+    const index_table *next  = table->next.load(std::memory_order_acquire);
+    while (next != nullptr) {
+        table = next;
+        next  = table->next.load(std::memory_order_acquire);
+    }
+    return table->size;
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::insert(const value_type &value) -> bool {
+    if constexpr (!std::is_nothrow_copy_constructible_v<value_type>) {
+        // The copy has to exist before a slot is claimed; skip it when the value is a duplicate
+        if (contains(value)) return false;
+    }
+    return insert_value(value_type(value));
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::insert(value_type &&value) -> bool {
+    return insert_value(std::move(value));
+}
+
+_lockfree_sparse_set_template
+template <class... Args>
+inline auto _lockfree_sparse_set_def::emplace(Args &&...args) -> bool {
+    return insert_value(value_type(std::forward<Args>(args)...));
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::count(const value_type &value) const -> size_t {
+    return contains(value) ? 1 : 0;
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::contains(const value_type &value) const -> bool {
+    size_t        hash_code   = hash_fn(value);
+    std::uint64_t fingerprint = fingerprint_of(hash_code);
+
+    const index_table *table = root.load(std::memory_order_acquire);
+    size_t             slot  = home_slot(hash_code, table);
+    while (true) {
+        std::uint64_t word = table->slots[slot].load(std::memory_order_acquire);
+        if (word == 0) return false;
+        if (word == moved_empty) {
+            // Anything inserted past this point went into the next table
+            table = table->next.load(std::memory_order_acquire);
+            slot  = home_slot(hash_code, table);
+            continue;
+        }
+        // A slot still being published is an insert that has not happened yet
+        if ((word & fingerprint_mask) == fingerprint && pos_of(word) != busy_pos
+            && equal_fn(element(word), value)) {
+            return true;
+        }
+        slot = next_slot(slot, table);
+    }
+}
+
+_lockfree_sparse_set_template
+template <class F>
+inline auto _lockfree_sparse_set_def::for_each(F &&fn, size_t threads) const -> void {
+    size_t count = size();
+    if (threads <= 1 || count < threads) {
+        for_each_in(0, count, fn);
+        return;
+    }
+    sparse_parallel_for(threads, [&](size_t idx) {
+        for_each_in(count * idx / threads, count * (idx + 1) / threads, fn);
+    });
+}
+
+_lockfree_sparse_set_template
+template <class F>
+inline auto _lockfree_sparse_set_def::for_each_in(size_t first, size_t last, F &fn) const
+    -> void {
+    while (first < last) {
+        size_t            segment = segment_of(first);
+        size_t            begin   = segment_begin(segment);
+        size_t            end     = std::min(last, begin + segment_length(segment));
+        const value_type *data    = segments[segment].load(std::memory_order_acquire);
+        for (size_t pos = first; pos < end; ++pos) {
+            fn(data[pos - begin]);
+        }
+        first = end;
+    }
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::ensure_segment(size_t segment) -> value_type * {
+    value_type *data = segments[segment].load(std::memory_order_acquire);
+    if (data != nullptr) return data;
+
+    value_type *fresh = alloc_traits::allocate(alloc, segment_length(segment));
+    if (!segments[segment].compare_exchange_strong(data, fresh, std::memory_order_acq_rel)) {
+        alloc_traits::deallocate(alloc, fresh, segment_length(segment));
+        return data;
+    }
+    return fresh;
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::insert_value(value_type &&value) -> bool {
+    size_t        hash_code   = hash_fn(value);
+    std::uint64_t fingerprint = fingerprint_of(hash_code);
+
+    index_table *table = root.load(std::memory_order_acquire);
+    size_t       slot  = home_slot(hash_code, table);
+    while (true) {
+        auto         &cell = table->slots[slot];
+        std::uint64_t word = cell.load(std::memory_order_acquire);
+
+        if (word == 0) {
+            index_table *next = table->next.load(std::memory_order_acquire);
+            if (next == nullptr && tail.load(std::memory_order_relaxed) + 1 > max_load(table)) {
+                next = grow(table);
+            }
+            if (next != nullptr) {
+                // Close this probe sequence so no equal value can land in the old table behind
+                // us, then carry on in the new one
+                if (!cell.compare_exchange_strong(word, moved_empty, std::memory_order_acq_rel)) {
+                    continue;
+                }
+                help_migrate(table);
+                table = next;
+                slot  = home_slot(hash_code, table);
+                continue;
+            }
+
+            if (tail.load(std::memory_order_relaxed) >= max_size()) {
+                throw std::length_error("lockfree_sparse_set: dense positions exhausted");
+            }
+            if (!cell.compare_exchange_strong(
+                    word, (busy_pos << 32U) | fingerprint, std::memory_order_acq_rel
+                )) {
+                continue;
+            }
+            publish(cell, fingerprint, std::move(value));
+            return true;
+        }
+
+        if (word == moved_empty) {
+            help_migrate(table);
+            table = table->next.load(std::memory_order_acquire);
+            slot  = home_slot(hash_code, table);
+            continue;
+        }
+
+        if ((word & fingerprint_mask) == fingerprint) {
+            if (pos_of(word) == busy_pos) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (equal_fn(element(word), value)) return false;
+        }
+        slot = next_slot(slot, table);
+    }
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::publish(
+    std::atomic<std::uint64_t> &cell, std::uint64_t fingerprint, value_type &&value
+) noexcept -> void {
+    size_t      pos     = tail.fetch_add(1, std::memory_order_relaxed);
+    size_t      segment = segment_of(pos);
+    value_type *data    = ensure_segment(segment);
+    alloc_traits::construct(alloc, data + (pos - segment_begin(segment)), std::move(value));
+    cell.store(
+        (static_cast<std::uint64_t>(pos + 1) << 32U) | fingerprint, std::memory_order_release
+    );
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::grow(index_table *table) -> index_table * {
+    size_t size = fibonacci_slot_policy::valid_size(
+        static_cast<size_t>(static_cast<double>(table->size) * SPARSE_SIZE_GROW)
+    );
+    auto        *fresh    = new index_table(size);
+    index_table *expected = nullptr;
+    if (!table->next.compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+        delete fresh;
+        return expected;
+    }
+    return fresh;
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::help_migrate(index_table *table) -> void {
+    index_table *next = table->next.load(std::memory_order_acquire);
+    while (true) {
+        size_t begin
+            = table->migrate_claimed.fetch_add(LOCKFREE_MIGRATE_CHUNK, std::memory_order_relaxed);
+        if (begin >= table->size) return;
+
+        size_t end = std::min<size_t>(begin + LOCKFREE_MIGRATE_CHUNK, table->size);
+        for (size_t slot = begin; slot < end; ++slot) {
+            migrate_slot(table->slots[slot], next);
+        }
+        size_t done = table->migrate_done.fetch_add(end - begin, std::memory_order_acq_rel);
+        if (done + (end - begin) == table->size) advance_root();
+    }
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::migrate_slot(
+    std::atomic<std::uint64_t> &cell, index_table *next
+) -> void {
+    std::uint64_t word = cell.load(std::memory_order_acquire);
+    while (true) {
+        if (word == 0) {
+            if (cell.compare_exchange_strong(word, moved_empty, std::memory_order_acq_rel)) return;
+            continue;
+        }
+        if ((word & moved_bit) != 0) return;
+        if (pos_of(word) != busy_pos) break;
+        std::this_thread::yield();
+        word = cell.load(std::memory_order_acquire);
+    }
+
+    // Published words never change again, so the copy goes in before the old slot is marked
+    place(next, word);
+    cell.store(word | moved_bit, std::memory_order_release);
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::place(index_table *table, std::uint64_t word) -> void {
+    // Every value being migrated is distinct from the others and from anything inserted into
+    // the new table directly, so this only needs a free slot
+    size_t hash_code = hash_fn(element(word));
+    size_t slot      = home_slot(hash_code, table);
+    while (true) {
+        auto         &cell = table->slots[slot];
+        std::uint64_t cur  = cell.load(std::memory_order_acquire);
+        if (cur == 0) {
+            if (cell.compare_exchange_strong(cur, word, std::memory_order_acq_rel)) return;
+            continue;
+        }
+        if (cur == moved_empty) {
+            table = table->next.load(std::memory_order_acquire);
+            slot  = home_slot(hash_code, table);
+            continue;
+        }
+        slot = next_slot(slot, table);
+    }
+}
+
+_lockfree_sparse_set_template
+inline auto _lockfree_sparse_set_def::advance_root() -> void {
+    index_table *table = root.load(std::memory_order_acquire);
+    while (true) {
+        index_table *next = table->next.load(std::memory_order_acquire);
+        if (next == nullptr
+            || table->migrate_done.load(std::memory_order_acquire) != table->size) {
+            return;
+        }
+        if (root.compare_exchange_strong(table, next, std::memory_order_acq_rel)) table = next;
+    }
+}
+
+#undef _lockfree_sparse_set_template
+#undef _lockfree_sparse_set_def
+
+#endif
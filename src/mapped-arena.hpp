@@ -0,0 +1,333 @@
+#ifndef _MAPPED_ARENA_HPP
+#define _MAPPED_ARENA_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Virtual address range reserved for one arena, and so the most its file can grow to
+#ifndef MAPPED_ARENA_CAPACITY
+#    define MAPPED_ARENA_CAPACITY (std::size_t{1} << 40U)
+#endif
+
+// Address new arenas are first placed at, clear of where the heap and shared libraries go
+#ifndef MAPPED_ARENA_BASE
+#    define MAPPED_ARENA_BASE 0x100000000000ULL
+#endif
+
+// Persistent heap in one memory-mapped file. The file is mapped shared over the whole capacity up
+// front and only extended (ftruncate) as allocations reach its end, so memory already handed out
+// never moves and pages are faulted in from, and written back to, the file on demand: the working
+// set can exceed physical memory.
+// Reopening maps the file at the address it was created at, so raw pointers stored in it, such as
+// the ones inside a std::vector, stay valid. A set whose allocator is a mapped_allocator keeps all
+// of its arrays in the arena; built with root(), it is itself stored there and a later process
+// reopens it in constant time, without reading or rehashing anything.
+// Elements must not own memory outside the arena (a std::string key would). Nothing is crash
+// consistent: sync() makes the current state durable, a crash during an update can tear it.
+
+// Start of the mapping, and of the file
+struct mapped_arena_header {
+    static constexpr std::array<char, 8> magic_bytes{'S', 'P', 'S', 'E', 'T', 'M', 'A', 'P'};
+    static constexpr std::uint32_t       current_version = 1;
+
+    // Blocks are powers of two from min_block up; one free list per size
+    static constexpr size_t min_block   = 16;
+    static constexpr size_t block_sizes = 44;
+    // Blocks are aligned to their size up to a page, and larger freed blocks past their first
+    // page are handed back to the file system
+    static constexpr size_t page = 4096;
+
+    std::array<char, 8> magic{magic_bytes};
+    std::uint32_t       version{current_version};
+    // Descriptor of the process holding the arena open, which an allocation may extend it with
+    std::int32_t  fd{-1};
+    std::uint64_t base{0};
+    std::uint64_t capacity{0};
+    std::uint64_t file_size{0};
+    std::uint64_t used{0};
+    std::uint64_t root{0};
+    std::uint64_t root_size{0};
+    // Offset of the first free block of each size, 0 when none; each links to the next
+    std::array<std::uint64_t, block_sizes> free_heads{};
+
+    auto allocate(size_t bytes) -> void *;
+    auto deallocate(void *ptr, size_t bytes) noexcept -> void;
+
+    auto address(std::uint64_t offset) -> std::byte * {
+        return reinterpret_cast<std::byte *>(this) + offset;
+    }
+    auto offset_of(const void *ptr) const -> std::uint64_t {
+        return static_cast<std::uint64_t>(
+            static_cast<const std::byte *>(ptr) - reinterpret_cast<const std::byte *>(this)
+        );
+    }
+
+    static auto size_class(size_t bytes) -> size_t {
+        return static_cast<size_t>(std::bit_width(std::max(bytes, min_block) - 1)) - 4;
+    }
+};
+
+static_assert(sizeof(void *) == 8, "mapped_arena reserves address space by the terabyte");
+static_assert(sizeof(mapped_arena_header) <= mapped_arena_header::page);
+
+template <class T>
+class mapped_allocator;
+
+class mapped_arena {
+public:
+    // Opens the arena in path, creating the file when it is empty or missing. capacity only
+    // applies to a new arena. Throws std::system_error when another mapped_arena, in this process
+    // or any other, holds the file open.
+    explicit mapped_arena(const std::string &path, size_t capacity = MAPPED_ARENA_CAPACITY);
+    ~mapped_arena();
+
+    mapped_arena(const mapped_arena &)                     = delete;
+    auto operator=(const mapped_arena &) -> mapped_arena & = delete;
+
+public:
+    // True when the file already held an arena
+    [[nodiscard]] auto reopened() const -> bool { return was_reopened; }
+    [[nodiscard]] auto capacity() const -> size_t { return header->capacity; }
+    [[nodiscard]] auto file_size() const -> size_t { return header->file_size; }
+    // Bytes handed out so far, freed blocks included
+    [[nodiscard]] auto used() const -> size_t { return header->used; }
+
+    template <class T>
+    [[nodiscard]] auto get_allocator() const -> mapped_allocator<T> {
+        return mapped_allocator<T>(header);
+    }
+
+    // The arena's root object: constructed from args in a new arena, returned as stored when
+    // reopened. Throws if it was stored as a type of another size.
+    template <class T, class... Args>
+    auto root(Args &&...args) -> T &;
+
+    // Writes every dirty page back to the file and waits for it
+    auto sync() -> void;
+
+private:
+    int                  fd{-1};
+    mapped_arena_header *header{nullptr};
+    bool                 was_reopened{false};
+
+private:
+    auto create(size_t capacity) -> void;
+    auto reopen(size_t file_bytes) -> void;
+    // Maps capacity bytes of the file at exactly addr, or returns nullptr
+    auto map_at(std::uint64_t addr, size_t capacity) const -> void *;
+};
+
+// Allocator handing out blocks of a mapped_arena. It holds only the address of the arena header,
+// which lives in the mapping itself, so an allocator stored inside the arena stays valid when the
+// arena is reopened.
+template <class T>
+class mapped_allocator {
+    static_assert(alignof(T) <= mapped_arena_header::page, "over-aligned for a mapped_arena");
+
+public:
+    using value_type = T;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+    using is_always_equal                        = std::false_type;
+
+    explicit mapped_allocator(mapped_arena_header *header_) : header(header_) {}
+    template <class U>
+    mapped_allocator(const mapped_allocator<U> &other) : header(other.header) {}
+
+    auto allocate(size_t n) -> T * {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return static_cast<T *>(header->allocate(n * sizeof(T)));
+    }
+    auto deallocate(T *ptr, size_t n) noexcept -> void { header->deallocate(ptr, n * sizeof(T)); }
+
+    friend auto operator==(const mapped_allocator &, const mapped_allocator &) -> bool = default;
+
+private:
+    template <class U>
+    friend class mapped_allocator;
+
+    mapped_arena_header *header;
+};
+
+inline auto mapped_arena_header::allocate(size_t bytes) -> void * {
+    size_t block_class = size_class(bytes);
+    if (block_class >= block_sizes) throw std::bad_alloc();
+    size_t block = min_block << block_class;
+
+    if (std::uint64_t head = free_heads[block_class]; head != 0) {
+        std::byte *ptr = address(head);
+        std::memcpy(&free_heads[block_class], ptr, sizeof(std::uint64_t));
+        return ptr;
+    }
+
+    size_t align = std::min(block, page);
+    size_t start = (used + align - 1) & ~(align - 1);
+    if (start + block > capacity) throw std::bad_alloc();
+    if (start + block > file_size) {
+        size_t grown = std::min<size_t>(std::max(start + block, 2 * file_size), capacity);
+        if (::ftruncate(fd, static_cast<off_t>(grown)) != 0) {
+            throw std::system_error(errno, std::generic_category(), "mapped_arena: extend");
+        }
+        file_size = grown;
+    }
+    used = start + block;
+    return address(start);
+}
+
+inline auto mapped_arena_header::deallocate(void *ptr, size_t bytes) noexcept -> void {
+    size_t block_class = size_class(bytes);
+    size_t block       = min_block << block_class;
+#ifdef MADV_REMOVE
+    if (block > page) {
+        // Dead contents would only be written back; frees the disk blocks and cached pages too
+        (void)::madvise(static_cast<std::byte *>(ptr) + page, block - page, MADV_REMOVE);
+    }
+#endif
+    std::memcpy(ptr, &free_heads[block_class], sizeof(std::uint64_t));
+    free_heads[block_class] = offset_of(ptr);
+}
+
+inline mapped_arena::mapped_arena(const std::string &path, size_t capacity) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::system_error(errno, std::generic_category(), "mapped_arena: open");
+    try {
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+            throw std::system_error(errno, std::generic_category(), "mapped_arena: lock");
+        }
+        struct stat file_stat {};
+        if (::fstat(fd, &file_stat) != 0) {
+            throw std::system_error(errno, std::generic_category(), "mapped_arena: stat");
+        }
+        if (file_stat.st_size == 0) {
+            create(capacity);
+        } else {
+            reopen(static_cast<size_t>(file_stat.st_size));
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+inline mapped_arena::~mapped_arena() {
+    ::munmap(header, header->capacity);
+    ::close(fd);
+}
+
+inline auto mapped_arena::create(size_t capacity) -> void {
+    capacity = (capacity + mapped_arena_header::page - 1) & ~(mapped_arena_header::page - 1);
+    capacity = std::max(capacity, 2 * mapped_arena_header::page);
+    size_t initial = std::min<size_t>(capacity, 1U << 20U);
+    if (::ftruncate(fd, static_cast<off_t>(initial)) != 0) {
+        throw std::system_error(errno, std::generic_category(), "mapped_arena: extend");
+    }
+
+    // Past the preferred base, try the ranges right after it before settling for any address
+    void *addr = nullptr;
+    for (std::uint64_t step = 0; addr == nullptr && step < 16; ++step) {
+        addr = map_at(MAPPED_ARENA_BASE + step * capacity, capacity);
+    }
+    if (addr == nullptr) {
+        addr = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (addr == MAP_FAILED) {
+        int error = errno;
+        (void)::ftruncate(fd, 0);
+        throw std::system_error(error, std::generic_category(), "mapped_arena: map");
+    }
+
+    header            = ::new (addr) mapped_arena_header;
+    header->fd        = fd;
+    header->base      = reinterpret_cast<std::uintptr_t>(addr);
+    header->capacity  = capacity;
+    header->file_size = initial;
+    header->used      = sizeof(mapped_arena_header);
+}
+
+inline auto mapped_arena::reopen(size_t file_bytes) -> void {
+    mapped_arena_header stored;
+    if (::pread(fd, &stored, sizeof(stored), 0) != static_cast<ssize_t>(sizeof(stored))
+        || stored.magic != mapped_arena_header::magic_bytes) {
+        throw std::runtime_error("mapped_arena: not an arena file");
+    }
+    if (stored.version != mapped_arena_header::current_version) {
+        throw std::runtime_error("mapped_arena: unsupported version");
+    }
+    if (stored.file_size > file_bytes || stored.used > stored.file_size) {
+        throw std::runtime_error("mapped_arena: file is truncated");
+    }
+
+    void *addr = map_at(stored.base, stored.capacity);
+    if (addr == nullptr) {
+        throw std::runtime_error("mapped_arena: the address the arena was created at is in use");
+    }
+    header       = std::launder(static_cast<mapped_arena_header *>(addr));
+    header->fd   = fd;
+    was_reopened = true;
+}
+
+inline auto mapped_arena::map_at(std::uint64_t addr, size_t capacity) const -> void * {
+#ifdef MAP_FIXED_NOREPLACE
+    constexpr int fixed = MAP_FIXED_NOREPLACE;
+#else
+    constexpr int fixed = 0;
+#endif
+    void *hint = reinterpret_cast<void *>(static_cast<std::uintptr_t>(addr));
+    void *got  = ::mmap(hint, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | fixed, fd, 0);
+    if (got == MAP_FAILED) return nullptr;
+    // Kernels without MAP_FIXED_NOREPLACE take the address as a hint only
+    if (got != hint) {
+        ::munmap(got, capacity);
+        return nullptr;
+    }
+    return got;
+}
+
+template <class T, class... Args>
+inline auto mapped_arena::root(Args &&...args) -> T & {
+    if (header->root != 0) {
+        if (header->root_size != sizeof(T)) {
+            throw std::runtime_error("mapped_arena: root object stored as another type");
+        }
+        return *std::launder(reinterpret_cast<T *>(header->address(header->root)));
+    }
+
+    void *place = header->allocate(sizeof(T));
+    T    *object;
+    try {
+        object = ::new (place) T(std::forward<Args>(args)...);
+    } catch (...) {
+        header->deallocate(place, sizeof(T));
+        throw;
+    }
+    header->root      = header->offset_of(object);
+    header->root_size = sizeof(T);
+    return *object;
+}
+
+inline auto mapped_arena::sync() -> void {
+    if (::msync(header, header->file_size, MS_SYNC) != 0) {
+        throw std::system_error(errno, std::generic_category(), "mapped_arena: sync");
+    }
+}
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef _OFFSET_PTR_HPP
+#define _OFFSET_PTR_HPP
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+
+// Self-relative fancy pointer: holds the distance from its own address to the target, so a
+// structure linked with offset_ptrs reads the same wherever its memory is mapped. Copying one
+// recomputes the distance for the copy's address. Used as the pointer type of an allocator, it
+// makes standard containers placed in shared memory usable from every process mapping it.
+template <class T>
+class offset_ptr {
+public:
+    using element_type      = T;
+    using value_type        = std::remove_cv_t<T>;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = offset_ptr;
+    using reference         = std::add_lvalue_reference_t<T>;
+    using iterator_category = std::random_access_iterator_tag;
+    using iterator_concept  = std::contiguous_iterator_tag;
+
+    template <class U>
+    using rebind = offset_ptr<U>;
+
+public:
+    offset_ptr() noexcept = default;
+    offset_ptr(std::nullptr_t) noexcept {}
+    offset_ptr(T *ptr) noexcept { set(ptr); }
+    offset_ptr(const offset_ptr &other) noexcept : offset(other.offset_from(this)) {}
+    template <class U>
+        requires std::is_convertible_v<U *, T *>
+    offset_ptr(const offset_ptr<U> &other) noexcept {
+        set(static_cast<T *>(other.get()));
+    }
+    // static_cast, as from the void pointer an allocator hands out
+    template <class U>
+        requires(!std::is_convertible_v<U *, T *>) && requires(U *ptr) { static_cast<T *>(ptr); }
+    explicit offset_ptr(const offset_ptr<U> &other) noexcept {
+        set(static_cast<T *>(other.get()));
+    }
+
+    auto operator=(const offset_ptr &other) noexcept -> offset_ptr & {
+        offset = other.offset_from(this);
+        return *this;
+    }
+
+    [[nodiscard]] auto get() const noexcept -> T * {
+        std::uintptr_t addr = reinterpret_cast<std::uintptr_t>(this) + offset;
+        return reinterpret_cast<T *>(addr & live_mask());
+    }
+
+    static auto pointer_to(reference ref) noexcept -> offset_ptr
+        requires(!std::is_void_v<T>)
+    {
+        return offset_ptr(std::addressof(ref));
+    }
+
+    explicit operator bool() const noexcept { return offset != null_offset; }
+
+    auto operator*() const noexcept -> reference
+        requires(!std::is_void_v<T>)
+    {
+        return *get();
+    }
+    auto operator->() const noexcept -> T * { return get(); }
+    auto operator[](difference_type n) const noexcept -> reference
+        requires(!std::is_void_v<T>)
+    {
+        return get()[n];
+    }
+
+    auto operator++() noexcept -> offset_ptr & { return *this += 1; }
+    auto operator--() noexcept -> offset_ptr & { return *this -= 1; }
+    auto operator++(int) noexcept -> offset_ptr {
+        offset_ptr old = *this;
+        ++*this;
+        return old;
+    }
+    auto operator--(int) noexcept -> offset_ptr {
+        offset_ptr old = *this;
+        --*this;
+        return old;
+    }
+    // Moving a null pointer by anything but 0 is undefined, as for raw pointers, so the offset
+    // is moved without checking for null
+    auto operator+=(difference_type n) noexcept -> offset_ptr & {
+        offset += static_cast<std::uintptr_t>(n) * sizeof(element_bytes);
+        return *this;
+    }
+    auto operator-=(difference_type n) noexcept -> offset_ptr & {
+        offset -= static_cast<std::uintptr_t>(n) * sizeof(element_bytes);
+        return *this;
+    }
+
+    friend auto operator+(offset_ptr ptr, difference_type n) noexcept -> offset_ptr {
+        return ptr += n;
+    }
+    friend auto operator+(difference_type n, offset_ptr ptr) noexcept -> offset_ptr {
+        return ptr += n;
+    }
+    friend auto operator-(offset_ptr ptr, difference_type n) noexcept -> offset_ptr {
+        return ptr -= n;
+    }
+    friend auto operator-(const offset_ptr &lhs, const offset_ptr &rhs) noexcept
+        -> difference_type {
+        return lhs.get() - rhs.get();
+    }
+
+    template <class U>
+    auto operator==(const offset_ptr<U> &other) const noexcept -> bool {
+        return get() == other.get();
+    }
+    template <class U>
+    auto operator<=>(const offset_ptr<U> &other) const noexcept -> std::strong_ordering {
+        return std::compare_three_way{}(get(), other.get());
+    }
+    auto operator==(std::nullptr_t) const noexcept -> bool { return offset == null_offset; }
+
+private:
+    template <class U>
+    friend class offset_ptr;
+
+    // Never a real distance: the target would start inside the pointer itself
+    static constexpr std::uintptr_t null_offset = 1;
+
+    // Stride of arithmetic; void pointers are never moved
+    using element_bytes = std::conditional_t<std::is_void_v<T>, char, T>;
+
+    std::uintptr_t offset{null_offset};
+
+    // All ones unless null. Hot paths mask with it instead of branching on null, which lets the
+    // compiler fold the offset round trips of the temporaries that container code creates.
+    auto live_mask() const noexcept -> std::uintptr_t {
+        return std::uintptr_t{0} - static_cast<std::uintptr_t>(offset != null_offset);
+    }
+    // This pointer's offset as seen from an offset_ptr at to
+    auto offset_from(const void *to) const noexcept -> std::uintptr_t {
+        std::uintptr_t shift
+            = reinterpret_cast<std::uintptr_t>(this) - reinterpret_cast<std::uintptr_t>(to);
+        return offset + (shift & live_mask());
+    }
+
+    auto set(const volatile void *ptr) noexcept -> void {
+        offset = ptr == nullptr ? null_offset
+                                : reinterpret_cast<std::uintptr_t>(ptr)
+                                      - reinterpret_cast<std::uintptr_t>(this);
+    }
+};
+
+#endif
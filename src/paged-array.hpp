@@ -0,0 +1,226 @@
+#ifndef _PAGED_ARRAY_HPP
+#define _PAGED_ARRAY_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef SPARSE_PAGE_SIZE
+#    define SPARSE_PAGE_SIZE 4096
+#endif
+
+// Array over a large index range whose storage comes in fixed pages of PageSize entries.
+// A page is allocated, zero-filled, the first time an index in it is acquired and freed once
+// every index acquired in it has been released, so memory follows the occupied pages rather than
+// the range. Only the table of page pointers spans the whole range, one pointer per page.
+template <class T, class Allocator = std::allocator<T>, size_t PageSize = SPARSE_PAGE_SIZE>
+class paged_array {
+    static_assert(std::has_single_bit(PageSize), "PageSize must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>, "paged_array entries are copied as raw memory");
+    static_assert(PageSize <= (size_t{1} << 32U), "page use counts are 32-bit");
+
+public:
+    using value_type     = T;
+    using allocator_type = Allocator;
+
+    static constexpr size_t page_size = PageSize;
+
+public:
+    paged_array() : paged_array(allocator_type()) {}
+    explicit paged_array(const allocator_type &alloc_)
+        : alloc(alloc_), pages(alloc_), live(alloc_) {}
+    ~paged_array() { clear(); }
+
+    paged_array(const paged_array &other);
+    // Copies other's occupied pages into pages allocated through alloc_
+    paged_array(const paged_array &other, const allocator_type &alloc_);
+    auto operator=(const paged_array &other) -> paged_array &;
+
+    paged_array(paged_array &&other) noexcept
+        : alloc(std::move(other.alloc))
+        , pages(std::move(other.pages))
+        , live(std::move(other.live))
+        , allocated(std::exchange(other.allocated, 0)) {}
+    auto operator=(paged_array &&other) noexcept(
+        std::allocator_traits<allocator_type>::propagate_on_container_move_assignment::value
+        || std::allocator_traits<allocator_type>::is_always_equal::value
+    ) -> paged_array &;
+
+public:
+    // One past the last index the page table covers
+    [[nodiscard]] auto size() const -> size_t { return pages.size() * page_size; }
+    [[nodiscard]] auto page_count() const -> size_t { return allocated; }
+
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return alloc; }
+
+    // Entry at idx, or nullptr when its page is not allocated
+    auto find(size_t idx) const -> const value_type * {
+        size_t page = idx / page_size;
+        if (page >= pages.size() || pages[page] == nullptr) return nullptr;
+        return pages[page] + idx % page_size;
+    }
+    // idx must lie in an allocated page
+    auto operator[](size_t idx) -> value_type & {
+        return pages[idx / page_size][idx % page_size];
+    }
+
+    // Entry at idx, allocating its page if needed; counts one more user of the page
+    auto acquire(size_t idx) -> value_type &;
+    // Drops one user of the page holding idx, freeing the page when none are left
+    auto release(size_t idx) noexcept -> void;
+
+    // Extends the page table to cover indexes below count; never shrinks it
+    auto resize(size_t count) -> void;
+    // Frees every page but keeps the page table
+    auto clear() noexcept -> void;
+
+    auto swap(paged_array &other) noexcept -> void;
+
+private:
+    using alloc_traits  = std::allocator_traits<allocator_type>;
+    using pointer_alloc = typename alloc_traits::template rebind_alloc<value_type *>;
+    using count_alloc   = typename alloc_traits::template rebind_alloc<std::uint32_t>;
+
+    [[no_unique_address]] allocator_type     alloc;
+    std::vector<value_type *, pointer_alloc> pages;
+    std::vector<std::uint32_t, count_alloc>  live;
+    size_t                                   allocated{0};
+
+private:
+    auto grow_table(size_t page_total) -> void;
+};
+
+#define _paged_array_template template <class T, class Allocator, size_t PageSize>
+#define _paged_array_def paged_array<T, Allocator, PageSize>
+
+_paged_array_template
+inline _paged_array_def::paged_array(const paged_array &other)
+    : paged_array(other, alloc_traits::select_on_container_copy_construction(other.alloc)) {}
+
+_paged_array_template
+inline _paged_array_def::paged_array(const paged_array &other, const allocator_type &alloc_)
+    : alloc(alloc_)
+    , pages(other.pages.size(), nullptr, pointer_alloc(alloc))
+    , live(other.live, count_alloc(alloc)) {
+    try {
+        for (size_t page = 0; page < pages.size(); ++page) {
+            if (other.pages[page] == nullptr) continue;
+            pages[page] = alloc_traits::allocate(alloc, page_size);
+            std::copy_n(other.pages[page], page_size, pages[page]);
+            allocated++;
+        }
+    } catch (...) {
+        clear();
+        throw;
+    }
+}
+
+_paged_array_template
+inline auto _paged_array_def::operator=(const paged_array &other) -> paged_array & {
+    if (this == &other) return *this;
+    // Copied straight into the allocator this array keeps, then adopted by the move below
+    if constexpr (alloc_traits::propagate_on_container_copy_assignment::value) {
+        *this = paged_array(other, other.alloc);
+    } else {
+        *this = paged_array(other, alloc);
+    }
+    return *this;
+}
+
+_paged_array_template
+inline auto _paged_array_def::operator=(paged_array &&other) noexcept(
+    alloc_traits::propagate_on_container_move_assignment::value
+    || alloc_traits::is_always_equal::value
+) -> paged_array & {
+    if (this == &other) return *this;
+    if constexpr (!alloc_traits::propagate_on_container_move_assignment::value) {
+        // other's pages would later be freed through this array's allocator
+        if (alloc != other.alloc) {
+            *this = paged_array(other, alloc);
+            other.clear();
+            other.pages.clear();
+            other.live.clear();
+            return *this;
+        }
+    }
+    clear();
+    if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+        alloc = std::move(other.alloc);
+    }
+    pages     = std::move(other.pages);
+    live      = std::move(other.live);
+    allocated = std::exchange(other.allocated, 0);
+    other.pages.clear();
+    other.live.clear();
+    return *this;
+}
+
+_paged_array_template
+inline auto _paged_array_def::acquire(size_t idx) -> value_type & {
+    size_t page = idx / page_size;
+    if (page >= pages.size()) grow_table(std::bit_ceil(page + 1));
+    if (pages[page] == nullptr) {
+        pages[page] = alloc_traits::allocate(alloc, page_size);
+        std::fill_n(pages[page], page_size, value_type{});
+        allocated++;
+    }
+    live[page]++;
+    return pages[page][idx % page_size];
+}
+
+_paged_array_template
+inline auto _paged_array_def::release(size_t idx) noexcept -> void {
+    size_t page = idx / page_size;
+    if (--live[page] != 0) return;
+    alloc_traits::deallocate(alloc, pages[page], page_size);
+    pages[page] = nullptr;
+    allocated--;
+}
+
+_paged_array_template
+inline auto _paged_array_def::resize(size_t count) -> void {
+    grow_table(count / page_size + (count % page_size != 0 ? 1 : 0));
+}
+
+_paged_array_template
+inline auto _paged_array_def::grow_table(size_t page_total) -> void {
+    if (page_total <= pages.size()) return;
+    if (page_total > pages.max_size() / 2) {
+        throw std::length_error("paged_array: index exceeds the page table range");
+    }
+    live.resize(page_total, 0);
+    pages.resize(page_total, nullptr);
+}
+
+_paged_array_template
+inline auto _paged_array_def::clear() noexcept -> void {
+    for (size_t page = 0; page < pages.size(); ++page) {
+        if (pages[page] == nullptr) continue;
+        alloc_traits::deallocate(alloc, pages[page], page_size);
+        pages[page] = nullptr;
+        live[page]  = 0;
+    }
+    allocated = 0;
+}
+
+_paged_array_template
+inline auto _paged_array_def::swap(paged_array &other) noexcept -> void {
+    using std::swap;
+    if constexpr (alloc_traits::propagate_on_container_swap::value) {
+        swap(alloc, other.alloc);
+    }
+    swap(pages, other.pages);
+    swap(live, other.live);
+    swap(allocated, other.allocated);
+}
+
+#undef _paged_array_template
+#undef _paged_array_def
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef _SEGMENTED_VECTOR_HPP
+#define _SEGMENTED_VECTOR_HPP
+
+#include <algorithm>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifndef DENSE_SEGMENT_SIZE
+#    define DENSE_SEGMENT_SIZE 1024
+#endif
+
+// Vector-like sequence stored in fixed-size segments of SegmentSize elements. Growing appends a
+// segment instead of reallocating, so existing elements are never moved and references to them
+// stay valid across push_back; elements are contiguous within each segment. Only the table of
+// segment pointers is ever reallocated.
+template <class T, class Allocator = std::allocator<T>, size_t SegmentSize = DENSE_SEGMENT_SIZE>
+class segmented_vector {
+    static_assert(std::has_single_bit(SegmentSize), "SegmentSize must be a power of two");
+
+public:
+    using value_type      = T;
+    using allocator_type  = Allocator;
+    using size_type       = size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference       = value_type &;
+    using const_reference = const value_type &;
+
+    static constexpr size_t segment_size = SegmentSize;
+
+    template <bool Const>
+    class basic_iterator;
+
+    using iterator               = basic_iterator<false>;
+    using const_iterator         = basic_iterator<true>;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+public:
+    segmented_vector() : segmented_vector(allocator_type()) {}
+    explicit segmented_vector(const allocator_type &alloc_) : alloc(alloc_), segments(alloc_) {}
+    ~segmented_vector() { release(); }
+
+    segmented_vector(const segmented_vector &other);
+    // Keeps this vector's allocator and segments, copying the elements into them
+    auto operator=(const segmented_vector &other) -> segmented_vector &;
+
+    segmented_vector(segmented_vector &&other) noexcept
+        : alloc(std::move(other.alloc))
+        , segments(std::move(other.segments))
+        , count(std::exchange(other.count, 0)) {}
+    // Takes other's segments when the allocators allow it; otherwise, like std::vector, moves
+    // the elements one by one into segments of this vector's allocator
+    auto operator=(segmented_vector &&other) noexcept(
+        std::allocator_traits<allocator_type>::propagate_on_container_move_assignment::value
+        || std::allocator_traits<allocator_type>::is_always_equal::value
+    ) -> segmented_vector &;
+
+public:
+    [[nodiscard]] auto size() const -> size_t { return count; }
+    [[nodiscard]] auto empty() const -> bool { return count == 0; }
+    [[nodiscard]] auto capacity() const -> size_t { return segments.size() * segment_size; }
+    [[nodiscard]] auto segment_count() const -> size_t { return segments.size(); }
+
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return alloc; }
+
+    auto operator[](size_t pos) -> reference {
+        return segments[pos / segment_size][pos % segment_size];
+    }
+    auto operator[](size_t pos) const -> const_reference {
+        return segments[pos / segment_size][pos % segment_size];
+    }
+    auto back() -> reference { return (*this)[count - 1]; }
+    auto back() const -> const_reference { return (*this)[count - 1]; }
+
+    auto begin() -> iterator { return iterator(segments.data(), 0); }
+    auto end() -> iterator { return iterator(segments.data(), count); }
+    auto begin() const -> const_iterator { return const_iterator(segments.data(), 0); }
+    auto end() const -> const_iterator { return const_iterator(segments.data(), count); }
+    auto cbegin() const -> const_iterator { return begin(); }
+    auto cend() const -> const_iterator { return end(); }
+
+    auto rbegin() -> reverse_iterator { return reverse_iterator(end()); }
+    auto rend() -> reverse_iterator { return reverse_iterator(begin()); }
+    auto rbegin() const -> const_reverse_iterator { return const_reverse_iterator(end()); }
+    auto rend() const -> const_reverse_iterator { return const_reverse_iterator(begin()); }
+    auto crbegin() const -> const_reverse_iterator { return rbegin(); }
+    auto crend() const -> const_reverse_iterator { return rend(); }
+
+    // Destroys the elements but keeps every segment for reuse
+    auto clear() noexcept -> void;
+    auto reserve(size_t new_capacity) -> void;
+    // Frees the segments past the one holding the last element
+    auto shrink_to_fit() -> void;
+
+    auto push_back(const value_type &value) -> void { emplace_back(value); }
+    auto push_back(value_type &&value) -> void { emplace_back(std::move(value)); }
+    template <class... Args>
+    auto emplace_back(Args &&...args) -> reference;
+    auto pop_back() -> void;
+
+    auto swap(segmented_vector &other) noexcept -> void;
+
+private:
+    using alloc_traits  = std::allocator_traits<allocator_type>;
+    using pointer_alloc = typename alloc_traits::template rebind_alloc<value_type *>;
+
+    [[no_unique_address]] allocator_type     alloc;
+    std::vector<value_type *, pointer_alloc> segments;
+    size_t                                   count{0};
+
+private:
+    auto add_segment() -> void;
+    auto release() noexcept -> void;
+};
+
+// Random access over segment pointers; dereferencing finds the segment by shift and mask
+template <class T, class Allocator, size_t SegmentSize>
+template <bool Const>
+class segmented_vector<T, Allocator, SegmentSize>::basic_iterator {
+public:
+    using iterator_concept  = std::random_access_iterator_tag;
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type        = T;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = std::conditional_t<Const, const T *, T *>;
+    using reference         = std::conditional_t<Const, const T &, T &>;
+
+    basic_iterator() = default;
+    // iterator converts to const_iterator
+    template <bool OtherConst>
+        requires(Const && !OtherConst)
+    basic_iterator(const basic_iterator<OtherConst> &other)
+        : segments(other.segments), pos(other.pos) {}
+
+    auto operator*() const -> reference { return segments[pos / SegmentSize][pos % SegmentSize]; }
+    auto operator->() const -> pointer { return &**this; }
+    auto operator[](difference_type offset) const -> reference { return *(*this + offset); }
+
+    auto operator++() -> basic_iterator & {
+        ++pos;
+        return *this;
+    }
+    auto operator++(int) -> basic_iterator {
+        auto copy = *this;
+        ++pos;
+        return copy;
+    }
+    auto operator--() -> basic_iterator & {
+        --pos;
+        return *this;
+    }
+    auto operator--(int) -> basic_iterator {
+        auto copy = *this;
+        --pos;
+        return copy;
+    }
+
+    auto operator+=(difference_type offset) -> basic_iterator & {
+        pos = static_cast<size_t>(static_cast<difference_type>(pos) + offset);
+        return *this;
+    }
+    auto operator-=(difference_type offset) -> basic_iterator & { return *this += -offset; }
+
+    friend auto operator+(basic_iterator it, difference_type offset) -> basic_iterator {
+        return it += offset;
+    }
+    friend auto operator+(difference_type offset, basic_iterator it) -> basic_iterator {
+        return it += offset;
+    }
+    friend auto operator-(basic_iterator it, difference_type offset) -> basic_iterator {
+        return it -= offset;
+    }
+    friend auto operator-(const basic_iterator &lhs, const basic_iterator &rhs)
+        -> difference_type {
+        return static_cast<difference_type>(lhs.pos) - static_cast<difference_type>(rhs.pos);
+    }
+
+    friend auto operator==(const basic_iterator &lhs, const basic_iterator &rhs) -> bool {
+        return lhs.pos == rhs.pos;
+    }
+    friend auto operator<=>(const basic_iterator &lhs, const basic_iterator &rhs)
+        -> std::strong_ordering {
+        return lhs.pos <=> rhs.pos;
+    }
+
+private:
+    friend class segmented_vector;
+    template <bool>
+    friend class basic_iterator;
+
+    using segment_ptr = T *const *;
+
+    basic_iterator(segment_ptr segments_, size_t pos_) : segments(segments_), pos(pos_) {}
+
+    segment_ptr segments{nullptr};
+    size_t      pos{0};
+};
+
+#define _segmented_vector_template template <class T, class Allocator, size_t SegmentSize>
+#define _segmented_vector_def segmented_vector<T, Allocator, SegmentSize>
+
+_segmented_vector_template
+inline _segmented_vector_def::segmented_vector(const segmented_vector &other)
+    : alloc(alloc_traits::select_on_container_copy_construction(other.alloc))
+    , segments(pointer_alloc(alloc)) {
+    try {
+        reserve(other.count);
+        for (const auto &value : other) {
+            emplace_back(value);
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::operator=(const segmented_vector &other) -> segmented_vector & {
+    if (this == &other) return *this;
+    clear();
+    reserve(other.count);
+    for (const auto &value : other) {
+        emplace_back(value);
+    }
+    return *this;
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::operator=(segmented_vector &&other) noexcept(
+    alloc_traits::propagate_on_container_move_assignment::value
+    || alloc_traits::is_always_equal::value
+) -> segmented_vector & {
+    if (this == &other) return *this;
+    if constexpr (!alloc_traits::propagate_on_container_move_assignment::value) {
+        // other's segments would later be freed through this vector's allocator
+        if (alloc != other.alloc) {
+            clear();
+            reserve(other.count);
+            for (auto &value : other) {
+                emplace_back(std::move(value));
+            }
+            other.clear();
+            return *this;
+        }
+    }
+    release();
+    if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+        alloc = std::move(other.alloc);
+    }
+    segments = std::move(other.segments);
+    count    = std::exchange(other.count, 0);
+    other.segments.clear();
+    return *this;
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::clear() noexcept -> void {
+    for (size_t pos = 0; pos < count; ++pos) {
+        alloc_traits::destroy(alloc, &(*this)[pos]);
+    }
+    count = 0;
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::reserve(size_t new_capacity) -> void {
+    segments.reserve((new_capacity + segment_size - 1) / segment_size);
+    while (capacity() < new_capacity) {
+        add_segment();
+    }
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::shrink_to_fit() -> void {
+    size_t keep = (count + segment_size - 1) / segment_size;
+    while (segments.size() > keep) {
+        alloc_traits::deallocate(alloc, segments.back(), segment_size);
+        segments.pop_back();
+    }
+    segments.shrink_to_fit();
+}
+
+_segmented_vector_template
+template <class... Args>
+inline auto _segmented_vector_def::emplace_back(Args &&...args) -> reference {
+    if (count == capacity()) add_segment();
+    value_type *slot = segments[count / segment_size] + count % segment_size;
+    alloc_traits::construct(alloc, slot, std::forward<Args>(args)...);
+    ++count;
+    return *slot;
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::pop_back() -> void {
+    --count;
+    alloc_traits::destroy(alloc, &(*this)[count]);
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::swap(segmented_vector &other) noexcept -> void {
+    using std::swap;
+    if constexpr (alloc_traits::propagate_on_container_swap::value) {
+        swap(alloc, other.alloc);
+    }
+    swap(segments, other.segments);
+    swap(count, other.count);
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::add_segment() -> void {
+    // Grow the pointer table first so a failed allocation below cannot leak the segment
+    if (segments.size() == segments.capacity()) {
+        segments.reserve(std::max<size_t>(segments.size() * 2, 8));
+    }
+    segments.push_back(alloc_traits::allocate(alloc, segment_size));
+}
+
+_segmented_vector_template
+inline auto _segmented_vector_def::release() noexcept -> void {
+    clear();
+    for (value_type *segment : segments) {
+        alloc_traits::deallocate(alloc, segment, segment_size);
+    }
+    segments.clear();
+}
+
+#undef _segmented_vector_template
+#undef _segmented_vector_def
+
+// Dense storage policy backed by segmented_vector
+template <size_t SegmentSize = DENSE_SEGMENT_SIZE>
+struct segmented_storage {
+    template <class U, class Alloc>
+    using type = segmented_vector<U, Alloc, SegmentSize>;
+};
+
+#endif
@@ -0,0 +1,363 @@
+#ifndef _SHARED_SPARSE_SET_HPP
+#define _SHARED_SPARSE_SET_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "./mapped-arena.hpp"
+#include "./offset-ptr.hpp"
+#include "./sparse-set.hpp"
+
+// Allocator handing out blocks of a shared segment's heap (a mapped_arena_header at the start of
+// the segment) as offset_ptrs. It reaches the heap through an offset_ptr as well, so a container
+// using it works from every process that maps the segment, at whatever address.
+template <class T>
+class shared_allocator {
+public:
+    using value_type         = T;
+    using pointer            = offset_ptr<T>;
+    using const_pointer      = offset_ptr<const T>;
+    using void_pointer       = offset_ptr<void>;
+    using const_void_pointer = offset_ptr<const void>;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+    using is_always_equal                        = std::false_type;
+
+    explicit shared_allocator(mapped_arena_header *heap_) : heap(heap_) {}
+    template <class U>
+    shared_allocator(const shared_allocator<U> &other) : heap(other.heap) {}
+
+    auto allocate(size_t n) -> pointer {
+        if (n > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+        return pointer(static_cast<T *>(heap->allocate(n * sizeof(T))));
+    }
+    auto deallocate(pointer ptr, size_t n) noexcept -> void {
+        heap->deallocate(ptr.get(), n * sizeof(T));
+    }
+
+    friend auto operator==(const shared_allocator &, const shared_allocator &) -> bool = default;
+
+private:
+    template <class U>
+    friend class shared_allocator;
+
+    offset_ptr<mapped_arena_header> heap;
+};
+
+// sparse_set in a POSIX shared memory segment, so the processes on one host share one copy of
+// it. The set object and all of its arrays live in the segment, linked by offset_ptrs instead of
+// raw pointers: each process maps the segment wherever it likes and probes the set in place with
+// sparse_set's own lookup code, copying nothing.
+// One process creates the segment and updates it; readers open it read-only and query it under a
+// process-shared reader-writer lock, which every update takes exclusively. A reader maps the set
+// without write permission, so a stray write faults instead of corrupting every process's view.
+// All processes must run the same build: the hasher and the elements are shared as raw bytes, so
+// neither may hold pointers or other process-local state. A reader that dies holding the lock
+// blocks the writer for good.
+template <
+    typename T,
+    typename Hash       = std::hash<T>,
+    typename KeyEqual   = std::equal_to<T>,
+    typename SlotPolicy = fibonacci_slot_policy,
+    bool StoreHash      = false>
+class shared_sparse_set {
+public:
+    using set_type   = sparse_set<T, Hash, KeyEqual, shared_allocator<T>, SlotPolicy, StoreHash>;
+    using value_type = T;
+
+    class read_guard;
+
+public:
+    // Creates the segment name, replacing any existing one, for this process to update; capacity
+    // bounds its growth and is the address space every process mapping it reserves
+    [[nodiscard]] static auto create(
+        const std::string &name, size_t capacity = MAPPED_ARENA_CAPACITY, const Hash &hash = Hash()
+    ) -> shared_sparse_set;
+    // Opens an existing segment; a writable one lets this process take over updates
+    [[nodiscard]] static auto open(const std::string &name, bool writable = false)
+        -> shared_sparse_set;
+    // Unlinks name; processes that already have it open keep using the segment
+    static auto remove(const std::string &name) -> bool { return ::shm_unlink(name.c_str()) == 0; }
+
+    shared_sparse_set(shared_sparse_set &&other) noexcept;
+    auto operator=(shared_sparse_set &&) -> shared_sparse_set & = delete;
+
+    shared_sparse_set(const shared_sparse_set &)                     = delete;
+    auto operator=(const shared_sparse_set &) -> shared_sparse_set & = delete;
+
+    // Unmaps the segment, which keeps the set for the other processes
+    ~shared_sparse_set();
+
+public:
+    [[nodiscard]] auto writable() const -> bool { return write_access; }
+
+    // Reader side. The guard holds the shared lock and updates wait for it, so keep it short.
+    [[nodiscard]] auto read() const -> read_guard;
+    [[nodiscard]] auto contains(const value_type &value) const -> bool {
+        return read()->contains(value);
+    }
+    [[nodiscard]] auto size() const -> size_t { return read()->size(); }
+
+    // Writer side, each under the exclusive lock; throws std::logic_error when opened read-only
+    auto insert(const value_type &value) -> bool;
+    auto erase(const value_type &value) -> size_t;
+    auto clear() -> void;
+    // Runs fn(set_type &), for anything the shortcuts above do not cover
+    template <class F>
+    auto update(F &&fn) -> void;
+
+private:
+    struct segment {
+        // Element and set sizes, so open() can refuse a segment holding another set type
+        static constexpr std::uint64_t layout_tag = (std::uint64_t{sizeof(T)} << 32U)
+                                                    | (std::uint64_t{sizeof(set_type)} << 1U)
+                                                    | std::uint64_t{StoreHash};
+
+        std::uint64_t    layout{layout_tag};
+        pthread_rwlock_t lock;
+        set_type         set;
+
+        segment(const Hash &hash, const shared_allocator<T> &alloc)
+            : lock(), set(0, hash, KeyEqual(), alloc) {}
+    };
+
+    int                  fd{-1};
+    mapped_arena_header *heap{nullptr};
+    size_t               mapping_size{0};
+    segment             *shared{nullptr};
+    // Readers lock through a writable mapping of just the page holding the lock
+    std::byte        *lock_page{nullptr};
+    size_t            lock_page_size{0};
+    pthread_rwlock_t *lock{nullptr};
+    bool              write_access{false};
+
+private:
+    shared_sparse_set() = default;
+
+    auto map(size_t size, int prot) -> void;
+};
+
+#define _shared_sparse_set_template \
+    template <typename T, typename Hash, typename KeyEqual, typename SlotPolicy, bool StoreHash>
+#define _shared_sparse_set_def shared_sparse_set<T, Hash, KeyEqual, SlotPolicy, StoreHash>
+
+// Shared lock on the segment, released when the guard is destroyed
+_shared_sparse_set_template
+class _shared_sparse_set_def::read_guard {
+public:
+    read_guard(const read_guard &)                     = delete;
+    auto operator=(const read_guard &) -> read_guard & = delete;
+    read_guard(read_guard &&other) noexcept
+        : lock(std::exchange(other.lock, nullptr)), set(other.set) {}
+    auto operator=(read_guard &&) -> read_guard & = delete;
+    ~read_guard() {
+        if (lock != nullptr) ::pthread_rwlock_unlock(lock);
+    }
+
+    auto operator*() const -> const set_type & { return *set; }
+    auto operator->() const -> const set_type * { return set; }
+
+private:
+    friend class shared_sparse_set;
+
+    read_guard(pthread_rwlock_t *lock_, const set_type *set_) : lock(lock_), set(set_) {}
+
+    pthread_rwlock_t *lock;
+    const set_type   *set;
+};
+
+_shared_sparse_set_template
+inline auto _shared_sparse_set_def::create(
+    const std::string &name, size_t capacity, const Hash &hash
+) -> shared_sparse_set {
+    capacity = (capacity + mapped_arena_header::page - 1) & ~(mapped_arena_header::page - 1);
+    capacity = std::max(capacity, 2 * mapped_arena_header::page);
+    size_t initial = std::min<size_t>(capacity, 1U << 20U);
+
+    (void)::shm_unlink(name.c_str());
+    shared_sparse_set result;
+    result.fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (result.fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "shared_sparse_set: shm_open");
+    }
+    try {
+        if (::ftruncate(result.fd, static_cast<off_t>(initial)) != 0) {
+            throw std::system_error(errno, std::generic_category(), "shared_sparse_set: extend");
+        }
+        result.map(capacity, PROT_READ | PROT_WRITE);
+
+        mapped_arena_header *heap = ::new (result.heap) mapped_arena_header;
+        heap->fd                  = result.fd;
+        heap->capacity            = capacity;
+        heap->file_size           = initial;
+        heap->used                = sizeof(mapped_arena_header);
+
+        void *place   = heap->allocate(sizeof(segment));
+        result.shared = ::new (place) segment(hash, shared_allocator<T>(heap));
+        result.lock   = &result.shared->lock;
+
+        pthread_rwlockattr_t attr;
+        ::pthread_rwlockattr_init(&attr);
+        ::pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef __GLIBC__
+        // Readers far outnumber the writer; without this a steady stream of them starves it
+        ::pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+        int error = ::pthread_rwlock_init(result.lock, &attr);
+        ::pthread_rwlockattr_destroy(&attr);
+        if (error != 0) {
+            throw std::system_error(error, std::generic_category(), "shared_sparse_set: lock");
+        }
+
+        // Published last: open() refuses the segment until the set is in place
+        heap->root_size = sizeof(segment);
+        std::atomic_ref<std::uint64_t>(heap->root)
+            .store(heap->offset_of(result.shared), std::memory_order_release);
+    } catch (...) {
+        (void)::shm_unlink(name.c_str());
+        throw;
+    }
+    result.write_access = true;
+    return result;
+}
+
+_shared_sparse_set_template
+inline auto _shared_sparse_set_def::open(const std::string &name, bool writable)
+    -> shared_sparse_set {
+    shared_sparse_set result;
+    result.fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (result.fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "shared_sparse_set: shm_open");
+    }
+
+    mapped_arena_header stored;
+    if (::pread(result.fd, &stored, sizeof(stored), 0) != static_cast<ssize_t>(sizeof(stored))
+        || stored.magic != mapped_arena_header::magic_bytes
+        || stored.version != mapped_arena_header::current_version) {
+        throw std::runtime_error("shared_sparse_set: not a shared set segment");
+    }
+    if (stored.root == 0) throw std::runtime_error("shared_sparse_set: segment is being created");
+    if (stored.root_size != sizeof(segment)) {
+        throw std::runtime_error("shared_sparse_set: segment holds another set type");
+    }
+
+    result.map(stored.capacity, writable ? PROT_READ | PROT_WRITE : PROT_READ);
+    result.shared = std::launder(reinterpret_cast<segment *>(result.heap->address(stored.root)));
+    if (result.shared->layout != segment::layout_tag) {
+        throw std::runtime_error("shared_sparse_set: segment holds another set type");
+    }
+    result.write_access = writable;
+    if (writable) {
+        result.lock = &result.shared->lock;
+        return result;
+    }
+
+    auto   page_size   = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t lock_offset = result.heap->offset_of(&result.shared->lock);
+    size_t page_offset = lock_offset & ~(page_size - 1);
+    void  *page        = ::mmap(
+        nullptr, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, result.fd,
+        static_cast<off_t>(page_offset)
+    );
+    if (page == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "shared_sparse_set: map");
+    }
+    result.lock_page      = static_cast<std::byte *>(page);
+    result.lock_page_size = page_size;
+    result.lock
+        = reinterpret_cast<pthread_rwlock_t *>(result.lock_page + (lock_offset - page_offset));
+    return result;
+}
+
+_shared_sparse_set_template
+inline _shared_sparse_set_def::shared_sparse_set(shared_sparse_set &&other) noexcept
+    : fd(std::exchange(other.fd, -1))
+    , heap(std::exchange(other.heap, nullptr))
+    , mapping_size(std::exchange(other.mapping_size, 0))
+    , shared(std::exchange(other.shared, nullptr))
+    , lock_page(std::exchange(other.lock_page, nullptr))
+    , lock_page_size(std::exchange(other.lock_page_size, 0))
+    , lock(std::exchange(other.lock, nullptr))
+    , write_access(other.write_access) {}
+
+_shared_sparse_set_template
+inline _shared_sparse_set_def::~shared_sparse_set() {
+    if (lock_page != nullptr) ::munmap(lock_page, lock_page_size);
+    if (heap != nullptr) ::munmap(heap, mapping_size);
+    if (fd >= 0) ::close(fd);
+}
+
+_shared_sparse_set_template
+inline auto _shared_sparse_set_def::read() const -> read_guard {
+    if (int error = ::pthread_rwlock_rdlock(lock); error != 0) {
+        throw std::system_error(error, std::generic_category(), "shared_sparse_set: lock");
+    }
+    return read_guard(lock, &shared->set);
+}
+
+_shared_sparse_set_template
+inline auto _shared_sparse_set_def::insert(const value_type &value) -> bool {
+    bool inserted = false;
+    update([&](set_type &set) { inserted = set.insert(value).second; });
+    return inserted;
+}
+
+_shared_sparse_set_template
+inline auto _shared_sparse_set_def::erase(const value_type &value) -> size_t {
+    size_t erased = 0;
+    update([&](set_type &set) { erased = set.erase(value); });
+    return erased;
+}
+
+_shared_sparse_set_template
+inline auto _shared_sparse_set_def::clear() -> void {
+    update([](set_type &set) { set.clear(); });
+}
+
+_shared_sparse_set_template
+template <class F>
+inline auto _shared_sparse_set_def::update(F &&fn) -> void {
+    if (!write_access) throw std::logic_error("shared_sparse_set: opened read-only");
+    if (int error = ::pthread_rwlock_wrlock(lock); error != 0) {
+        throw std::system_error(error, std::generic_category(), "shared_sparse_set: lock");
+    }
+    // Growing the segment goes through the descriptor of whichever writer holds the lock
+    heap->fd = fd;
+    try {
+        std::forward<F>(fn)(shared->set);
+    } catch (...) {
+        ::pthread_rwlock_unlock(lock);
+        throw;
+    }
+    ::pthread_rwlock_unlock(lock);
+}
+
+_shared_sparse_set_template
+inline auto _shared_sparse_set_def::map(size_t size, int prot) -> void {
+    void *addr = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "shared_sparse_set: map");
+    }
+    heap         = static_cast<mapped_arena_header *>(addr);
+    mapping_size = size;
+}
+
+#undef _shared_sparse_set_template
+#undef _shared_sparse_set_def
+
+#endif
@@ -0,0 +1,270 @@
+#ifndef _SMALL_VECTOR_HPP
+#define _SMALL_VECTOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Vector with room for InlineCount elements inside the object; it only allocates once it grows
+// past that. Moving an inline vector moves its elements, so unlike std::vector a move does not
+// keep iterators valid.
+template <class T, size_t InlineCount, class Allocator = std::allocator<T>>
+class small_vector {
+    static_assert(InlineCount > 0, "InlineCount must be positive");
+    static_assert(
+        std::is_nothrow_move_constructible_v<T>,
+        "small_vector relocates elements between its buffer and the heap by move"
+    );
+
+public:
+    using value_type             = T;
+    using allocator_type         = Allocator;
+    using size_type              = size_t;
+    using difference_type        = std::ptrdiff_t;
+    using reference              = value_type &;
+    using const_reference        = const value_type &;
+    using iterator               = value_type *;
+    using const_iterator         = const value_type *;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    static constexpr size_t inline_capacity = InlineCount;
+
+public:
+    small_vector() : small_vector(allocator_type()) {}
+    explicit small_vector(const allocator_type &alloc_) : alloc(alloc_) {}
+    ~small_vector() { release(); }
+
+    small_vector(const small_vector &other);
+    auto operator=(const small_vector &other) -> small_vector &;
+
+    small_vector(small_vector &&other) noexcept : alloc(std::move(other.alloc)) {
+        take(std::move(other));
+    }
+    auto operator=(small_vector &&other) noexcept(
+        std::allocator_traits<allocator_type>::propagate_on_container_move_assignment::value
+        || std::allocator_traits<allocator_type>::is_always_equal::value
+    ) -> small_vector &;
+
+public:
+    [[nodiscard]] auto size() const -> size_t { return count; }
+    [[nodiscard]] auto empty() const -> bool { return count == 0; }
+    [[nodiscard]] auto capacity() const -> size_t { return cap; }
+    [[nodiscard]] auto is_inline() const -> bool { return elems == inline_data(); }
+
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return alloc; }
+
+    auto data() -> value_type * { return elems; }
+    auto data() const -> const value_type * { return elems; }
+
+    auto operator[](size_t pos) -> reference { return elems[pos]; }
+    auto operator[](size_t pos) const -> const_reference { return elems[pos]; }
+    auto back() -> reference { return elems[count - 1]; }
+    auto back() const -> const_reference { return elems[count - 1]; }
+
+    auto begin() -> iterator { return elems; }
+    auto end() -> iterator { return elems + count; }
+    auto begin() const -> const_iterator { return elems; }
+    auto end() const -> const_iterator { return elems + count; }
+    auto cbegin() const -> const_iterator { return begin(); }
+    auto cend() const -> const_iterator { return end(); }
+
+    auto rbegin() -> reverse_iterator { return reverse_iterator(end()); }
+    auto rend() -> reverse_iterator { return reverse_iterator(begin()); }
+    auto rbegin() const -> const_reverse_iterator { return const_reverse_iterator(end()); }
+    auto rend() const -> const_reverse_iterator { return const_reverse_iterator(begin()); }
+    auto crbegin() const -> const_reverse_iterator { return rbegin(); }
+    auto crend() const -> const_reverse_iterator { return rend(); }
+
+    auto clear() noexcept -> void;
+    auto reserve(size_t new_capacity) -> void;
+
+    auto push_back(const value_type &value) -> void { emplace_back(value); }
+    auto push_back(value_type &&value) -> void { emplace_back(std::move(value)); }
+    template <class... Args>
+    auto emplace_back(Args &&...args) -> reference;
+    auto pop_back() -> void;
+
+    // Built on move assignment, so it moves elements one by one between unequal allocators
+    auto swap(small_vector &other) noexcept(
+        std::allocator_traits<allocator_type>::propagate_on_container_move_assignment::value
+        || std::allocator_traits<allocator_type>::is_always_equal::value
+    ) -> void;
+
+private:
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+    alignas(value_type) std::byte buffer[sizeof(value_type) * InlineCount];
+    value_type                           *elems{inline_data()};
+    size_t                                count{0};
+    size_t                                cap{InlineCount};
+    [[no_unique_address]] allocator_type alloc;
+
+private:
+    auto inline_data() -> value_type * { return reinterpret_cast<value_type *>(buffer); }
+    auto inline_data() const -> const value_type * {
+        return reinterpret_cast<const value_type *>(buffer);
+    }
+
+    // Moves every element into a fresh heap block of new_capacity elements
+    auto relocate(value_type *fresh, size_t new_capacity) noexcept -> void;
+    // Steals other's heap block, or moves its inline elements over; other is left empty
+    auto take(small_vector &&other) noexcept -> void;
+    auto release() noexcept -> void;
+};
+
+#define _small_vector_template template <class T, size_t InlineCount, class Allocator>
+#define _small_vector_def small_vector<T, InlineCount, Allocator>
+
+_small_vector_template
+inline _small_vector_def::small_vector(const small_vector &other)
+    : alloc(alloc_traits::select_on_container_copy_construction(other.alloc)) {
+    try {
+        reserve(other.count);
+        for (const auto &value : other) {
+            emplace_back(value);
+        }
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+_small_vector_template
+inline auto _small_vector_def::operator=(const small_vector &other) -> small_vector & {
+    if (this == &other) return *this;
+    clear();
+    reserve(other.count);
+    for (const auto &value : other) {
+        emplace_back(value);
+    }
+    return *this;
+}
+
+_small_vector_template
+inline auto _small_vector_def::operator=(small_vector &&other) noexcept(
+    alloc_traits::propagate_on_container_move_assignment::value
+    || alloc_traits::is_always_equal::value
+) -> small_vector & {
+    if (this == &other) return *this;
+    if constexpr (!alloc_traits::propagate_on_container_move_assignment::value) {
+        // other's heap block would later be freed through this vector's allocator
+        if (alloc != other.alloc) {
+            clear();
+            reserve(other.count);
+            for (auto &value : other) {
+                emplace_back(std::move(value));
+            }
+            other.clear();
+            return *this;
+        }
+    }
+    release();
+    if constexpr (alloc_traits::propagate_on_container_move_assignment::value) {
+        alloc = std::move(other.alloc);
+    }
+    take(std::move(other));
+    return *this;
+}
+
+_small_vector_template
+inline auto _small_vector_def::clear() noexcept -> void {
+    for (size_t pos = 0; pos < count; ++pos) {
+        alloc_traits::destroy(alloc, elems + pos);
+    }
+    count = 0;
+}
+
+_small_vector_template
+inline auto _small_vector_def::reserve(size_t new_capacity) -> void {
+    if (new_capacity <= cap) return;
+    relocate(alloc_traits::allocate(alloc, new_capacity), new_capacity);
+}
+
+_small_vector_template
+template <class... Args>
+inline auto _small_vector_def::emplace_back(Args &&...args) -> reference {
+    if (count < cap) {
+        alloc_traits::construct(alloc, elems + count, std::forward<Args>(args)...);
+        return elems[count++];
+    }
+
+    // Build the new element before moving the old ones, since args may refer to one of them
+    size_t      new_capacity = cap * 2;
+    value_type *fresh        = alloc_traits::allocate(alloc, new_capacity);
+    try {
+        alloc_traits::construct(alloc, fresh + count, std::forward<Args>(args)...);
+    } catch (...) {
+        alloc_traits::deallocate(alloc, fresh, new_capacity);
+        throw;
+    }
+    relocate(fresh, new_capacity);
+    return elems[count++];
+}
+
+_small_vector_template
+inline auto _small_vector_def::pop_back() -> void {
+    --count;
+    alloc_traits::destroy(alloc, elems + count);
+}
+
+_small_vector_template
+inline auto _small_vector_def::swap(small_vector &other) noexcept(
+    alloc_traits::propagate_on_container_move_assignment::value
+    || alloc_traits::is_always_equal::value
+) -> void {
+    small_vector tmp(std::move(other));
+    other = std::move(*this);
+    *this = std::move(tmp);
+}
+
+_small_vector_template
+inline auto _small_vector_def::relocate(value_type *fresh, size_t new_capacity) noexcept -> void {
+    for (size_t pos = 0; pos < count; ++pos) {
+        alloc_traits::construct(alloc, fresh + pos, std::move(elems[pos]));
+        alloc_traits::destroy(alloc, elems + pos);
+    }
+    if (!is_inline()) alloc_traits::deallocate(alloc, elems, cap);
+    elems = fresh;
+    cap   = new_capacity;
+}
+
+_small_vector_template
+inline auto _small_vector_def::take(small_vector &&other) noexcept -> void {
+    if (!other.is_inline()) {
+        elems = std::exchange(other.elems, other.inline_data());
+        count = std::exchange(other.count, 0);
+        cap   = std::exchange(other.cap, InlineCount);
+        return;
+    }
+    elems = inline_data();
+    cap   = InlineCount;
+    count = 0;
+    for (auto &value : other) {
+        alloc_traits::construct(alloc, elems + count++, std::move(value));
+    }
+    other.clear();
+}
+
+_small_vector_template
+inline auto _small_vector_def::release() noexcept -> void {
+    clear();
+    if (!is_inline()) alloc_traits::deallocate(alloc, elems, cap);
+    elems = inline_data();
+    cap   = InlineCount;
+}
+
+#undef _small_vector_template
+#undef _small_vector_def
+
+// Dense storage policy keeping up to InlineCount elements inside the set object
+template <size_t InlineCount>
+struct inline_storage {
+    template <class U, class Alloc>
+    using type = small_vector<U, InlineCount, Alloc>;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef _SNAPSHOT_SPARSE_SET_HPP
+#define _SNAPSHOT_SPARSE_SET_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "./sparse-set.hpp"
+
+#ifndef SNAPSHOT_MAX_READERS
+#    define SNAPSHOT_MAX_READERS 64
+#endif
+
+// Read-mostly wrapper around sparse_set. Readers probe an immutable published version without
+// taking locks; the writer stages updates on a private set and publish() swaps a copy of it in.
+// A replaced version is retired at the current epoch and freed once every reader that could
+// still hold it has unpinned, which is the usual epoch-based reclamation scheme.
+template <
+    typename T,
+    typename Hash      = std::hash<T>,
+    typename KeyEqual  = std::equal_to<T>,
+    typename Allocator = std::allocator<T>>
+class snapshot_sparse_set {
+public:
+    using set_type   = sparse_set<T, Hash, KeyEqual, Allocator>;
+    using value_type = T;
+
+    class read_guard;
+    class reader;
+
+    snapshot_sparse_set() : snapshot_sparse_set(set_type()) {}
+    explicit snapshot_sparse_set(set_type initial);
+
+    snapshot_sparse_set(const snapshot_sparse_set &)                     = delete;
+    auto operator=(const snapshot_sparse_set &) -> snapshot_sparse_set & = delete;
+
+    // Every reader must be destroyed first
+    ~snapshot_sparse_set();
+
+    // Claims one of SNAPSHOT_MAX_READERS slots; each reading thread keeps a reader of its own
+    [[nodiscard]] auto make_reader() -> reader;
+
+    // Writer side. Changes are staged and stay invisible to readers until publish().
+    auto insert(const value_type &value) -> bool;
+    auto insert(value_type &&value) -> bool;
+    auto erase(const value_type &value) -> size_t;
+    auto clear() -> void;
+    // Runs fn(set_type &) on the staged set, for anything the shortcuts above do not cover
+    template <class F>
+    auto update(F &&fn) -> void;
+
+    auto publish() -> void;
+
+    // Retired versions that some reader may still be looking at
+    [[nodiscard]] auto pending_reclaim() const -> size_t;
+    auto               reclaim() -> void;
+
+private:
+    struct version {
+        set_type      set;
+        std::uint64_t retired_at{0};
+    };
+
+    // Epoch the reader pinned when it loaded the current version, 0 while it holds none
+    struct alignas(64) reader_slot {
+        std::atomic<std::uint64_t> epoch{0};
+        std::atomic<bool>          claimed{false};
+    };
+
+    std::atomic<version *>                        current;
+    std::atomic<std::uint64_t>                    global_epoch{1};
+    std::array<reader_slot, SNAPSHOT_MAX_READERS> slots;
+
+    mutable std::mutex                    writer_mutex;
+    set_type                              staging;
+    std::vector<std::unique_ptr<version>> retired;
+    // A reclaimed version kept so the next publish can copy-assign into its buffers
+    std::unique_ptr<version> spare;
+
+private:
+    auto reclaim_locked() -> void;
+};
+
+#define _snapshot_sparse_set_template \
+    template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+#define _snapshot_sparse_set_def snapshot_sparse_set<T, Hash, KeyEqual, Allocator>
+
+// Keeps one published version alive. A guard pinned while another from the same reader is live
+// leaves the slot to the outer one and must be destroyed before it.
+_snapshot_sparse_set_template
+class _snapshot_sparse_set_def::read_guard {
+public:
+    read_guard(const read_guard &)                     = delete;
+    auto operator=(const read_guard &) -> read_guard & = delete;
+    read_guard(read_guard &&other) noexcept
+        : slot(std::exchange(other.slot, nullptr)), pinned(other.pinned) {}
+    auto operator=(read_guard &&) -> read_guard & = delete;
+    ~read_guard() {
+        if (slot != nullptr) slot->epoch.store(0, std::memory_order_release);
+    }
+
+    auto operator*() const -> const set_type & { return pinned->set; }
+    auto operator->() const -> const set_type * { return &pinned->set; }
+
+private:
+    friend class snapshot_sparse_set;
+
+    read_guard(reader_slot *slot_, const version *pinned_) : slot(slot_), pinned(pinned_) {}
+
+    reader_slot   *slot;
+    const version *pinned;
+};
+
+_snapshot_sparse_set_template
+class _snapshot_sparse_set_def::reader {
+public:
+    reader(const reader &)                     = delete;
+    auto operator=(const reader &) -> reader & = delete;
+    reader(reader &&other) noexcept
+        : owner(other.owner), slot(std::exchange(other.slot, nullptr)) {}
+    auto operator=(reader &&) -> reader & = delete;
+    ~reader() {
+        if (slot != nullptr) slot->claimed.store(false, std::memory_order_release);
+    }
+
+    // Wait-free: two stores and two loads, no retry loop
+    [[nodiscard]] auto pin() const -> read_guard {
+        // Already pinned by this reader: that epoch also covers every version published since,
+        // so the nested guard must not reset it when it ends
+        if (slot->epoch.load(std::memory_order_relaxed) != 0) {
+            return read_guard(nullptr, owner->current.load());
+        }
+        // The slot store must be visible before current is read; a writer that retires the
+        // version read here scans the slots afterwards and sees an epoch no later than its own
+        slot->epoch.store(owner->global_epoch.load(std::memory_order_acquire));
+        return read_guard(slot, owner->current.load());
+    }
+
+    // Safe to call while holding a guard from pin()
+    [[nodiscard]] auto contains(const value_type &value) const -> bool {
+        return pin()->contains(value);
+    }
+    [[nodiscard]] auto size() const -> size_t { return pin()->size(); }
+
+private:
+    friend class snapshot_sparse_set;
+
+    reader(snapshot_sparse_set *owner_, reader_slot *slot_) : owner(owner_), slot(slot_) {}
+
+    snapshot_sparse_set *owner;
+    reader_slot         *slot;
+};
+
+_snapshot_sparse_set_template
+inline _snapshot_sparse_set_def::snapshot_sparse_set(set_type initial)
+    : current(new version{initial, 0}), staging(std::move(initial)) {}
+
+_snapshot_sparse_set_template
+inline _snapshot_sparse_set_def::~snapshot_sparse_set() {
+    delete current.load();
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::make_reader() -> reader {
+    for (auto &slot : slots) {
+        bool expected = false;
+        if (slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            return reader(this, &slot);
+        }
+    }
+    throw std::length_error("snapshot_sparse_set: every reader slot is claimed");
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::insert(const value_type &value) -> bool {
+    std::lock_guard lock(writer_mutex);
+    return staging.insert(value).second;
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::insert(value_type &&value) -> bool {
+    std::lock_guard lock(writer_mutex);
+    return staging.insert(std::move(value)).second;
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::erase(const value_type &value) -> size_t {
+    std::lock_guard lock(writer_mutex);
+    return staging.erase(value);
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::clear() -> void {
+    std::lock_guard lock(writer_mutex);
+    staging.clear();
+}
+
+_snapshot_sparse_set_template
+template <class F>
+inline auto _snapshot_sparse_set_def::update(F &&fn) -> void {
+    std::lock_guard lock(writer_mutex);
+    std::forward<F>(fn)(staging);
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::publish() -> void {
+    std::lock_guard lock(writer_mutex);
+
+    std::unique_ptr<version> next;
+    if (spare != nullptr) {
+        next      = std::move(spare);
+        next->set = staging;
+    } else {
+        next = std::make_unique<version>(version{staging, 0});
+    }
+
+    retired.reserve(retired.size() + 1);
+    std::unique_ptr<version> old(current.exchange(next.release()));
+    old->retired_at = global_epoch.fetch_add(1);
+    retired.push_back(std::move(old));
+    reclaim_locked();
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::pending_reclaim() const -> size_t {
+    std::lock_guard lock(writer_mutex);
+    return retired.size();
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::reclaim() -> void {
+    std::lock_guard lock(writer_mutex);
+    reclaim_locked();
+}
+
+_snapshot_sparse_set_template
+inline auto _snapshot_sparse_set_def::reclaim_locked() -> void {
+    std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+    for (const auto &slot : slots) {
+        std::uint64_t epoch = slot.epoch.load();
+        if (epoch != 0) oldest = std::min(oldest, epoch);
+    }
+
+    // A reader pinned at epoch e may hold any version retired at e or later
+    auto free = std::ranges::partition(retired, [&](const auto &old) {
+        return old->retired_at >= oldest;
+    });
+    if (spare == nullptr && !free.empty()) spare = std::move(free.front());
+    retired.erase(free.begin(), free.end());
+}
+
+#undef _snapshot_sparse_set_template
+#undef _snapshot_sparse_set_def
+
+#endif
@@ -0,0 +1,1065 @@
+#ifndef _SPARSE_GROUP_SET_HPP
+#define _SPARSE_GROUP_SET_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define SPARSE_GROUP_SSE2 1
+#endif
+
+#include "./common.hpp"
+
+#ifndef INIT_SPARSE_SIZE
+#    define INIT_SPARSE_SIZE 32
+#endif
+#ifndef GROUP_LOAD_FACTOR
+#    define GROUP_LOAD_FACTOR 0.875
+#endif
+#ifndef SPARSE_SIZE_GROW
+#    define SPARSE_SIZE_GROW 2
+#endif
+
+// One control byte per index slot: EMPTY, DELETED, or the low 7 bits of the hash fingerprint.
+// A group is 16 consecutive control bytes that are matched against a fingerprint at once.
+struct sparse_group {
+    static constexpr size_t      width   = 16;
+    static constexpr std::int8_t empty   = -128;
+    static constexpr std::int8_t deleted = -2;
+
+    explicit sparse_group(const std::int8_t *ctrl) {
+#ifdef SPARSE_GROUP_SSE2
+        bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+#else
+        std::copy_n(ctrl, width, bytes);
+#endif
+    }
+
+    [[nodiscard]] auto match(std::int8_t h2) const -> std::uint32_t {
+#ifdef SPARSE_GROUP_SSE2
+        return to_mask(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), bytes)));
+#else
+        std::uint32_t mask = 0;
+        for (size_t i = 0; i < width; ++i) {
+            if (bytes[i] == h2) mask |= 1U << i;
+        }
+        return mask;
+#endif
+    }
+
+    [[nodiscard]] auto match_empty() const -> std::uint32_t { return match(empty); }
+
+    // EMPTY and DELETED are the only control bytes with the sign bit set
+    [[nodiscard]] auto match_empty_or_deleted() const -> std::uint32_t {
+#ifdef SPARSE_GROUP_SSE2
+        return to_mask(_mm_movemask_epi8(bytes));
+#else
+        std::uint32_t mask = 0;
+        for (size_t i = 0; i < width; ++i) {
+            if (bytes[i] < 0) mask |= 1U << i;
+        }
+        return mask;
+#endif
+    }
+
+private:
+#ifdef SPARSE_GROUP_SSE2
+    __m128i bytes;
+
+    static auto to_mask(int movemask) -> std::uint32_t {
+        return static_cast<std::uint32_t>(movemask);
+    }
+#else
+    std::int8_t bytes[width];
+#endif
+};
+
+// Same dense layout and API as sparse_set, but the index is probed a 16-slot group at a time
+// instead of slot by slot with Robin Hood displacement.
+template <
+    typename T,
+    typename Hash      = std::hash<T>,
+    typename KeyEqual  = std::equal_to<T>,
+    typename Allocator = std::allocator<T>>
+class group_sparse_set {
+public:
+    using key_type       = T;
+    using value_type     = T;
+    using hasher         = Hash;
+    using key_equal      = KeyEqual;
+    using allocator_type = Allocator;
+
+private:
+    using dense_arr_type = std::vector<value_type, allocator_type>;
+
+    using pos_type      = sparse_entry::pos_type;
+    using ctrl_arr_type = std::vector<
+        std::int8_t,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<std::int8_t>>;
+    using sparse_arr_type = std::vector<
+        pos_type,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<pos_type>>;
+
+public:
+    using iterator               = typename dense_arr_type::iterator;
+    using const_iterator         = typename dense_arr_type::const_iterator;
+    using reverse_iterator       = typename dense_arr_type::reverse_iterator;
+    using const_reverse_iterator = typename dense_arr_type::const_reverse_iterator;
+
+public:
+    group_sparse_set() : group_sparse_set(INIT_SPARSE_SIZE) {}
+    explicit group_sparse_set(
+        size_t                bucket_count,
+        const hasher         &hash  = hasher(),
+        const key_equal      &equal = key_equal(),
+        const allocator_type &alloc = allocator_type()
+    )
+      : dense_arr(alloc)
+      , ctrl_arr(valid_size(bucket_count), sparse_group::empty, alloc)
+      , sparse_arr(valid_size(bucket_count), alloc)
+      , hash_fn(hash)
+      , equal_fn(equal) {}
+    ~group_sparse_set() = default;
+
+    group_sparse_set(const group_sparse_set &)                     = default;
+    auto operator=(const group_sparse_set &) -> group_sparse_set & = default;
+
+    group_sparse_set(group_sparse_set &&) noexcept                     = default;
+    auto operator=(group_sparse_set &&) noexcept -> group_sparse_set & = default;
+
+public:
+    [[nodiscard]] auto size() const -> size_t { return dense_arr.size(); }
+    [[nodiscard]] auto empty() const -> bool { return dense_arr.empty(); }
+    [[nodiscard]] auto capacity() const -> size_t { return dense_arr.capacity(); }
+
+    [[nodiscard]] auto sparse_size() const -> size_t { return sparse_arr.size(); }
+
+    [[nodiscard]] auto hash_function() const -> hasher { return hash_fn; }
+    [[nodiscard]] auto key_eq() const -> key_equal { return equal_fn; }
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return dense_arr.get_allocator(); }
+
+    auto begin() -> iterator { return dense_arr.begin(); }
+    auto end() -> iterator { return dense_arr.end(); }
+    auto begin() const -> const_iterator { return dense_arr.begin(); }
+    auto end() const -> const_iterator { return dense_arr.end(); }
+    auto cbegin() const -> const_iterator { return dense_arr.cbegin(); }
+    auto cend() const -> const_iterator { return dense_arr.cend(); }
+
+    auto rbegin() -> reverse_iterator { return dense_arr.rbegin(); }
+    auto rend() -> reverse_iterator { return dense_arr.rend(); }
+    auto rbegin() const -> const_reverse_iterator { return dense_arr.rbegin(); }
+    auto rend() const -> const_reverse_iterator { return dense_arr.rend(); }
+    auto crbegin() const -> const_reverse_iterator { return dense_arr.crbegin(); }
+    auto crend() const -> const_reverse_iterator { return dense_arr.crend(); }
+
+    auto clear() noexcept -> void;
+
+    auto insert(const value_type &value) -> std::pair<iterator, bool>;
+    auto insert(value_type &&value) -> std::pair<iterator, bool>;
+    template <class InputIt>
+    auto insert(InputIt first, InputIt last) -> void;
+    auto insert(std::initializer_list<value_type> ilist) -> void;
+
+    auto insert_range(container_compatible_range<value_type> auto &&rg) -> void;
+
+    template <class... Args>
+    auto emplace(Args &&...args) -> std::pair<iterator, bool>;
+
+    auto erase(const value_type &value) -> size_t;
+
+    auto find(const value_type &value) -> iterator;
+    auto find(const value_type &value) const -> const_iterator;
+    auto count(const value_type &value) const -> size_t;
+    auto contains(const value_type &value) const -> bool;
+
+    auto swap(group_sparse_set &other) noexcept(
+        std::allocator_traits<allocator_type>::is_always_equal::value
+        && std::is_nothrow_swappable_v<hasher> && std::is_nothrow_swappable_v<key_equal>
+    ) -> void;
+
+    auto rehash(size_t new_sparse_size) -> void;
+
+    auto reserve(size_t count) -> void;
+
+private:
+    dense_arr_type  dense_arr;
+    ctrl_arr_type   ctrl_arr;
+    sparse_arr_type sparse_arr;
+    size_t          deleted_count{0};
+
+    [[no_unique_address]] hasher    hash_fn;
+    [[no_unique_address]] key_equal equal_fn;
+
+private:
+    static auto valid_size(size_t size) -> size_t {
+        return std::bit_ceil(std::max(size, 2 * sparse_group::width));
+    }
+    static auto h2_of(size_t hash_code) -> std::int8_t {
+        return static_cast<std::int8_t>(sparse_fingerprint(hash_code) & 0x7FU);
+    }
+
+    auto hash(const value_type &value) const -> size_t { return hash_fn(value); }
+    auto group_count() const -> size_t { return sparse_size() / sparse_group::width; }
+    auto group_of(size_t hash_code) const -> size_t {
+        return fibonacci_slot_policy::slot(hash_code, group_count());
+    }
+    auto max_load() const -> size_t {
+        return static_cast<size_t>(
+            std::floor(static_cast<double>(sparse_size()) * GROUP_LOAD_FACTOR)
+        );
+    }
+
+    template <class V>
+    auto insert_value(V &&value) -> std::pair<iterator, bool>;
+
+    auto prepare_insert() -> void;
+    auto insert_sparse_by_pos(size_t pos) -> void;
+    // One probe for value: {its slot, true}, or {the slot it would take, false}. The slot is
+    // sparse_size() when the set is empty, since a moved-from set has no groups to probe.
+    auto find_or_free_slot(const value_type &value, size_t hash_code) const
+        -> std::pair<size_t, bool>;
+    // First EMPTY or DELETED slot on the probe sequence of hash_code
+    auto free_slot(size_t hash_code) const -> size_t;
+    auto occupy(size_t slot, size_t hash_code, size_t pos) -> void;
+    auto find_sparse_by_value(const value_type &value) const -> size_t;
+    auto find_sparse_by_pos(size_t hash_code, size_t pos) const -> size_t;
+    auto remove_sparse_by_slot(size_t slot) -> void;
+};
+
+#define _group_sparse_set_template \
+    template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+#define _group_sparse_set_def group_sparse_set<T, Hash, KeyEqual, Allocator>
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::clear() noexcept -> void {
+    dense_arr.clear();
+    std::fill(ctrl_arr.begin(), ctrl_arr.end(), sparse_group::empty);
+    deleted_count = 0;
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::insert(const value_type &value) -> std::pair<iterator, bool> {
+    return insert_value(value);
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::insert(value_type &&value) -> std::pair<iterator, bool> {
+    return insert_value(std::move(value));
+}
+
+_group_sparse_set_template
+template <class InputIt>
+inline auto _group_sparse_set_def::insert(InputIt first, InputIt last) -> void {
+    for (; first != last; ++first) {
+        auto &&v = *first;
+        (void)insert(std::forward<decltype(v)>(v));
+    }
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::insert(std::initializer_list<value_type> ilist) -> void {
+    insert(ilist.begin(), ilist.end());
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::insert_range(container_compatible_range<value_type> auto &&rg)
+    -> void {
+    for (auto &&v : rg) {
+        (void)insert(std::forward<decltype(v)>(v));
+    }
+}
+
+_group_sparse_set_template
+template <class... Args>
+inline auto _group_sparse_set_def::emplace(Args &&...args) -> std::pair<iterator, bool> {
+    value_type value{std::forward<Args>(args)...};
+    return insert_value(std::move(value));
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::erase(const value_type &value) -> size_t {
+    if (dense_arr.empty()) return 0;
+
+    size_t slot = find_sparse_by_value(value);
+    if (slot == sparse_size()) return 0;
+
+    size_t pos  = sparse_arr[slot];
+    size_t back = size() - 1;
+
+    if (pos != back) {
+        sparse_arr[find_sparse_by_pos(hash(dense_arr.back()), back)] = static_cast<pos_type>(pos);
+    }
+    remove_sparse_by_slot(slot);
+
+    dense_arr[pos] = std::move(dense_arr.back());
+    dense_arr.pop_back();
+
+    return 1;
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::find(const value_type &value) -> iterator {
+    size_t slot = find_sparse_by_value(value);
+    if (slot == sparse_size()) return end();
+    return dense_arr.begin() + static_cast<std::ptrdiff_t>(sparse_arr[slot]);
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::find(const value_type &value) const -> const_iterator {
+    size_t slot = find_sparse_by_value(value);
+    if (slot == sparse_size()) return end();
+    return dense_arr.begin() + static_cast<std::ptrdiff_t>(sparse_arr[slot]);
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::count(const value_type &value) const -> size_t {
+    return (find_sparse_by_value(value) < sparse_size() ? 1 : 0);
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::contains(const value_type &value) const -> bool {
+    return find_sparse_by_value(value) < sparse_size();
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::swap(group_sparse_set &other) noexcept(
+    std::allocator_traits<allocator_type>::is_always_equal::value
+    && std::is_nothrow_swappable_v<hasher> && std::is_nothrow_swappable_v<key_equal>
+) -> void {
+    dense_arr.swap(other.dense_arr);
+    ctrl_arr.swap(other.ctrl_arr);
+    sparse_arr.swap(other.sparse_arr);
+    std::swap(deleted_count, other.deleted_count);
+    std::swap(hash_fn, other.hash_fn);
+    std::swap(equal_fn, other.equal_fn);
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::rehash(size_t new_sparse_size) -> void {
+    new_sparse_size = valid_size(new_sparse_size);
+    while (static_cast<double>(new_sparse_size) * GROUP_LOAD_FACTOR
+           <= static_cast<double>(size())) {
+        new_sparse_size *= SPARSE_SIZE_GROW;
+    }
+
+    ctrl_arr.assign(new_sparse_size, sparse_group::empty);
+    sparse_arr.resize(new_sparse_size);
+    deleted_count = 0;
+    for (auto idx : std::views::iota(0U, dense_arr.size())) {
+        insert_sparse_by_pos(idx);
+    }
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::reserve(size_t count) -> void {
+    dense_arr.reserve(count);
+    if (count >= max_load()) {
+        rehash(static_cast<size_t>(static_cast<double>(count) / GROUP_LOAD_FACTOR) + 1);
+    }
+}
+
+_group_sparse_set_template
+template <class V>
+inline auto _group_sparse_set_def::insert_value(V &&value) -> std::pair<iterator, bool> {
+    size_t hash_code   = hash(value);
+    auto [slot, found] = find_or_free_slot(value, hash_code);
+    if (found) return {begin() + static_cast<std::ptrdiff_t>(sparse_arr[slot]), false};
+
+    // Growing or rebuilding moves every slot, so the free one is looked up again
+    bool rebuilds = size() + deleted_count >= max_load();
+    prepare_insert();
+    if (rebuilds || slot == sparse_size()) slot = free_slot(hash_code);
+
+    dense_arr.push_back(std::forward<V>(value));
+    occupy(slot, hash_code, size() - 1);
+
+    return {end() - 1, true};
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::prepare_insert() -> void {
+    if (size() >= sparse_entry::max_pos) {
+        throw std::length_error("group_sparse_set: size exceeds the sparse entry position range");
+    }
+
+    if (size() + deleted_count < max_load()) return;
+
+    // Mostly tombstones: rebuild in place instead of growing
+    if (size() < max_load() / 2) {
+        rehash(sparse_size());
+    } else {
+        rehash(sparse_size() * SPARSE_SIZE_GROW);
+    }
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::insert_sparse_by_pos(size_t pos) -> void {
+    size_t hash_code = hash(dense_arr[pos]);
+    occupy(free_slot(hash_code), hash_code, pos);
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::find_or_free_slot(
+    const value_type &value, size_t hash_code
+) const -> std::pair<size_t, bool> {
+    if (dense_arr.empty()) return {sparse_size(), false};
+
+    std::int8_t h2    = h2_of(hash_code);
+    size_t      group = group_of(hash_code);
+    size_t      free  = sparse_size();
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        for (auto mask = g.match(h2); mask != 0; mask &= mask - 1) {
+            size_t slot = base + static_cast<size_t>(std::countr_zero(mask));
+            if (equal_fn(dense_arr[sparse_arr[slot]], value)) return {slot, true};
+        }
+        auto vacant = g.match_empty_or_deleted();
+        if (free == sparse_size() && vacant != 0) {
+            free = base + static_cast<size_t>(std::countr_zero(vacant));
+        }
+        if (g.match_empty() != 0) return {free, false};
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::free_slot(size_t hash_code) const -> size_t {
+    size_t group = group_of(hash_code);
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        if (auto mask = g.match_empty_or_deleted(); mask != 0) {
+            return base + static_cast<size_t>(std::countr_zero(mask));
+        }
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::occupy(size_t slot, size_t hash_code, size_t pos) -> void {
+    if (ctrl_arr[slot] == sparse_group::deleted) deleted_count--;
+    ctrl_arr[slot]   = h2_of(hash_code);
+    sparse_arr[slot] = static_cast<pos_type>(pos);
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::find_sparse_by_value(const value_type &value) const -> size_t {
+    if (dense_arr.empty()) return sparse_size();
+
+    size_t      hash_code = hash(value);
+    std::int8_t h2        = h2_of(hash_code);
+    size_t      group     = group_of(hash_code);
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        for (auto mask = g.match(h2); mask != 0; mask &= mask - 1) {
+            size_t slot = base + static_cast<size_t>(std::countr_zero(mask));
+            if (equal_fn(dense_arr[sparse_arr[slot]], value)) return slot;
+        }
+        if (g.match_empty() != 0) return sparse_size();
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::find_sparse_by_pos(size_t hash_code, size_t pos) const
+    -> size_t {
+    std::int8_t h2    = h2_of(hash_code);
+    size_t      group = group_of(hash_code);
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        for (auto mask = g.match(h2); mask != 0; mask &= mask - 1) {
+            size_t slot = base + static_cast<size_t>(std::countr_zero(mask));
+            if (sparse_arr[slot] == pos) return slot;
+        }
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_set_template
+inline auto _group_sparse_set_def::remove_sparse_by_slot(size_t slot) -> void {
+    // A group that still has an EMPTY slot was never full, so no probe sequence continued past it
+    // and the slot can go back to EMPTY; otherwise it must stay a tombstone.
+    size_t       base = slot - slot % sparse_group::width;
+    sparse_group g(ctrl_arr.data() + base);
+    if (g.match_empty() != 0) {
+        ctrl_arr[slot] = sparse_group::empty;
+    } else {
+        ctrl_arr[slot] = sparse_group::deleted;
+        deleted_count++;
+    }
+}
+
+_group_sparse_set_template
+auto swap(_group_sparse_set_def &lhs, _group_sparse_set_def &rhs)
+    noexcept(noexcept(lhs.swap(rhs))) -> void {
+    lhs.swap(rhs);
+}
+
+#undef _group_sparse_set_template
+#undef _group_sparse_set_def
+
+// Same dense layout and API as sparse_key_set, indexed like group_sparse_set: values and keys sit
+// in parallel dense arrays and the index is probed a 16-slot group at a time.
+template <
+    typename Key,
+    typename T,
+    typename Hash      = std::hash<Key>,
+    typename KeyEqual  = std::equal_to<Key>,
+    typename Allocator = std::allocator<T>>
+class group_sparse_key_set {
+public:
+    using key_type       = Key;
+    using mapped_type    = T;
+    using value_type     = T;
+    using key_value_type = std::pair<key_type, value_type>;
+    using hasher         = Hash;
+    using key_equal      = KeyEqual;
+    using allocator_type = Allocator;
+
+private:
+    using dense_arr_type     = std::vector<value_type, allocator_type>;
+    using dense_key_arr_type = std::vector<
+        key_type,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<key_type>>;
+
+    using pos_type      = sparse_entry::pos_type;
+    using ctrl_arr_type = std::vector<
+        std::int8_t,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<std::int8_t>>;
+    using sparse_arr_type = std::vector<
+        pos_type,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<pos_type>>;
+
+public:
+    using iterator               = typename dense_arr_type::iterator;
+    using const_iterator         = typename dense_arr_type::const_iterator;
+    using reverse_iterator       = typename dense_arr_type::reverse_iterator;
+    using const_reverse_iterator = typename dense_arr_type::const_reverse_iterator;
+
+public:
+    group_sparse_key_set() : group_sparse_key_set(INIT_SPARSE_SIZE) {}
+    explicit group_sparse_key_set(
+        size_t                bucket_count,
+        const hasher         &hash  = hasher(),
+        const key_equal      &equal = key_equal(),
+        const allocator_type &alloc = allocator_type()
+    )
+      : dense_arr(alloc)
+      , dense_key_arr(alloc)
+      , ctrl_arr(valid_size(bucket_count), sparse_group::empty, alloc)
+      , sparse_arr(valid_size(bucket_count), alloc)
+      , hash_fn(hash)
+      , equal_fn(equal) {}
+    ~group_sparse_key_set() = default;
+
+    group_sparse_key_set(const group_sparse_key_set &)                     = default;
+    auto operator=(const group_sparse_key_set &) -> group_sparse_key_set & = default;
+
+    group_sparse_key_set(group_sparse_key_set &&) noexcept                     = default;
+    auto operator=(group_sparse_key_set &&) noexcept -> group_sparse_key_set & = default;
+
+public:
+    [[nodiscard]] auto size() const -> size_t { return dense_arr.size(); }
+    [[nodiscard]] auto empty() const -> bool { return dense_arr.empty(); }
+    [[nodiscard]] auto capacity() const -> size_t { return dense_arr.capacity(); }
+
+    [[nodiscard]] auto sparse_size() const -> size_t { return sparse_arr.size(); }
+
+    [[nodiscard]] auto hash_function() const -> hasher { return hash_fn; }
+    [[nodiscard]] auto key_eq() const -> key_equal { return equal_fn; }
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return dense_arr.get_allocator(); }
+
+    auto begin() -> iterator { return dense_arr.begin(); }
+    auto end() -> iterator { return dense_arr.end(); }
+    auto begin() const -> const_iterator { return dense_arr.begin(); }
+    auto end() const -> const_iterator { return dense_arr.end(); }
+    auto cbegin() const -> const_iterator { return dense_arr.cbegin(); }
+    auto cend() const -> const_iterator { return dense_arr.cend(); }
+
+    // Keys in dense order, parallel to [begin(), end())
+    [[nodiscard]] auto keys() const -> std::span<const key_type> { return dense_key_arr; }
+
+    auto rbegin() -> reverse_iterator { return dense_arr.rbegin(); }
+    auto rend() -> reverse_iterator { return dense_arr.rend(); }
+    auto rbegin() const -> const_reverse_iterator { return dense_arr.rbegin(); }
+    auto rend() const -> const_reverse_iterator { return dense_arr.rend(); }
+    auto crbegin() const -> const_reverse_iterator { return dense_arr.crbegin(); }
+    auto crend() const -> const_reverse_iterator { return dense_arr.crend(); }
+
+    auto clear() noexcept -> void;
+
+    auto insert(const key_type &key, const value_type &value) -> std::pair<iterator, bool>;
+    auto insert(key_type &&key, value_type &&value) -> std::pair<iterator, bool>;
+    auto insert(const key_value_type &pair) -> std::pair<iterator, bool>;
+    auto insert(key_value_type &&pair) -> std::pair<iterator, bool>;
+    template <class InputIt>
+    auto insert(InputIt first, InputIt last) -> void;
+    auto insert(std::initializer_list<key_value_type> ilist) -> void;
+
+    auto insert_range(container_compatible_range<key_value_type> auto &&rg) -> void;
+
+    // Construct the value in place only when the key is absent; never touch args otherwise
+    template <class... Args>
+    auto try_emplace(const key_type &key, Args &&...args) -> std::pair<iterator, bool>;
+    template <class... Args>
+    auto try_emplace(key_type &&key, Args &&...args) -> std::pair<iterator, bool>;
+
+    template <class M>
+    auto insert_or_assign(const key_type &key, M &&obj) -> std::pair<iterator, bool>;
+
+    auto erase(const key_type &key) -> size_t;
+
+    auto find(const key_type &key) -> iterator;
+    auto find(const key_type &key) const -> const_iterator;
+    auto count(const key_type &key) const -> size_t;
+    auto contains(const key_type &key) const -> bool;
+
+    auto at(const key_type &key) -> value_type &;
+    auto at(const key_type &key) const -> const value_type &;
+
+    auto operator[](const key_type &key) -> value_type &;
+
+    auto swap(group_sparse_key_set &other) noexcept(
+        std::allocator_traits<allocator_type>::is_always_equal::value
+        && std::is_nothrow_swappable_v<hasher> && std::is_nothrow_swappable_v<key_equal>
+    ) -> void;
+
+    auto rehash(size_t new_sparse_size) -> void;
+
+    auto reserve(size_t count) -> void;
+
+private:
+    dense_arr_type     dense_arr;
+    dense_key_arr_type dense_key_arr;
+    ctrl_arr_type      ctrl_arr;
+    sparse_arr_type    sparse_arr;
+    size_t             deleted_count{0};
+
+    [[no_unique_address]] hasher    hash_fn;
+    [[no_unique_address]] key_equal equal_fn;
+
+private:
+    static auto valid_size(size_t size) -> size_t {
+        return std::bit_ceil(std::max(size, 2 * sparse_group::width));
+    }
+    static auto h2_of(size_t hash_code) -> std::int8_t {
+        return static_cast<std::int8_t>(sparse_fingerprint(hash_code) & 0x7FU);
+    }
+
+    auto hash(const key_type &key) const -> size_t { return hash_fn(key); }
+    auto group_count() const -> size_t { return sparse_size() / sparse_group::width; }
+    auto group_of(size_t hash_code) const -> size_t {
+        return fibonacci_slot_policy::slot(hash_code, group_count());
+    }
+    auto max_load() const -> size_t {
+        return static_cast<size_t>(
+            std::floor(static_cast<double>(sparse_size()) * GROUP_LOAD_FACTOR)
+        );
+    }
+    auto find_pos(const key_type &key) const -> size_t {
+        size_t slot = find_sparse_by_key(key);
+        return slot == sparse_size() ? size() : sparse_arr[slot];
+    }
+
+    template <class K, class... Args>
+    auto try_emplace_key(K &&key, Args &&...args) -> std::pair<iterator, bool>;
+    // Appends key and its value, claiming slot as find_or_free_slot found it
+    template <class K, class... Args>
+    auto emplace_at(size_t slot, size_t hash_code, K &&key, Args &&...args)
+        -> std::pair<iterator, bool>;
+
+    auto prepare_insert() -> void;
+    auto insert_sparse_by_pos(size_t pos) -> void;
+    // One probe for key: {its slot, true}, or {the slot it would take, false}. The slot is
+    // sparse_size() when the set is empty, since a moved-from set has no groups to probe.
+    auto find_or_free_slot(const key_type &key, size_t hash_code) const
+        -> std::pair<size_t, bool>;
+    // First EMPTY or DELETED slot on the probe sequence of hash_code
+    auto free_slot(size_t hash_code) const -> size_t;
+    auto occupy(size_t slot, size_t hash_code, size_t pos) -> void;
+    auto find_sparse_by_key(const key_type &key) const -> size_t;
+    auto find_sparse_by_pos(size_t hash_code, size_t pos) const -> size_t;
+    auto remove_sparse_by_slot(size_t slot) -> void;
+};
+
+#define _group_sparse_key_set_template \
+    template <typename Key, typename T, typename Hash, typename KeyEqual, typename Allocator>
+#define _group_sparse_key_set_def group_sparse_key_set<Key, T, Hash, KeyEqual, Allocator>
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::clear() noexcept -> void {
+    dense_arr.clear();
+    dense_key_arr.clear();
+    std::fill(ctrl_arr.begin(), ctrl_arr.end(), sparse_group::empty);
+    deleted_count = 0;
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::insert(const key_type &key, const value_type &value)
+    -> std::pair<iterator, bool> {
+    return try_emplace_key(key, value);
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::insert(key_type &&key, value_type &&value)
+    -> std::pair<iterator, bool> {
+    return try_emplace_key(std::move(key), std::move(value));
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::insert(const key_value_type &pair)
+    -> std::pair<iterator, bool> {
+    return try_emplace_key(pair.first, pair.second);
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::insert(key_value_type &&pair) -> std::pair<iterator, bool> {
+    return try_emplace_key(std::move(pair.first), std::move(pair.second));
+}
+
+_group_sparse_key_set_template
+template <class InputIt>
+inline auto _group_sparse_key_set_def::insert(InputIt first, InputIt last) -> void {
+    for (; first != last; ++first) {
+        auto &&p = *first;
+        (void)insert(std::forward<decltype(p)>(p));
+    }
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::insert(std::initializer_list<key_value_type> ilist)
+    -> void {
+    insert(ilist.begin(), ilist.end());
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::insert_range(
+    container_compatible_range<key_value_type> auto &&rg
+) -> void {
+    for (auto &&v : rg) {
+        (void)insert(std::forward<decltype(v)>(v));
+    }
+}
+
+_group_sparse_key_set_template
+template <class... Args>
+inline auto _group_sparse_key_set_def::try_emplace(const key_type &key, Args &&...args)
+    -> std::pair<iterator, bool> {
+    return try_emplace_key(key, std::forward<Args>(args)...);
+}
+
+_group_sparse_key_set_template
+template <class... Args>
+inline auto _group_sparse_key_set_def::try_emplace(key_type &&key, Args &&...args)
+    -> std::pair<iterator, bool> {
+    return try_emplace_key(std::move(key), std::forward<Args>(args)...);
+}
+
+_group_sparse_key_set_template
+template <class M>
+inline auto _group_sparse_key_set_def::insert_or_assign(const key_type &key, M &&obj)
+    -> std::pair<iterator, bool> {
+    size_t hash_code   = hash(key);
+    auto [slot, found] = find_or_free_slot(key, hash_code);
+    if (found) {
+        size_t pos     = sparse_arr[slot];
+        dense_arr[pos] = std::forward<M>(obj);
+        return {begin() + static_cast<std::ptrdiff_t>(pos), false};
+    }
+    return emplace_at(slot, hash_code, key, std::forward<M>(obj));
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::erase(const key_type &key) -> size_t {
+    if (dense_arr.empty()) return 0;
+
+    size_t slot = find_sparse_by_key(key);
+    if (slot == sparse_size()) return 0;
+
+    size_t pos  = sparse_arr[slot];
+    size_t back = size() - 1;
+
+    if (pos != back) {
+        sparse_arr[find_sparse_by_pos(hash(dense_key_arr.back()), back)]
+            = static_cast<pos_type>(pos);
+    }
+    remove_sparse_by_slot(slot);
+
+    dense_arr[pos]     = std::move(dense_arr.back());
+    dense_key_arr[pos] = std::move(dense_key_arr.back());
+    dense_arr.pop_back();
+    dense_key_arr.pop_back();
+
+    return 1;
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::find(const key_type &key) -> iterator {
+    return begin() + static_cast<std::ptrdiff_t>(find_pos(key));
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::find(const key_type &key) const -> const_iterator {
+    return begin() + static_cast<std::ptrdiff_t>(find_pos(key));
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::count(const key_type &key) const -> size_t {
+    return (find_sparse_by_key(key) < sparse_size() ? 1 : 0);
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::contains(const key_type &key) const -> bool {
+    return find_sparse_by_key(key) < sparse_size();
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::at(const key_type &key) -> value_type & {
+    size_t pos = find_pos(key);
+    if (pos == size()) {
+        throw std::out_of_range("group_sparse_key_set::at: key not found");
+    }
+    return dense_arr[pos];
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::at(const key_type &key) const -> const value_type & {
+    size_t pos = find_pos(key);
+    if (pos == size()) {
+        throw std::out_of_range("group_sparse_key_set::at: key not found");
+    }
+    return dense_arr[pos];
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::operator[](const key_type &key) -> value_type & {
+    return *try_emplace_key(key).first;
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::swap(group_sparse_key_set &other) noexcept(
+    std::allocator_traits<allocator_type>::is_always_equal::value
+    && std::is_nothrow_swappable_v<hasher> && std::is_nothrow_swappable_v<key_equal>
+) -> void {
+    dense_arr.swap(other.dense_arr);
+    dense_key_arr.swap(other.dense_key_arr);
+    ctrl_arr.swap(other.ctrl_arr);
+    sparse_arr.swap(other.sparse_arr);
+    std::swap(deleted_count, other.deleted_count);
+    std::swap(hash_fn, other.hash_fn);
+    std::swap(equal_fn, other.equal_fn);
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::rehash(size_t new_sparse_size) -> void {
+    new_sparse_size = valid_size(new_sparse_size);
+    while (static_cast<double>(new_sparse_size) * GROUP_LOAD_FACTOR
+           <= static_cast<double>(size())) {
+        new_sparse_size *= SPARSE_SIZE_GROW;
+    }
+
+    ctrl_arr.assign(new_sparse_size, sparse_group::empty);
+    sparse_arr.resize(new_sparse_size);
+    deleted_count = 0;
+    for (auto idx : std::views::iota(0U, dense_arr.size())) {
+        insert_sparse_by_pos(idx);
+    }
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::reserve(size_t count) -> void {
+    dense_arr.reserve(count);
+    dense_key_arr.reserve(count);
+    if (count >= max_load()) {
+        rehash(static_cast<size_t>(static_cast<double>(count) / GROUP_LOAD_FACTOR) + 1);
+    }
+}
+
+_group_sparse_key_set_template
+template <class K, class... Args>
+inline auto _group_sparse_key_set_def::try_emplace_key(K &&key, Args &&...args)
+    -> std::pair<iterator, bool> {
+    size_t hash_code   = hash(key);
+    auto [slot, found] = find_or_free_slot(key, hash_code);
+    if (found) return {begin() + static_cast<std::ptrdiff_t>(sparse_arr[slot]), false};
+    return emplace_at(slot, hash_code, std::forward<K>(key), std::forward<Args>(args)...);
+}
+
+_group_sparse_key_set_template
+template <class K, class... Args>
+inline auto _group_sparse_key_set_def::emplace_at(
+    size_t slot, size_t hash_code, K &&key, Args &&...args
+) -> std::pair<iterator, bool> {
+    // Growing or rebuilding moves every slot, so the free one is looked up again
+    bool rebuilds = size() + deleted_count >= max_load();
+    prepare_insert();
+    if (rebuilds || slot == sparse_size()) slot = free_slot(hash_code);
+
+    dense_key_arr.emplace_back(std::forward<K>(key));
+    try {
+        dense_arr.emplace_back(std::forward<Args>(args)...);
+    } catch (...) {
+        dense_key_arr.pop_back();
+        throw;
+    }
+    occupy(slot, hash_code, size() - 1);
+
+    return {end() - 1, true};
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::prepare_insert() -> void {
+    if (size() >= sparse_entry::max_pos) {
+        throw std::length_error(
+            "group_sparse_key_set: size exceeds the sparse entry position range"
+        );
+    }
+
+    if (size() + deleted_count < max_load()) return;
+
+    // Mostly tombstones: rebuild in place instead of growing
+    if (size() < max_load() / 2) {
+        rehash(sparse_size());
+    } else {
+        rehash(sparse_size() * SPARSE_SIZE_GROW);
+    }
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::insert_sparse_by_pos(size_t pos) -> void {
+    size_t hash_code = hash(dense_key_arr[pos]);
+    occupy(free_slot(hash_code), hash_code, pos);
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::find_or_free_slot(
+    const key_type &key, size_t hash_code
+) const -> std::pair<size_t, bool> {
+    if (dense_arr.empty()) return {sparse_size(), false};
+
+    std::int8_t h2    = h2_of(hash_code);
+    size_t      group = group_of(hash_code);
+    size_t      free  = sparse_size();
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        for (auto mask = g.match(h2); mask != 0; mask &= mask - 1) {
+            size_t slot = base + static_cast<size_t>(std::countr_zero(mask));
+            if (equal_fn(dense_key_arr[sparse_arr[slot]], key)) return {slot, true};
+        }
+        auto vacant = g.match_empty_or_deleted();
+        if (free == sparse_size() && vacant != 0) {
+            free = base + static_cast<size_t>(std::countr_zero(vacant));
+        }
+        if (g.match_empty() != 0) return {free, false};
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::free_slot(size_t hash_code) const -> size_t {
+    size_t group = group_of(hash_code);
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        if (auto mask = g.match_empty_or_deleted(); mask != 0) {
+            return base + static_cast<size_t>(std::countr_zero(mask));
+        }
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::occupy(size_t slot, size_t hash_code, size_t pos) -> void {
+    if (ctrl_arr[slot] == sparse_group::deleted) deleted_count--;
+    ctrl_arr[slot]   = h2_of(hash_code);
+    sparse_arr[slot] = static_cast<pos_type>(pos);
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::find_sparse_by_key(const key_type &key) const -> size_t {
+    if (dense_arr.empty()) return sparse_size();
+
+    size_t      hash_code = hash(key);
+    std::int8_t h2        = h2_of(hash_code);
+    size_t      group     = group_of(hash_code);
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        for (auto mask = g.match(h2); mask != 0; mask &= mask - 1) {
+            size_t slot = base + static_cast<size_t>(std::countr_zero(mask));
+            if (equal_fn(dense_key_arr[sparse_arr[slot]], key)) return slot;
+        }
+        if (g.match_empty() != 0) return sparse_size();
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::find_sparse_by_pos(size_t hash_code, size_t pos) const
+    -> size_t {
+    std::int8_t h2    = h2_of(hash_code);
+    size_t      group = group_of(hash_code);
+
+    for (size_t step = 1;; ++step) {
+        size_t       base = group * sparse_group::width;
+        sparse_group g(ctrl_arr.data() + base);
+        for (auto mask = g.match(h2); mask != 0; mask &= mask - 1) {
+            size_t slot = base + static_cast<size_t>(std::countr_zero(mask));
+            if (sparse_arr[slot] == pos) return slot;
+        }
+        group = (group + step) & (group_count() - 1);
+    }
+    std::unreachable();
+}
+
+_group_sparse_key_set_template
+inline auto _group_sparse_key_set_def::remove_sparse_by_slot(size_t slot) -> void {
+    // Same rule as group_sparse_set: EMPTY only while the group was never full
+    size_t       base = slot - slot % sparse_group::width;
+    sparse_group g(ctrl_arr.data() + base);
+    if (g.match_empty() != 0) {
+        ctrl_arr[slot] = sparse_group::empty;
+    } else {
+        ctrl_arr[slot] = sparse_group::deleted;
+        deleted_count++;
+    }
+}
+
+_group_sparse_key_set_template
+auto swap(_group_sparse_key_set_def &lhs, _group_sparse_key_set_def &rhs)
+    noexcept(noexcept(lhs.swap(rhs))) -> void {
+    lhs.swap(rhs);
+}
+
+#undef _group_sparse_key_set_template
+#undef _group_sparse_key_set_def
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef _SPARSE_IMAGE_HPP
+#define _SPARSE_IMAGE_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <ranges>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "./common.hpp"
+
+#if __has_include(<unistd.h>)
+#    include <unistd.h>
+#    define SPARSE_IMAGE_FD 1
+#endif
+
+#ifndef SPARSE_IMAGE_BUFFER
+#    define SPARSE_IMAGE_BUFFER 65536
+#endif
+
+// Binary images of sets with trivially copyable elements, as written by save() and read back by
+// load(). An image is a sparse_image_header, the raw dense arrays and, unless it is compact, the
+// raw slot and index arrays, followed by a checksum of everything after the header.
+
+// image keeps the index, so loading it rebuilds nothing; compact keeps only the elements and
+// loading it rebuilds the index from them
+enum class sparse_image_encoding : std::uint32_t { image = 0, compact = 1 };
+
+// Element and entry sizes, word size and byte order are recorded so an image written by a
+// different build or platform is rejected instead of misread
+struct sparse_image_header {
+    static constexpr std::array<char, 8> magic_bytes{'S', 'P', 'S', 'E', 'T', 'I', 'M', 'G'};
+    static constexpr std::uint32_t       current_version = 1;
+    static constexpr std::uint32_t       byte_order_mark = 0x01020304;
+
+    static constexpr std::uint32_t compact     = 1U << 0U;
+    static constexpr std::uint32_t keyed       = 1U << 1U;
+    static constexpr std::uint32_t stored_hash = 1U << 2U;
+
+    std::array<char, 8> magic{magic_bytes};
+    std::uint32_t       version{current_version};
+    std::uint32_t       byte_order{byte_order_mark};
+    std::uint32_t       flags{0};
+    std::uint32_t       key_size{0};
+    std::uint32_t       value_size{0};
+    std::uint32_t       word_size{sizeof(size_t)};
+    std::uint32_t       entry_size{0};
+    std::uint32_t       reserved{0};
+    std::uint64_t       count{0};
+    std::uint64_t       sparse_size{0};
+    std::uint64_t       slot_parity{0};
+    // Checksum of every field above
+    std::uint64_t checksum{0};
+
+    [[nodiscard]] auto has(std::uint32_t flag) const -> bool { return (flags & flag) != 0; }
+
+    // Throws unless the image holds elements laid out as key_size/value_size describe; a
+    // key_size of 0 stands for a set without separate keys
+    auto expect_layout(size_t key_size_, size_t value_size_) const -> void {
+        if (has(keyed) != (key_size_ != 0) || key_size != key_size_ || value_size != value_size_) {
+            throw std::runtime_error("sparse image: element layout differs from the loading set");
+        }
+    }
+};
+
+static_assert(sizeof(sparse_image_header) == 72);
+static_assert(std::has_unique_object_representations_v<sparse_image_header>);
+
+// Running 64-bit checksum of a byte stream, a word at a time; the result does not depend on how
+// the stream is split across update() calls
+class sparse_image_checksum {
+public:
+    auto update(const void *data, size_t size) -> void {
+        const auto *bytes = static_cast<const unsigned char *>(data);
+        length += size;
+        if (pending_size != 0) {
+            size_t take = std::min(size, pending.size() - pending_size);
+            std::memcpy(pending.data() + pending_size, bytes, take);
+            pending_size += take;
+            bytes += take;
+            size -= take;
+            if (pending_size < pending.size()) return;
+            mix(load_word(pending.data()));
+            pending_size = 0;
+        }
+        for (; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t)) {
+            mix(load_word(bytes));
+            bytes += sizeof(std::uint64_t);
+        }
+        std::memcpy(pending.data(), bytes, size);
+        pending_size = size;
+    }
+
+    [[nodiscard]] auto value() const -> std::uint64_t {
+        sparse_image_checksum copy = *this;
+        if (copy.pending_size != 0) {
+            std::fill(
+                copy.pending.begin() + static_cast<std::ptrdiff_t>(copy.pending_size),
+                copy.pending.end(), 0
+            );
+            copy.mix(load_word(copy.pending.data()));
+        }
+        copy.mix(length);
+        return sparse_mix64(copy.state);
+    }
+
+private:
+    std::uint64_t                state{0x9E3779B97F4A7C15ULL};
+    std::uint64_t                length{0};
+    std::array<unsigned char, 8> pending{};
+    size_t                       pending_size{0};
+
+    static auto load_word(const unsigned char *bytes) -> std::uint64_t {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        return word;
+    }
+    auto mix(std::uint64_t word) -> void {
+        state = (state ^ word) * 0xFF51AFD7ED558CCDULL;
+        state ^= state >> 32U;
+    }
+};
+
+inline auto sparse_image_header_checksum(const sparse_image_header &header) -> std::uint64_t {
+    sparse_image_checksum checksum;
+    checksum.update(&header, offsetof(sparse_image_header, checksum));
+    return checksum.value();
+}
+
+// Byte sinks and sources; a short write or read throws
+struct sparse_stream_sink {
+    std::ostream &os;
+
+    auto write(const void *data, size_t size) -> void {
+        os.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        if (!os) throw std::runtime_error("sparse image: stream write failed");
+    }
+};
+
+struct sparse_stream_source {
+    std::istream &is;
+
+    auto read(void *data, size_t size) -> void {
+        is.read(static_cast<char *>(data), static_cast<std::streamsize>(size));
+        if (static_cast<size_t>(is.gcount()) != size) {
+            throw std::runtime_error("sparse image: unexpected end of stream");
+        }
+    }
+};
+
+#ifdef SPARSE_IMAGE_FD
+struct sparse_fd_sink {
+    int fd;
+
+    auto write(const void *data, size_t size) -> void {
+        const auto *bytes = static_cast<const char *>(data);
+        while (size > 0) {
+            ssize_t done = ::write(fd, bytes, size);
+            if (done < 0 && errno == EINTR) continue;
+            if (done <= 0) {
+                throw std::system_error(errno, std::generic_category(), "sparse image: write");
+            }
+            bytes += done;
+            size -= static_cast<size_t>(done);
+        }
+    }
+};
+
+struct sparse_fd_source {
+    int fd;
+
+    auto read(void *data, size_t size) -> void {
+        auto *bytes = static_cast<char *>(data);
+        while (size > 0) {
+            ssize_t done = ::read(fd, bytes, size);
+            if (done < 0 && errno == EINTR) continue;
+            if (done < 0) {
+                throw std::system_error(errno, std::generic_category(), "sparse image: read");
+            }
+            if (done == 0) throw std::runtime_error("sparse image: unexpected end of file");
+            bytes += done;
+            size -= static_cast<size_t>(done);
+        }
+    }
+};
+#endif
+
+// Writes the header, then the payload while checksumming it, then the checksum
+template <class Sink>
+class sparse_image_writer {
+public:
+    explicit sparse_image_writer(Sink &sink_) : sink(sink_) {}
+
+    auto write_header(sparse_image_header header) -> void {
+        header.checksum = sparse_image_header_checksum(header);
+        sink.write(&header, sizeof(header));
+    }
+
+    // Raw bytes of every element; contiguous ranges go out in one write
+    template <std::ranges::input_range R>
+    auto write_range(const R &range) -> void {
+        using elem_type = std::ranges::range_value_t<R>;
+        static_assert(std::is_trivially_copyable_v<elem_type>);
+
+        if constexpr (std::ranges::contiguous_range<const R>) {
+            write(std::ranges::data(range), std::ranges::size(range) * sizeof(elem_type));
+        } else {
+            std::vector<std::byte> buffer;
+            buffer.reserve(std::max<size_t>(SPARSE_IMAGE_BUFFER, sizeof(elem_type)));
+            for (const elem_type &elem : range) {
+                if (buffer.size() + sizeof(elem_type) > buffer.capacity()) flush(buffer);
+                const auto *bytes = reinterpret_cast<const std::byte *>(&elem);
+                buffer.insert(buffer.end(), bytes, bytes + sizeof(elem_type));
+            }
+            flush(buffer);
+        }
+    }
+
+    auto finish() -> void {
+        std::uint64_t value = checksum.value();
+        sink.write(&value, sizeof(value));
+    }
+
+private:
+    Sink                 &sink;
+    sparse_image_checksum checksum;
+
+    auto write(const void *data, size_t size) -> void {
+        checksum.update(data, size);
+        sink.write(data, size);
+    }
+    auto flush(std::vector<std::byte> &buffer) -> void {
+        write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+};
+
+// Reads and checks the header, then the payload while checksumming it; finish() must succeed
+// before anything read is trusted
+template <class Source>
+class sparse_image_reader {
+public:
+    explicit sparse_image_reader(Source &source_) : source(source_) {}
+
+    auto read_header() -> sparse_image_header {
+        sparse_image_header header;
+        source.read(&header, sizeof(header));
+        if (header.magic != sparse_image_header::magic_bytes) {
+            throw std::runtime_error("sparse image: not a sparse set image");
+        }
+        if (header.byte_order != sparse_image_header::byte_order_mark) {
+            throw std::runtime_error("sparse image: written with a different byte order");
+        }
+        if (header.version != sparse_image_header::current_version) {
+            throw std::runtime_error("sparse image: unsupported version");
+        }
+        if (header.checksum != sparse_image_header_checksum(header)) {
+            throw std::runtime_error("sparse image: header checksum mismatch");
+        }
+        return header;
+    }
+
+    // Appends count elements to out
+    template <class C>
+    auto read_into(C &out, size_t count) -> void {
+        using elem_type = typename C::value_type;
+        static_assert(std::is_trivially_copyable_v<elem_type>);
+
+        if constexpr (std::ranges::contiguous_range<C> && requires { out.resize(count); }) {
+            size_t base = out.size();
+            out.resize(base + count);
+            read(std::ranges::data(out) + base, count * sizeof(elem_type));
+        } else {
+            using elem_bytes = std::array<std::byte, sizeof(elem_type)>;
+            std::vector<elem_bytes> buffer(
+                std::min(count, std::max<size_t>(SPARSE_IMAGE_BUFFER / sizeof(elem_type), 1))
+            );
+            out.reserve(out.size() + count);
+            while (count > 0) {
+                size_t take = std::min(count, buffer.size());
+                read(buffer.data(), take * sizeof(elem_type));
+                for (size_t i = 0; i < take; ++i) {
+                    out.push_back(std::bit_cast<elem_type>(buffer[i]));
+                }
+                count -= take;
+            }
+        }
+    }
+
+    // Reads past size bytes that the loading set has no use for
+    auto skip(size_t size) -> void {
+        std::vector<std::byte> buffer(std::min<size_t>(size, SPARSE_IMAGE_BUFFER));
+        while (size > 0) {
+            size_t take = std::min(size, buffer.size());
+            read(buffer.data(), take);
+            size -= take;
+        }
+    }
+
+    auto finish() -> void {
+        std::uint64_t expected = checksum.value();
+        std::uint64_t value;
+        source.read(&value, sizeof(value));
+        if (value != expected) throw std::runtime_error("sparse image: checksum mismatch");
+    }
+
+private:
+    Source               &source;
+    sparse_image_checksum checksum;
+
+    auto read(void *data, size_t size) -> void {
+        source.read(data, size);
+        checksum.update(data, size);
+    }
+};
+
+#endif
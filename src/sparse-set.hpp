@@ -1,13 +1,21 @@
 #ifndef _SPARSE_SET_HPP
 #define _SPARSE_SET_HPP
 
+#include <array>
 #include <cmath>
 #include <initializer_list>
+#include <limits>
 #include <memory>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 #include "./common.hpp"
+#include "./segmented-vector.hpp"
+#include "./small-vector.hpp"
+#include "./sparse-image.hpp"
 
 #ifndef INIT_SPARSE_SIZE
 #    define INIT_SPARSE_SIZE 32
@@ -18,12 +26,30 @@
 #ifndef SPARSE_SIZE_GROW
 #    define SPARSE_SIZE_GROW 2
 #endif
+#ifndef INCREMENTAL_REHASH_STEP
+#    define INCREMENTAL_REHASH_STEP 0
+#endif
+#ifndef REHASH_THREADS
+#    define REHASH_THREADS 1
+#endif
+#ifndef PARALLEL_REHASH_MIN
+#    define PARALLEL_REHASH_MIN 65536
+#endif
+#ifndef SPARSE_LOOKUP_BATCH
+#    define SPARSE_LOOKUP_BATCH 16
+#endif
+#ifndef SMALL_SET_SIZE
+#    define SMALL_SET_SIZE 8
+#endif
 
 template <
     typename T,
-    typename Hash      = std::hash<T>,
-    typename KeyEqual  = std::equal_to<T>,
-    typename Allocator = std::allocator<T>>
+    typename Hash         = std::hash<T>,
+    typename KeyEqual     = std::equal_to<T>,
+    typename Allocator    = std::allocator<T>,
+    typename SlotPolicy   = fibonacci_slot_policy,
+    bool StoreHash        = false,
+    typename DenseStorage = vector_storage>
 class sparse_set {
 public:
     using key_type       = T;
@@ -31,15 +57,26 @@ public:
     using hasher         = Hash;
     using key_equal      = KeyEqual;
     using allocator_type = Allocator;
+    using slot_policy    = SlotPolicy;
+    using dense_storage  = DenseStorage;
 
-private:
-    using dense_arr_type = std::vector<value_type, allocator_type>;
+    static constexpr bool store_hash = StoreHash;
 
-    struct sparse_arr_entry {
-        size_t pos;
-        size_t dist{0};
-    };
-    using sparse_arr_type = std::vector<
+private:
+    using dense_arr_type = typename dense_storage::template type<value_type, allocator_type>;
+
+    using dense_hash_arr_type = std::conditional_t<
+        store_hash,
+        std::vector<
+            size_t,
+            typename std::allocator_traits<allocator_type>::template rebind_alloc<size_t>>,
+        empty_dense_arr>;
+    using dense_slot_arr_type = std::vector<
+        size_t,
+        typename std::allocator_traits<allocator_type>::template rebind_alloc<size_t>>;
+
+    using sparse_arr_entry = sparse_entry;
+    using sparse_arr_type  = std::vector<
         sparse_arr_entry,
         typename std::allocator_traits<allocator_type>::template rebind_alloc<sparse_arr_entry>>;
 
@@ -50,8 +87,22 @@ public:
     using const_reverse_iterator = typename dense_arr_type::const_reverse_iterator;
 
 public:
-    sparse_set()
-      : dense_arr(), sparse_arr(INIT_SPARSE_SIZE) {}
+    sparse_set() : sparse_set(SMALL_SET_SIZE > 0 ? 0 : INIT_SPARSE_SIZE) {}
+    // A bucket_count of 0 starts without an index: lookups scan the dense array until the set
+    // grows past SMALL_SET_SIZE elements, and only then is the index allocated and built
+    explicit sparse_set(
+        size_t                bucket_count,
+        const hasher         &hash  = hasher(),
+        const key_equal      &equal = key_equal(),
+        const allocator_type &alloc = allocator_type()
+    )
+      : dense_arr(alloc)
+      , dense_hash_arr(alloc)
+      , sparse_arr(bucket_count == 0 ? 0 : slot_policy::valid_size(bucket_count), alloc)
+      , dense_slot_arr(alloc)
+      , old_sparse_arr(alloc)
+      , hash_fn(hash)
+      , equal_fn(equal) {}
     ~sparse_set() = default;
 
     sparse_set(const sparse_set &)                     = default;
@@ -66,6 +117,12 @@ public:
     [[nodiscard]] auto capacity() const -> size_t { return dense_arr.capacity(); }
 
     [[nodiscard]] auto sparse_size() const -> size_t { return sparse_arr.size(); }
+    // False while a small set is still served by scanning, before its index is first built
+    [[nodiscard]] auto indexed() const -> bool { return !sparse_arr.empty(); }
+
+    [[nodiscard]] auto hash_function() const -> hasher { return hash_fn; }
+    [[nodiscard]] auto key_eq() const -> key_equal { return equal_fn; }
+    [[nodiscard]] auto get_allocator() const -> allocator_type { return dense_arr.get_allocator(); }
 
     auto begin() -> iterator { return dense_arr.begin(); }
     auto end() -> iterator { return dense_arr.end(); }
@@ -90,255 +147,1127 @@ public:
     auto insert(std::initializer_list<value_type> ilist) -> void;
 
     auto insert_range(container_compatible_range<value_type> auto &&rg) -> void;
+    // Appends every element without a duplicate check; the caller guarantees the range holds no
+    // value equal to another one or to an element already in the set
+    auto insert_unique_unchecked(container_compatible_range<value_type> auto &&rg) -> void;
 
     template <class... Args>
     auto emplace(Args &&...args) -> std::pair<iterator, bool>;
 
     auto erase(const value_type &value) -> size_t;
+    auto erase(const_iterator pos) -> iterator;
+    auto erase(const_iterator first, const_iterator last) -> iterator;
 
     auto find(const value_type &value) -> iterator;
     auto find(const value_type &value) const -> const_iterator;
     auto count(const value_type &value) const -> size_t;
     auto contains(const value_type &value) const -> bool;
 
+    // Batched lookups that overlap the cache misses of independent probes; out[i] answers
+    // values[i], so out must be at least as long as values
+    auto contains_many(std::span<const value_type> values, std::span<bool> out) const -> void;
+    auto find_many(std::span<const value_type> values, std::span<iterator> out) -> void;
+    auto find_many(std::span<const value_type> values, std::span<const_iterator> out) const -> void;
+
+    // For callers that already hashed value, such as a sharded wrapper picking the shard, so it
+    // is not hashed twice; hash_code must be hash_function()(value)
+    auto insert_hashed(const value_type &value, size_t hash_code) -> std::pair<iterator, bool>;
+    auto insert_hashed(value_type &&value, size_t hash_code) -> std::pair<iterator, bool>;
+    auto erase_hashed(const value_type &value, size_t hash_code) -> size_t;
+    auto contains_hashed(const value_type &value, size_t hash_code) const -> bool;
+
+    // Heterogeneous overloads, enabled when both Hash and KeyEqual declare is_transparent
+    template <class K>
+        requires transparent_lookup<Hash, KeyEqual> && (!std::is_convertible_v<K, const_iterator>)
+    auto erase(const K &value) -> size_t {
+        return erase_by(value);
+    }
+
+    template <class K>
+        requires transparent_lookup<Hash, KeyEqual>
+    auto find(const K &value) -> iterator;
+    template <class K>
+        requires transparent_lookup<Hash, KeyEqual>
+    auto find(const K &value) const -> const_iterator;
+    template <class K>
+        requires transparent_lookup<Hash, KeyEqual>
+    auto count(const K &value) const -> size_t;
+    template <class K>
+        requires transparent_lookup<Hash, KeyEqual>
+    auto contains(const K &value) const -> bool;
+
     auto swap(sparse_set &other) noexcept(
         std::allocator_traits<allocator_type>::is_always_equal::value
         && std::is_nothrow_swappable_v<hasher> && std::is_nothrow_swappable_v<key_equal>
     ) -> void;
 
+    // Builds the index of a small set, except for rehash(0), which leaves it scanning
     auto rehash(size_t new_sparse_size) -> void;
 
+    // Old index slots migrated per mutating operation after a growth; 0 rehashes all at once
+    [[nodiscard]] auto rehash_step() const -> size_t { return migrate_step; }
+    auto rehash_step(size_t step) -> void;
+    [[nodiscard]] auto rehashing() const -> bool { return !old_sparse_arr.empty(); }
+
+    // Threads a full rehash splits the new index across, once size() reaches PARALLEL_REHASH_MIN
+    [[nodiscard]] auto rehash_threads() const -> size_t { return rehash_thread_count; }
+    auto rehash_threads(size_t count) -> void { rehash_thread_count = std::max<size_t>(count, 1); }
+
     auto reserve(size_t count) -> void;
 
+    // Binary image for trivially copyable elements (format in sparse-image.hpp). Loading an image
+    // restores its index as saved once a sample of lookups agrees with this set's hasher and slot
+    // policy; a compact image, a disagreeing one or one saved mid incremental rehash gets its
+    // index rebuilt. load() keeps this set's hasher and allocator and changes nothing if it throws.
+    auto save(std::ostream &os, sparse_image_encoding encoding = sparse_image_encoding::image) const
+        -> void {
+        sparse_stream_sink sink{os};
+        save_to(sink, encoding);
+    }
+    auto load(std::istream &is) -> void {
+        sparse_stream_source source{is};
+        load_from(source);
+    }
+#ifdef SPARSE_IMAGE_FD
+    auto save(int fd, sparse_image_encoding encoding = sparse_image_encoding::image) const -> void {
+        sparse_fd_sink sink{fd};
+        save_to(sink, encoding);
+    }
+    auto load(int fd) -> void {
+        sparse_fd_source source{fd};
+        load_from(source);
+    }
+#endif
+
 private:
-    dense_arr_type  dense_arr;
-    sparse_arr_type sparse_arr;
+    dense_arr_type                            dense_arr;
+    [[no_unique_address]] dense_hash_arr_type dense_hash_arr;
+    sparse_arr_type                           sparse_arr;
+
+    // Slot of each dense element, tagged with the index it lives in (see slot_ref)
+    dense_slot_arr_type dense_slot_arr;
+    bool                slot_parity{false};
+
+    // Index being drained into sparse_arr during an incremental rehash
+    sparse_arr_type old_sparse_arr;
+    size_t          migrate_cursor{0};
+    size_t          migrate_left{0};
+    size_t          migrate_step{INCREMENTAL_REHASH_STEP};
+
+    size_t rehash_thread_count{REHASH_THREADS};
+
+    [[no_unique_address]] hasher    hash_fn;
+    [[no_unique_address]] key_equal equal_fn;
 
 private:
-    auto hash(const value_type &value) const -> size_t { return hasher{}(value) % sparse_size(); }
+    template <class K>
+    auto hash(const K &value) const -> size_t { return hash_fn(value); }
+    auto hash_at(size_t pos) const -> size_t {
+        if constexpr (store_hash) {
+            return dense_hash_arr[pos];
+        } else {
+            return hash(dense_arr[pos]);
+        }
+    }
+    auto sparse_end() const -> size_t { return sparse_size() + old_sparse_arr.size(); }
+    auto entry_at(size_t hashed) -> sparse_arr_entry & {
+        return hashed < sparse_size() ? sparse_arr[hashed] : old_sparse_arr[hashed - sparse_size()];
+    }
+    auto entry_at(size_t hashed) const -> const sparse_arr_entry & {
+        return hashed < sparse_size() ? sparse_arr[hashed] : old_sparse_arr[hashed - sparse_size()];
+    }
 
+    // Low bit matches slot_parity for sparse_arr; start_migration flips the parity, so every
+    // reference taken before it then points into old_sparse_arr without being rewritten.
+    auto slot_ref(const sparse_arr_type &arr, size_t hashed) const -> size_t {
+        bool old = &arr == &old_sparse_arr;
+        return (hashed << 1U) | static_cast<size_t>(old != slot_parity);
+    }
+    auto set_slot_ref(const sparse_arr_type &arr, size_t hashed) -> void {
+        dense_slot_arr[arr[hashed].pos] = slot_ref(arr, hashed);
+    }
+    auto iterator_at(size_t hashed) -> iterator {
+        return begin() + static_cast<std::ptrdiff_t>(entry_at(hashed).pos);
+    }
+    auto slot_of_pos(size_t pos) const -> size_t {
+        size_t ref = dense_slot_arr[pos];
+        bool   old = ((ref & 1U) != 0) != slot_parity;
+        return old ? sparse_size() + (ref >> 1U) : ref >> 1U;
+    }
+
+    static auto index_size_for(size_t count) -> size_t {
+        return slot_policy::valid_size(
+            static_cast<size_t>(static_cast<double>(count) / LOAD_FACTOR) + 1
+        );
+    }
+
+    // Dense position of value, or size() when absent
+    template <class K>
+    auto find_pos(const K &value) const -> size_t;
+    template <class K>
+    auto scan_pos(const K &value) const -> size_t;
+
+    template <class K>
+    auto erase_by(const K &value) -> size_t;
+    template <class K>
+    auto erase_indexed(const K &value, size_t hash_code) -> size_t;
+    auto erase_pos(size_t pos) -> void;
+    auto erase_at(size_t pos, size_t hashed) -> void;
+    auto erase_unindexed(size_t pos) -> void;
+
+    template <class Sink>
+    auto save_to(Sink &sink, sparse_image_encoding encoding) const -> void;
+    template <class Source>
+    auto load_from(Source &source) -> void;
+    // False unless every entry of a loaded index points into the dense array and is the slot
+    // its element points back at; one pass, so a corrupt index is never probed
+    auto index_in_bounds() const -> bool;
+    // False when looking up a spread of elements through a loaded index misses any of them
+    auto index_agrees() const -> bool;
+
+    // Where a probe stopped: the matching slot, or the slot and distance a new entry takes
+    struct sparse_probe {
+        size_t hash_code;
+        size_t hashed;
+        size_t dist;
+        bool   found;
+    };
+
+    template <class A>
+    static constexpr bool emplace_probes_arg =
+        std::is_same_v<std::remove_cvref_t<A>, value_type> ||
+        (transparent_lookup<Hash, KeyEqual> && std::is_invocable_v<const Hash &, const A &> &&
+         std::constructible_from<value_type, A>);
+
+    template <class K>
+    auto emplace_probed(K &&key) -> std::pair<iterator, bool>;
+    template <class K>
+    auto emplace_indexed(K &&key, size_t hash_code) -> std::pair<iterator, bool>;
+
+    template <class K>
+    auto prepare_insert(const K &value, size_t hash_code) -> sparse_probe;
+    auto commit_insert(const sparse_probe &probe) -> void;
+    // First half of commit_insert, popping the just pushed element again if it throws
+    auto push_slot(size_t hash_code) -> void;
+    template <class V>
+    auto append_unchecked(V &&value) -> void;
+    auto start_migration(size_t new_sparse_size) -> void;
+    auto migrate(size_t steps) -> void;
+
+    // Slot indexes past sparse_size() address old_sparse_arr; sparse_end() means not found
     auto insert_sparse_by_pos(size_t pos) -> void;
-    auto find_sparse_by_value(const value_type &value) const -> size_t;
+    auto insert_sparse_parallel() -> void;
+    auto insert_sparse_in_range(size_t hashed, size_t range_end, sparse_arr_entry &entry) -> void;
+    template <class K>
+    auto find_sparse_by_value(const K &value, size_t hash_code) const -> size_t;
     auto remove_sparse_by_hash(size_t hashed) -> void;
+
+    auto insert_sparse_entry(sparse_arr_type &arr, size_t hashed, sparse_arr_entry entry) -> void;
+    template <class K>
+    auto find_sparse_in(const sparse_arr_type &arr, const K &value, size_t hash_code) const
+        -> size_t;
+    template <class K>
+    auto probe_sparse_in(const sparse_arr_type &arr, const K &value, size_t hash_code) const
+        -> sparse_probe;
+    auto remove_sparse_in(sparse_arr_type &arr, size_t hashed) -> void;
+    // Stored distances saturate at max_dist, so two saturated ones are ordered by recounting
+    // the probe distance of element pos at slot hashed from its home slot
+    static auto clamp_dist(size_t dist) -> std::uint32_t {
+        return static_cast<std::uint32_t>(std::min<size_t>(dist, sparse_arr_entry::max_dist));
+    }
+    auto dist_at(size_t pos, size_t hashed, size_t size) const -> size_t;
+    auto displaces(const sparse_arr_type &arr, size_t hashed, const sparse_arr_entry &entry) const
+        -> bool;
+
+    // Calls emit(i, pos) with the dense position of values[i], or size() when it is absent
+    template <class Emit>
+    auto find_many_by(std::span<const value_type> values, Emit &&emit) const -> void;
+    template <class K>
+    auto resume_probe(const sparse_arr_type &arr, const K &value, sparse_probe probe) const
+        -> sparse_probe;
 };
 
-#define _sparse_set_def sparse_set<T, Hash, KeyEqual, Allocator>
+#define _sparse_set_template                                              \
+    template <                                                            \
+        typename T, typename Hash, typename KeyEqual, typename Allocator, \
+        typename SlotPolicy, bool StoreHash, typename DenseStorage>
+#define _sparse_set_def \
+    sparse_set<T, Hash, KeyEqual, Allocator, SlotPolicy, StoreHash, DenseStorage>
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::clear() noexcept -> void {
     dense_arr.clear();
-    std::fill(sparse_arr.begin(), sparse_arr.end(), sparse_arr_entry{.pos = 0, .dist = 0});
+    if constexpr (store_hash) dense_hash_arr.clear();
+    dense_slot_arr.clear();
+    old_sparse_arr = sparse_arr_type(sparse_arr.get_allocator());
+    std::fill(sparse_arr.begin(), sparse_arr.end(), sparse_arr_entry{});
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::insert(const value_type &value) -> std::pair<iterator, bool> {
-    if (!dense_arr.empty() && contains(value)) return {end(), false};
-
-    if (size()
-        >= static_cast<size_t>(std::floor(static_cast<double>(sparse_size()) * LOAD_FACTOR))) {
-        rehash(sparse_size() * SPARSE_SIZE_GROW);
-    }
-
-    dense_arr.push_back(value);
-    insert_sparse_by_pos(size() - 1);
-
-    return {end() - 1, true};
+    return emplace_probed(value);
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::insert(value_type &&value) -> std::pair<iterator, bool> {
-    if (!dense_arr.empty() && contains(value)) return {end(), false};
-
-    if (size()
-        >= static_cast<size_t>(std::floor(static_cast<double>(sparse_size()) * LOAD_FACTOR))) {
-        rehash(sparse_size() * SPARSE_SIZE_GROW);
-    }
-
-    dense_arr.push_back(std::move(value));
-    insert_sparse_by_pos(size() - 1);
-
-    return {end() - 1, true};
+    return emplace_probed(std::move(value));
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 template <class InputIt>
 inline auto _sparse_set_def::insert(InputIt first, InputIt last) -> void {
+    if constexpr (std::forward_iterator<InputIt>) {
+        reserve(size() + static_cast<size_t>(std::distance(first, last)));
+    }
     for (; first != last; ++first) {
         auto &&v = *first;
         (void)insert(std::forward<decltype(v)>(v));
     }
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::insert(std::initializer_list<value_type> ilist) -> void {
     insert(ilist.begin(), ilist.end());
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::insert_range(container_compatible_range<value_type> auto &&rg)
     -> void {
+    if constexpr (std::ranges::sized_range<decltype(rg)>) {
+        reserve(size() + static_cast<size_t>(std::ranges::size(rg)));
+    }
     for (auto &&v : rg) {
         (void)insert(std::forward<decltype(v)>(v));
     }
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
+inline auto _sparse_set_def::insert_unique_unchecked(
+    container_compatible_range<value_type> auto &&rg
+) -> void {
+    if constexpr (std::ranges::sized_range<decltype(rg)>) {
+        reserve(size() + static_cast<size_t>(std::ranges::size(rg)));
+    }
+    migrate(std::numeric_limits<size_t>::max());
+    for (auto &&v : rg) {
+        append_unchecked(std::forward<decltype(v)>(v));
+    }
+}
+
+_sparse_set_template
 template <class... Args>
 inline auto _sparse_set_def::emplace(Args &&...args) -> std::pair<iterator, bool> {
-    value_type value{std::forward<Args>(args)...};
-    if (!dense_arr.empty() && contains(value)) return {end(), false};
+    // A lone argument that is already a value, or that the transparent hasher understands, is
+    // probed as is, so a duplicate costs no construction
+    if constexpr (sizeof...(Args) == 1 && (emplace_probes_arg<Args> && ...)) {
+        return emplace_probed(std::forward<Args>(args)...);
+    } else {
+        value_type value{std::forward<Args>(args)...};
+        return emplace_probed(std::move(value));
+    }
+}
 
-    if (size()
-        >= static_cast<size_t>(std::floor(static_cast<double>(sparse_size()) * LOAD_FACTOR))) {
-        rehash(sparse_size() * SPARSE_SIZE_GROW);
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::emplace_probed(K &&key) -> std::pair<iterator, bool> {
+    if (!indexed()) {
+        size_t pos = scan_pos(key);
+        if (pos < size()) return {begin() + static_cast<std::ptrdiff_t>(pos), false};
+        if (size() < SMALL_SET_SIZE) {
+            dense_arr.emplace_back(std::forward<K>(key));
+            return {end() - 1, true};
+        }
+        rehash(std::max<size_t>(INIT_SPARSE_SIZE, index_size_for(size() + 1)));
     }
+    return emplace_indexed(std::forward<K>(key), hash(key));
+}
 
-    dense_arr.emplace_back(std::move(value));
-    insert_sparse_by_pos(size() - 1);
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::emplace_indexed(K &&key, size_t hash_code)
+    -> std::pair<iterator, bool> {
+    sparse_probe probe = prepare_insert(key, hash_code);
+    if (probe.found) return {iterator_at(probe.hashed), false};
+
+    dense_arr.emplace_back(std::forward<K>(key));
+    commit_insert(probe);
 
     return {end() - 1, true};
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
+inline auto _sparse_set_def::insert_hashed(const value_type &value, size_t hash_code)
+    -> std::pair<iterator, bool> {
+    if (!indexed()) return emplace_probed(value);
+    return emplace_indexed(value, hash_code);
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::insert_hashed(value_type &&value, size_t hash_code)
+    -> std::pair<iterator, bool> {
+    if (!indexed()) return emplace_probed(std::move(value));
+    return emplace_indexed(std::move(value), hash_code);
+}
+
+_sparse_set_template
 inline auto _sparse_set_def::erase(const value_type &value) -> size_t {
-    if (dense_arr.empty() || !contains(value)) return 0;
+    return erase_by(value);
+}
 
-    size_t hashed = find_sparse_by_value(value);
-    if (hashed == sparse_size()) return 0;
+_sparse_set_template
+inline auto _sparse_set_def::erase(const_iterator pos) -> iterator {
+    size_t idx = static_cast<size_t>(pos - cbegin());
+    migrate(migrate_step);
+    erase_pos(idx);
+    return begin() + static_cast<std::ptrdiff_t>(idx);
+}
 
-    size_t pos = sparse_arr[hashed].pos;
+_sparse_set_template
+inline auto _sparse_set_def::erase(const_iterator first, const_iterator last) -> iterator {
+    size_t lo = static_cast<size_t>(first - cbegin());
+    size_t hi = static_cast<size_t>(last - cbegin());
+    migrate(migrate_step);
+    // Erase back to front so each swap-remove only pulls in elements past the range
+    while (hi > lo) {
+        hi--;
+        erase_pos(hi);
+    }
+    return begin() + static_cast<std::ptrdiff_t>(lo);
+}
 
-    if (pos != size() - 1) {
-        size_t back_hashed = find_sparse_by_value(dense_arr.back());
-        if (back_hashed < sparse_size()) {
-            sparse_arr[back_hashed].pos = pos;
-        }
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::erase_by(const K &value) -> size_t {
+    if (!indexed()) {
+        size_t pos = scan_pos(value);
+        if (pos == size()) return 0;
+        erase_unindexed(pos);
+        return 1;
+    }
+    return erase_indexed(value, hash(value));
+}
+
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::erase_indexed(const K &value, size_t hash_code) -> size_t {
+    migrate(migrate_step);
+
+    size_t hashed = find_sparse_by_value(value, hash_code);
+    if (hashed == sparse_end()) return 0;
+
+    erase_at(entry_at(hashed).pos, hashed);
+    return 1;
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::erase_hashed(const value_type &value, size_t hash_code) -> size_t {
+    if (!indexed()) return erase_by(value);
+    return erase_indexed(value, hash_code);
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::contains_hashed(const value_type &value, size_t hash_code) const
+    -> bool {
+    if (!indexed()) return scan_pos(value) < size();
+    return find_sparse_by_value(value, hash_code) < sparse_end();
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::erase_pos(size_t pos) -> void {
+    if (indexed()) {
+        erase_at(pos, slot_of_pos(pos));
+    } else {
+        erase_unindexed(pos);
     }
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::erase_at(size_t pos, size_t hashed) -> void {
+    size_t back = size() - 1;
     remove_sparse_by_hash(hashed);
+    if (pos != back) {
+        entry_at(slot_of_pos(back)).pos = static_cast<typename sparse_arr_entry::pos_type>(pos);
+        dense_slot_arr[pos]             = dense_slot_arr[back];
+    }
 
     dense_arr[pos] = std::move(dense_arr.back());
     dense_arr.pop_back();
+    if constexpr (store_hash) {
+        dense_hash_arr[pos] = dense_hash_arr.back();
+        dense_hash_arr.pop_back();
+    }
+    dense_slot_arr.pop_back();
+}
 
-    return 1;
+_sparse_set_template
+inline auto _sparse_set_def::erase_unindexed(size_t pos) -> void {
+    dense_arr[pos] = std::move(dense_arr.back());
+    dense_arr.pop_back();
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::find(const value_type &value) -> iterator {
-    size_t hashed = find_sparse_by_value(value);
-    if (hashed == sparse_size()) return end();
-    size_t pos = sparse_arr[hashed].pos;
-    return dense_arr.begin() + static_cast<std::ptrdiff_t>(pos);
+    return dense_arr.begin() + static_cast<std::ptrdiff_t>(find_pos(value));
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
+template <class K>
+    requires transparent_lookup<Hash, KeyEqual>
+inline auto _sparse_set_def::find(const K &value) -> iterator {
+    return dense_arr.begin() + static_cast<std::ptrdiff_t>(find_pos(value));
+}
+
+_sparse_set_template
 inline auto _sparse_set_def::find(const value_type &value) const -> const_iterator {
-    size_t hashed = find_sparse_by_value(value);
-    if (hashed == sparse_size()) return end();
-    size_t pos = sparse_arr[hashed].pos;
-    return dense_arr.begin() + static_cast<std::ptrdiff_t>(pos);
+    return dense_arr.begin() + static_cast<std::ptrdiff_t>(find_pos(value));
+}
+
+_sparse_set_template
+template <class K>
+    requires transparent_lookup<Hash, KeyEqual>
+inline auto _sparse_set_def::find(const K &value) const -> const_iterator {
+    return dense_arr.begin() + static_cast<std::ptrdiff_t>(find_pos(value));
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::count(const value_type &value) const -> size_t {
-    size_t hashed = find_sparse_by_value(value);
-    return (hashed < sparse_size() ? 1 : 0);
+    return find_pos(value) < size() ? 1 : 0;
+}
+
+_sparse_set_template
+template <class K>
+    requires transparent_lookup<Hash, KeyEqual>
+inline auto _sparse_set_def::count(const K &value) const -> size_t {
+    return find_pos(value) < size() ? 1 : 0;
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::contains(const value_type &value) const -> bool {
-    size_t hashed = find_sparse_by_value(value);
-    return hashed < sparse_size();
+    return find_pos(value) < size();
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::contains_many(
+    std::span<const value_type> values, std::span<bool> out
+) const -> void {
+    if (out.size() < values.size()) {
+        throw std::invalid_argument("sparse_set: output span is shorter than the input");
+    }
+    find_many_by(values, [&](size_t i, size_t pos) { out[i] = pos < size(); });
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::find_many(
+    std::span<const value_type> values, std::span<iterator> out
+) -> void {
+    if (out.size() < values.size()) {
+        throw std::invalid_argument("sparse_set: output span is shorter than the input");
+    }
+    find_many_by(values, [&](size_t i, size_t pos) {
+        out[i] = begin() + static_cast<std::ptrdiff_t>(pos);
+    });
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::find_many(
+    std::span<const value_type> values, std::span<const_iterator> out
+) const -> void {
+    if (out.size() < values.size()) {
+        throw std::invalid_argument("sparse_set: output span is shorter than the input");
+    }
+    find_many_by(values, [&](size_t i, size_t pos) {
+        out[i] = begin() + static_cast<std::ptrdiff_t>(pos);
+    });
+}
+
+_sparse_set_template
+template <class K>
+    requires transparent_lookup<Hash, KeyEqual>
+inline auto _sparse_set_def::contains(const K &value) const -> bool {
+    return find_pos(value) < size();
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::swap(sparse_set &other) noexcept(
     std::allocator_traits<allocator_type>::is_always_equal::value
     && std::is_nothrow_swappable_v<hasher> && std::is_nothrow_swappable_v<key_equal>
 ) -> void {
     dense_arr.swap(other.dense_arr);
+    if constexpr (store_hash) dense_hash_arr.swap(other.dense_hash_arr);
     sparse_arr.swap(other.sparse_arr);
+    dense_slot_arr.swap(other.dense_slot_arr);
+    std::swap(slot_parity, other.slot_parity);
+    old_sparse_arr.swap(other.old_sparse_arr);
+    std::swap(migrate_cursor, other.migrate_cursor);
+    std::swap(migrate_left, other.migrate_left);
+    std::swap(migrate_step, other.migrate_step);
+    std::swap(rehash_thread_count, other.rehash_thread_count);
+    std::swap(hash_fn, other.hash_fn);
+    std::swap(equal_fn, other.equal_fn);
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::rehash(size_t new_sparse_size) -> void {
-    std::fill(sparse_arr.begin(), sparse_arr.end(), sparse_arr_entry{.pos = 0, .dist = 0});
+    if (!indexed()) {
+        if (new_sparse_size == 0) return;
+        // A small set kept no per-element index data; start it now
+        if constexpr (store_hash) {
+            for (const auto &value : dense_arr) {
+                dense_hash_arr.push_back(hash(value));
+            }
+        }
+        dense_slot_arr.resize(size());
+    }
+
+    new_sparse_size = slot_policy::valid_size(new_sparse_size);
+    old_sparse_arr  = sparse_arr_type(sparse_arr.get_allocator());
+    std::fill(sparse_arr.begin(), sparse_arr.end(), sparse_arr_entry{});
     sparse_arr.resize(new_sparse_size);
-    for (auto idx : std::views::iota(0U, dense_arr.size())) {
-        insert_sparse_by_pos(idx);
+
+    if (rehash_thread_count > 1 && size() >= PARALLEL_REHASH_MIN) {
+        insert_sparse_parallel();
+    } else {
+        for (auto idx : std::views::iota(0U, dense_arr.size())) {
+            insert_sparse_by_pos(idx);
+        }
     }
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
+inline auto _sparse_set_def::rehash_step(size_t step) -> void {
+    migrate_step = step;
+    if (step == 0) migrate(std::numeric_limits<size_t>::max());
+}
+
+_sparse_set_template
 inline auto _sparse_set_def::reserve(size_t count) -> void {
     dense_arr.reserve(count);
-    if (count >= static_cast<size_t>(static_cast<double>(sparse_arr.capacity()) * LOAD_FACTOR)) {
-        sparse_arr.reserve(static_cast<size_t>(static_cast<double>(count) / LOAD_FACTOR));
+    if (!indexed() && count <= SMALL_SET_SIZE) return;
+
+    if constexpr (store_hash) dense_hash_arr.reserve(count);
+    dense_slot_arr.reserve(count);
+    size_t index_size = index_size_for(count);
+    if (index_size > sparse_size()) rehash(index_size);
+}
+
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::prepare_insert(const K &value, size_t hash_code) -> sparse_probe {
+    migrate(migrate_step);
+
+    sparse_probe probe = probe_sparse_in(sparse_arr, value, hash_code);
+    if (probe.found) return probe;
+    if (!old_sparse_arr.empty()) {
+        size_t hashed = find_sparse_in(old_sparse_arr, value, probe.hash_code);
+        if (hashed < old_sparse_arr.size()) {
+            return {probe.hash_code, sparse_size() + hashed, 0, true};
+        }
+    }
+
+    if (size() >= sparse_arr_entry::max_pos) {
+        throw std::length_error("sparse_set: size exceeds the sparse entry position range");
+    }
+
+    if (size()
+        >= static_cast<size_t>(std::floor(static_cast<double>(sparse_size()) * LOAD_FACTOR))) {
+        if (migrate_step == 0) {
+            rehash(sparse_size() * SPARSE_SIZE_GROW);
+        } else {
+            start_migration(sparse_size() * SPARSE_SIZE_GROW);
+        }
+        probe = probe_sparse_in(sparse_arr, value, probe.hash_code);
+    }
+    return probe;
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::commit_insert(const sparse_probe &probe) -> void {
+    push_slot(probe.hash_code);
+
+    sparse_arr_entry entry{
+        .pos         = static_cast<typename sparse_arr_entry::pos_type>(size() - 1),
+        .dist        = clamp_dist(probe.dist),
+        .fingerprint = sparse_fingerprint(probe.hash_code) & sparse_arr_entry::fingerprint_mask,
+    };
+    insert_sparse_entry(sparse_arr, probe.hashed, entry);
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::push_slot([[maybe_unused]] size_t hash_code) -> void {
+    try {
+        if constexpr (store_hash) dense_hash_arr.push_back(hash_code);
+        dense_slot_arr.push_back(0);
+    } catch (...) {
+        if constexpr (store_hash) dense_hash_arr.resize(size() - 1);
+        dense_arr.pop_back();
+        throw;
+    }
+}
+
+_sparse_set_template
+template <class V>
+inline auto _sparse_set_def::append_unchecked(V &&value) -> void {
+    if (!indexed()) {
+        if (size() < SMALL_SET_SIZE) {
+            dense_arr.push_back(std::forward<V>(value));
+            return;
+        }
+        rehash(std::max<size_t>(INIT_SPARSE_SIZE, index_size_for(size() + 1)));
+    }
+    if (size() >= sparse_arr_entry::max_pos) {
+        throw std::length_error("sparse_set: size exceeds the sparse entry position range");
+    }
+    if (size()
+        >= static_cast<size_t>(std::floor(static_cast<double>(sparse_size()) * LOAD_FACTOR))) {
+        rehash(sparse_size() * SPARSE_SIZE_GROW);
+    }
+
+    if constexpr (store_hash) {
+        size_t hash_code = hash(value);
+        dense_arr.push_back(std::forward<V>(value));
+        push_slot(hash_code);
+    } else {
+        dense_arr.push_back(std::forward<V>(value));
+        push_slot(0);
+    }
+    insert_sparse_by_pos(size() - 1);
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::start_migration(size_t new_sparse_size) -> void {
+    migrate(std::numeric_limits<size_t>::max());
+
+    new_sparse_size = slot_policy::valid_size(new_sparse_size);
+    old_sparse_arr  = std::exchange(
+        sparse_arr, sparse_arr_type(new_sparse_size, sparse_arr.get_allocator())
+    );
+    slot_parity    = !slot_parity;
+    migrate_left   = old_sparse_arr.size();
+    migrate_cursor = 0;
+    // Start on an empty slot so no probe chain wraps around behind the cursor
+    while (old_sparse_arr[migrate_cursor].dist != 0) migrate_cursor++;
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::migrate(size_t steps) -> void {
+    // Drain the old index in slot order with backward-shift removal. Every entry whose home slot
+    // is behind the cursor has already moved, so the remainder stays a valid Robin Hood table.
+    for (; steps > 0 && !old_sparse_arr.empty(); --steps) {
+        auto &slot = old_sparse_arr[migrate_cursor];
+        if (slot.dist != 0) {
+            sparse_arr_entry entry = slot;
+            entry.dist             = 1;
+            remove_sparse_in(old_sparse_arr, migrate_cursor);
+
+            size_t hashed = slot_policy::slot(hash_at(entry.pos), sparse_size());
+            insert_sparse_entry(sparse_arr, hashed, entry);
+            continue;
+        }
+
+        migrate_cursor = slot_policy::next(migrate_cursor, old_sparse_arr.size());
+        if (--migrate_left == 0) old_sparse_arr = sparse_arr_type(sparse_arr.get_allocator());
     }
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
+_sparse_set_template
 inline auto _sparse_set_def::insert_sparse_by_pos(size_t pos) -> void {
-    size_t           hashed = hash(dense_arr[pos]);
-    sparse_arr_entry entry{.pos = pos, .dist = 1};
+    size_t           hash_code = hash_at(pos);
+    sparse_arr_entry entry{
+        .pos         = static_cast<typename sparse_arr_entry::pos_type>(pos),
+        .dist        = 1,
+        .fingerprint = sparse_fingerprint(hash_code) & sparse_arr_entry::fingerprint_mask,
+    };
+    insert_sparse_entry(sparse_arr, slot_policy::slot(hash_code, sparse_size()), entry);
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::insert_sparse_parallel() -> void {
+    // Each thread owns one contiguous slot range of the new index and places the entries whose
+    // home slot falls in it. Probing is linear, so an entry can only spill forward: whatever is
+    // still being displaced at the end of a range is carried and finished serially afterwards,
+    // which is just the rest of an ordinary Robin Hood insertion.
+    size_t threads = std::min(rehash_thread_count, sparse_size());
+    size_t span    = (sparse_size() + threads - 1) / threads;
+    size_t ranges  = (sparse_size() + span - 1) / span;
+    size_t chunk   = (size() + threads - 1) / threads;
+
+    // Hash once, then counting-sort positions by range so each thread reads only its own share
+    std::vector<size_t> hash_codes(size());
+    std::vector<size_t> counts(threads * ranges);
+    sparse_parallel_for(threads, [&](size_t thread) {
+        size_t end = std::min(size(), (thread + 1) * chunk);
+        for (size_t pos = thread * chunk; pos < end; ++pos) {
+            hash_codes[pos] = hash_at(pos);
+            counts[thread * ranges + slot_policy::slot(hash_codes[pos], sparse_size()) / span]++;
+        }
+    });
+
+    std::vector<size_t> range_begin(ranges + 1);
+    size_t              offset = 0;
+    for (size_t range = 0; range < ranges; ++range) {
+        range_begin[range] = offset;
+        for (size_t thread = 0; thread < threads; ++thread) {
+            std::swap(counts[thread * ranges + range], offset);
+            offset += counts[thread * ranges + range];
+        }
+    }
+    range_begin[ranges] = offset;
+
+    std::vector<size_t> order(size());
+    sparse_parallel_for(threads, [&](size_t thread) {
+        size_t end = std::min(size(), (thread + 1) * chunk);
+        for (size_t pos = thread * chunk; pos < end; ++pos) {
+            size_t range = slot_policy::slot(hash_codes[pos], sparse_size()) / span;
+            order[counts[thread * ranges + range]++] = pos;
+        }
+    });
+
+    std::vector<std::vector<sparse_arr_entry>> carried(ranges);
+    sparse_parallel_for(ranges, [&](size_t range) {
+        size_t range_end = std::min(sparse_size(), (range + 1) * span);
+        for (size_t idx = range_begin[range]; idx < range_begin[range + 1]; ++idx) {
+            size_t           pos = order[idx];
+            sparse_arr_entry entry{
+                .pos  = static_cast<typename sparse_arr_entry::pos_type>(pos),
+                .dist = 1,
+                .fingerprint
+                = sparse_fingerprint(hash_codes[pos]) & sparse_arr_entry::fingerprint_mask,
+            };
+            size_t hashed = slot_policy::slot(hash_codes[pos], sparse_size());
+            insert_sparse_in_range(hashed, range_end, entry);
+            if (entry.dist != 0) carried[range].push_back(entry);
+        }
+    });
 
+    for (size_t range = 0; range < ranges; ++range) {
+        size_t range_end = std::min(sparse_size(), (range + 1) * span);
+        size_t next      = slot_policy::next(range_end - 1, sparse_size());
+        for (auto entry : carried[range]) {
+            insert_sparse_entry(sparse_arr, next, entry);
+        }
+    }
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::insert_sparse_in_range(
+    size_t hashed, size_t range_end, sparse_arr_entry &entry
+) -> void {
+    // Leaves entry.dist at 0 once placed; otherwise entry is what reached range_end, with the
+    // distance it has at that slot
     while (true) {
         auto &slot = sparse_arr[hashed];
+        if (slot.dist == 0) {
+            slot       = entry;
+            entry.dist = 0;
+            set_slot_ref(sparse_arr, hashed);
+            return;
+        }
+
+        if (displaces(sparse_arr, hashed, entry)) {
+            std::swap(slot, entry);
+            set_slot_ref(sparse_arr, hashed);
+        }
+
+        if (entry.dist < sparse_arr_entry::max_dist) entry.dist++;
+        if (++hashed == range_end) return;
+    }
+    std::unreachable();
+}
+
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::find_pos(const K &value) const -> size_t {
+    if (!indexed()) return scan_pos(value);
+    size_t hashed = find_sparse_by_value(value, hash(value));
+    return hashed == sparse_end() ? size() : entry_at(hashed).pos;
+}
+
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::scan_pos(const K &value) const -> size_t {
+    // At most SMALL_SET_SIZE elements, so comparing every one beats hashing the value
+    size_t pos = 0;
+    while (pos < size() && !equal_fn(dense_arr[pos], value)) ++pos;
+    return pos;
+}
+
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::find_sparse_by_value(const K &value, size_t hash_code) const
+    -> size_t {
+    size_t hashed = find_sparse_in(sparse_arr, value, hash_code);
+    if (hashed < sparse_size() || old_sparse_arr.empty()) return hashed;
+    return sparse_size() + find_sparse_in(old_sparse_arr, value, hash_code);
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::remove_sparse_by_hash(size_t hashed) -> void {
+    if (hashed < sparse_size()) {
+        remove_sparse_in(sparse_arr, hashed);
+    } else {
+        remove_sparse_in(old_sparse_arr, hashed - sparse_size());
+    }
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::insert_sparse_entry(
+    sparse_arr_type &arr, size_t hashed, sparse_arr_entry entry
+) -> void {
+    while (true) {
+        auto &slot = arr[hashed];
         if (slot.dist == 0) {
             slot = entry;
+            set_slot_ref(arr, hashed);
             return;
         }
 
-        if (slot.dist < entry.dist) {
+        if (displaces(arr, hashed, entry)) {
             std::swap(slot, entry);
+            set_slot_ref(arr, hashed);
         }
 
-        entry.dist++;
-        hashed = (hashed + 1) % sparse_size();
+        if (entry.dist < sparse_arr_entry::max_dist) entry.dist++;
+        hashed = slot_policy::next(hashed, arr.size());
     }
     std::unreachable();
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
-inline auto _sparse_set_def::find_sparse_by_value(const value_type &value) const -> size_t {
-    size_t hashed = hash(value);
-    size_t dist   = 1;
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::find_sparse_in(
+    const sparse_arr_type &arr, const K &value, size_t hash_code
+) const -> size_t {
+    sparse_probe probe = probe_sparse_in(arr, value, hash_code);
+    return probe.found ? probe.hashed : arr.size();
+}
+
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::probe_sparse_in(
+    const sparse_arr_type &arr, const K &value, size_t hash_code
+) const -> sparse_probe {
+    sparse_probe probe{hash_code, slot_policy::slot(hash_code, arr.size()), 1, false};
+    return resume_probe(arr, value, probe);
+}
+
+_sparse_set_template
+template <class K>
+inline auto _sparse_set_def::resume_probe(
+    const sparse_arr_type &arr, const K &value, sparse_probe probe
+) const -> sparse_probe {
+    std::uint32_t fingerprint
+        = sparse_fingerprint(probe.hash_code) & sparse_arr_entry::fingerprint_mask;
+    // Raw once up front: with a fancy pointer allocator every arr[] would convert again
+    const sparse_arr_entry *entries     = arr.data();
+    size_t                  entry_count = arr.size();
     while (true) {
-        const auto &slot = sparse_arr[hashed];
-        if (slot.dist == 0 || dist > slot.dist) return sparse_size();
-        if (key_equal{}(dense_arr[slot.pos], value)) return hashed;
-        dist++;
-        hashed = (hashed + 1) % sparse_size();
+        const auto &slot = entries[probe.hashed];
+        if (slot.dist == 0) return probe;
+        if (probe.dist > slot.dist
+            && (slot.dist < sparse_arr_entry::max_dist
+                || probe.dist > dist_at(slot.pos, probe.hashed, entry_count))) {
+            return probe;
+        }
+        if (slot.fingerprint == fingerprint && equal_fn(dense_arr[slot.pos], value)) {
+            probe.found = true;
+            return probe;
+        }
+        probe.dist++;
+        probe.hashed = slot_policy::next(probe.hashed, entry_count);
     }
     std::unreachable();
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
-inline auto _sparse_set_def::remove_sparse_by_hash(size_t hashed) -> void {
+_sparse_set_template
+template <class Emit>
+inline auto _sparse_set_def::find_many_by(
+    std::span<const value_type> values, Emit &&emit
+) const -> void {
+    if (!indexed()) {
+        for (size_t i = 0; i < values.size(); ++i) {
+            emit(i, scan_pos(values[i]));
+        }
+        return;
+    }
+
+    // Hash the whole batch and prefetch every home slot before probing any of them, so the
+    // index misses of the batch overlap instead of each probe stalling on its own
+    std::array<sparse_probe, SPARSE_LOOKUP_BATCH> probes;
+    for (size_t base = 0; base < values.size(); base += SPARSE_LOOKUP_BATCH) {
+        size_t count = std::min<size_t>(SPARSE_LOOKUP_BATCH, values.size() - base);
+
+        for (size_t i = 0; i < count; ++i) {
+            size_t hash_code = hash(values[base + i]);
+            probes[i]        = {hash_code, slot_policy::slot(hash_code, sparse_size()), 1, false};
+            sparse_prefetch(&sparse_arr[probes[i].hashed]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const auto  &value = values[base + i];
+            sparse_probe probe = resume_probe(sparse_arr, value, probes[i]);
+            if (probe.found) {
+                emit(base + i, sparse_arr[probe.hashed].pos);
+            } else if (old_sparse_arr.empty()) {
+                emit(base + i, size());
+            } else {
+                size_t hashed = find_sparse_in(old_sparse_arr, value, probe.hash_code);
+                bool   found  = hashed < old_sparse_arr.size();
+                emit(base + i, found ? old_sparse_arr[hashed].pos : size());
+            }
+        }
+    }
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::remove_sparse_in(sparse_arr_type &arr, size_t hashed) -> void {
     size_t curr = hashed;
 
     while (true) {
-        size_t next      = (curr + 1) % sparse_size();
-        auto  &next_slot = sparse_arr[next];
+        size_t next      = slot_policy::next(curr, arr.size());
+        auto  &next_slot = arr[next];
 
         if (next_slot.dist <= 1) {
-            sparse_arr[curr].dist = 0;
+            arr[curr].dist = 0;
             return;
         }
 
-        sparse_arr[curr] = next_slot;
-        sparse_arr[curr].dist--;
+        arr[curr] = next_slot;
+        if (arr[curr].dist == sparse_arr_entry::max_dist) {
+            arr[curr].dist = clamp_dist(dist_at(arr[curr].pos, curr, arr.size()));
+        } else {
+            arr[curr].dist--;
+        }
+        set_slot_ref(arr, curr);
 
         curr = next;
     }
 }
 
-template <typename T, typename Hash, typename KeyEqual, typename Allocator>
-auto swap(
-    sparse_set<T, Hash, KeyEqual, Allocator> &lhs, sparse_set<T, Hash, KeyEqual, Allocator> &rhs
-) noexcept(noexcept(lhs.swap(rhs))) -> void {
+_sparse_set_template
+inline auto _sparse_set_def::dist_at(size_t pos, size_t hashed, size_t size) const -> size_t {
+    size_t home = slot_policy::slot(hash_at(pos), size);
+    return (hashed + size - home) % size + 1;
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::displaces(
+    const sparse_arr_type &arr, size_t hashed, const sparse_arr_entry &entry
+) const -> bool {
+    const auto &slot = arr[hashed];
+    if (slot.dist != entry.dist || slot.dist < sparse_arr_entry::max_dist) {
+        return slot.dist < entry.dist;
+    }
+    return dist_at(slot.pos, hashed, arr.size()) < dist_at(entry.pos, hashed, arr.size());
+}
+
+_sparse_set_template
+template <class Sink>
+inline auto _sparse_set_def::save_to(Sink &sink, sparse_image_encoding encoding) const -> void {
+    static_assert(
+        std::is_trivially_copyable_v<value_type>,
+        "sparse_set images need trivially copyable elements"
+    );
+
+    // Mid-rehash slot references span two index tables; the elements alone rebuild it just fine
+    bool compact = encoding == sparse_image_encoding::compact || rehashing() || !indexed();
+
+    sparse_image_header header;
+    header.flags      = compact ? sparse_image_header::compact : 0;
+    header.value_size = static_cast<std::uint32_t>(sizeof(value_type));
+    header.entry_size = static_cast<std::uint32_t>(sizeof(sparse_arr_entry));
+    header.count      = size();
+    if (!compact) {
+        if constexpr (store_hash) header.flags |= sparse_image_header::stored_hash;
+        header.sparse_size = sparse_size();
+        header.slot_parity = slot_parity ? 1 : 0;
+    }
+
+    sparse_image_writer<Sink> writer(sink);
+    writer.write_header(header);
+    writer.write_range(dense_arr);
+    if (!compact) {
+        if constexpr (store_hash) writer.write_range(dense_hash_arr);
+        writer.write_range(dense_slot_arr);
+        writer.write_range(sparse_arr);
+    }
+    writer.finish();
+}
+
+_sparse_set_template
+template <class Source>
+inline auto _sparse_set_def::load_from(Source &source) -> void {
+    static_assert(
+        std::is_trivially_copyable_v<value_type>,
+        "sparse_set images need trivially copyable elements"
+    );
+
+    sparse_image_reader<Source> reader(source);
+    sparse_image_header         header = reader.read_header();
+    header.expect_layout(0, sizeof(value_type));
+
+    auto count       = static_cast<size_t>(header.count);
+    auto image_size  = static_cast<size_t>(header.sparse_size);
+    bool with_hashes = header.has(sparse_image_header::stored_hash);
+
+    sparse_set loaded(0, hash_fn, equal_fn, get_allocator());
+    loaded.migrate_step        = migrate_step;
+    loaded.rehash_thread_count = rehash_thread_count;
+    reader.read_into(loaded.dense_arr, count);
+
+    if (!header.has(sparse_image_header::compact)) {
+        // An index saved with another entry layout or hash mode is read past and rebuilt
+        bool usable = with_hashes == store_hash && header.entry_size == sizeof(sparse_arr_entry)
+                      && header.word_size == sizeof(size_t) && image_size > 0
+                      && slot_policy::valid_size(image_size) == image_size;
+        if (usable) {
+            if constexpr (store_hash) reader.read_into(loaded.dense_hash_arr, count);
+            reader.read_into(loaded.dense_slot_arr, count);
+            reader.read_into(loaded.sparse_arr, image_size);
+            loaded.slot_parity = header.slot_parity != 0;
+        } else {
+            size_t words = with_hashes ? 2 * count : count;
+            reader.skip(words * header.word_size + image_size * header.entry_size);
+        }
+    }
+    reader.finish();
+
+    if (loaded.indexed() && !(loaded.index_in_bounds() && loaded.index_agrees())) {
+        loaded.sparse_arr.clear();
+        loaded.dense_slot_arr.clear();
+        if constexpr (store_hash) loaded.dense_hash_arr.clear();
+    }
+    if (!loaded.indexed()) loaded.reserve(count);
+    *this = std::move(loaded);
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::index_in_bounds() const -> bool {
+    if (dense_slot_arr.size() != size() || sparse_size() <= size()) return false;
+    size_t entries = 0;
+    for (size_t hashed = 0; hashed < sparse_size(); ++hashed) {
+        const auto &entry = sparse_arr[hashed];
+        if (entry.dist == 0) continue;
+        if (entry.dist > sparse_size() || entry.pos >= size()) return false;
+        if (dense_slot_arr[entry.pos] != slot_ref(sparse_arr, hashed)) return false;
+        entries++;
+    }
+    return entries == size();
+}
+
+_sparse_set_template
+inline auto _sparse_set_def::index_agrees() const -> bool {
+    size_t step = std::max<size_t>(size() / 16, 1);
+    for (size_t pos = 0; pos < size(); pos += step) {
+        if (find_pos(dense_arr[pos]) != pos) return false;
+    }
+    return true;
+}
+
+_sparse_set_template
+auto swap(_sparse_set_def &lhs, _sparse_set_def &rhs) noexcept(noexcept(lhs.swap(rhs))) -> void {
     lhs.swap(rhs);
 }
 
+#undef _sparse_set_template
 #undef _sparse_set_def
 
 #endif
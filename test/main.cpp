@@ -2,11 +2,31 @@
 // (wtf it is so long)
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <memory_resource>
 #include <numeric>
+#include <set>
+#include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_set>
 
+#include <sys/wait.h>
+
+#include "concurrent-sparse-set.hpp"
+#include "direct-sparse-set.hpp"
+#include "handle-key-set.hpp"
+#include "lockfree-sparse-set.hpp"
+#include "mapped-arena.hpp"
+#include "shared-sparse-set.hpp"
+#include "snapshot-sparse-set.hpp"
+#include "sparse-group-set.hpp"
 #include "sparse-key-set.hpp"
 #include "sparse-set.hpp"
 
@@ -141,9 +161,22 @@ TEST_F(SparseSetTest, InsertDuplicate) {
 
     EXPECT_TRUE(ins1);
     EXPECT_FALSE(ins2);
+    EXPECT_EQ(it2, it1);
     EXPECT_EQ(int_set.size(), 1);
 }
 
+TEST_F(SparseSetTest, InsertDuplicateReturnsExisting) {
+    for (int i = 0; i < 100; ++i) {
+        int_set.insert(i);
+    }
+    for (int i = 0; i < 100; ++i) {
+        auto [it, inserted] = int_set.insert(i);
+        EXPECT_FALSE(inserted);
+        ASSERT_NE(it, int_set.end());
+        EXPECT_EQ(*it, i);
+    }
+}
+
 TEST_F(SparseSetTest, InsertRvalue) {
     auto [it, inserted] = int_set.insert(std::move(42));
     EXPECT_TRUE(inserted);
@@ -256,6 +289,7 @@ TEST_F(SparseSetTest, EmplaceDuplicate) {
     int_set.emplace(10);
     auto [it, inserted] = int_set.emplace(10);
     EXPECT_FALSE(inserted);
+    EXPECT_EQ(*it, 10);
     EXPECT_EQ(int_set.size(), 1);
 }
 
@@ -344,6 +378,42 @@ TEST_F(SparseSetTest, EraseMiddleElement) {
     EXPECT_TRUE(int_set.contains(3));
 }
 
+TEST_F(SparseSetTest, EraseIterator) {
+    for (int i = 0; i < 100; ++i) {
+        int_set.insert(i);
+    }
+
+    // The back element is swapped into the hole, so the returned iterator points at it
+    auto it = int_set.erase(int_set.find(10));
+    EXPECT_EQ(*it, 99);
+    EXPECT_FALSE(int_set.contains(10));
+
+    it = int_set.erase(int_set.end() - 1);
+    EXPECT_EQ(it, int_set.end());
+    EXPECT_EQ(int_set.size(), 98);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(int_set.contains(i), i != 10 && i != 98);
+    }
+}
+
+TEST_F(SparseSetTest, EraseRange) {
+    for (int i = 0; i < 100; ++i) {
+        int_set.insert(i);
+    }
+
+    auto it = int_set.erase(int_set.begin() + 20, int_set.begin() + 50);
+    EXPECT_EQ(it, int_set.begin() + 20);
+    EXPECT_EQ(int_set.size(), 70);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(int_set.contains(i), i < 20 || i >= 50);
+    }
+
+    int_set.erase(int_set.begin(), int_set.end());
+    EXPECT_TRUE(int_set.empty());
+    int_set.insert(7);
+    EXPECT_TRUE(int_set.contains(7));
+}
+
 // ============================================================================
 // Contains and Count Tests
 // ============================================================================
@@ -927,6 +997,49 @@ TEST_F(SparseSetTest, ReserveCapacity) {
     }
 }
 
+TEST_F(SparseSetTest, ReserveSizesIndexOnce) {
+    int_set.reserve(1000);
+    size_t reserved = int_set.sparse_size();
+
+    for (int i = 0; i < 1000; ++i) {
+        int_set.insert(i);
+    }
+    EXPECT_EQ(int_set.sparse_size(), reserved);
+}
+
+TEST_F(SparseSetTest, BulkInsertDeduplicates) {
+    std::vector<int> values;
+    for (int i = 0; i < 2000; ++i) {
+        values.push_back(i % 1500);
+    }
+    int_set.insert(0);
+    int_set.insert(values.begin(), values.end());
+    EXPECT_EQ(int_set.size(), 1500);
+
+    int_set.insert_range(values);
+    EXPECT_EQ(int_set.size(), 1500);
+    for (int i = 0; i < 1500; ++i) {
+        EXPECT_TRUE(int_set.contains(i));
+    }
+}
+
+TEST_F(SparseSetTest, InsertUniqueUnchecked) {
+    int_set.insert(-1);
+    std::vector<int> values;
+    for (int i = 0; i < 5000; ++i) {
+        values.push_back(i);
+    }
+    int_set.insert_unique_unchecked(values);
+
+    EXPECT_EQ(int_set.size(), 5001);
+    for (int i = -1; i < 5000; ++i) {
+        EXPECT_TRUE(int_set.contains(i));
+    }
+    EXPECT_FALSE(int_set.insert(42).second);
+    EXPECT_EQ(int_set.erase(42), 1);
+    EXPECT_FALSE(int_set.contains(42));
+}
+
 // ============================================================================
 // Robin Hood Hashing Collision Tests
 // ============================================================================
@@ -956,202 +1069,1849 @@ TEST_F(SparseSetTest, CollisionWithErase) {
     EXPECT_TRUE(int_set.contains(192));
 }
 
-// ============================================================================
-// Stress Tests
-// ============================================================================
+struct ConstantHash {
+    size_t operator()(int) const { return 7; }
+};
 
-TEST_F(SparseSetTest, LargeNumberOfInserts) {
-    const int N = 10000;
-    for (int i = 0; i < N; ++i) {
-        int_set.insert(i);
+TEST(SparseSetCompactEntryTest, LongProbeChains) {
+    sparse_set<int, ConstantHash> set;
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_TRUE(set.insert(i).second);
+    }
+    for (int i = 0; i < 200; i += 2) {
+        EXPECT_EQ(set.erase(i), 1);
     }
 
-    EXPECT_EQ(int_set.size(), N);
+    EXPECT_EQ(set.size(), 100);
+    for (int i = 0; i < 200; ++i) {
+        EXPECT_EQ(set.contains(i), i % 2 == 1);
+    }
+}
 
-    for (int i = 0; i < N; ++i) {
-        EXPECT_TRUE(int_set.contains(i));
+TEST(SparseSetCompactEntryTest, ProbesPastMaxDist) {
+    // Every key collides, so most probe distances saturate in the compact entry
+    sparse_set<int, ConstantHash> set;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(set.insert(i).second);
+    }
+    EXPECT_FALSE(set.insert(500).second);
+    EXPECT_EQ(set.size(), 1000);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(set.contains(i));
+    }
+
+    for (int i = 0; i < 1000; i += 3) {
+        EXPECT_EQ(set.erase(i), 1);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(set.contains(i), i % 3 != 0);
+    }
+
+    sparse_key_set<int, int, ConstantHash> map;
+    for (int i = 0; i < 1000; ++i) {
+        map.insert(i, i * 2);
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        EXPECT_EQ(map.erase(i), 1);
+    }
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(map.contains(i), i % 3 != 0);
     }
+    EXPECT_EQ(map.at(998), 1996);
 }
 
-TEST_F(SparseSetTest, InterleavedInsertAndErase) {
+struct CountingEqual {
+    static inline size_t calls = 0;
+
+    bool operator()(const std::string &lhs, const std::string &rhs) const {
+        ++calls;
+        return lhs == rhs;
+    }
+};
+
+TEST(SparseSetFingerprintTest, MissesSkipKeyCompare) {
+    sparse_set<std::string, std::hash<std::string>, CountingEqual> set;
+    for (int i = 0; i < 1000; ++i) {
+        set.insert("key-" + std::to_string(i));
+    }
+
+    CountingEqual::calls = 0;
+    for (int i = 1000; i < 2000; ++i) {
+        EXPECT_FALSE(set.contains("key-" + std::to_string(i)));
+    }
+    EXPECT_LT(CountingEqual::calls, 10);
+
+    CountingEqual::calls = 0;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(set.contains("key-" + std::to_string(i)));
+    }
+    EXPECT_LT(CountingEqual::calls, 1010);
+}
+
+TEST(SparseSetFingerprintTest, KeySetMissesSkipKeyCompare) {
+    sparse_key_set<std::string, int, std::hash<std::string>, CountingEqual> map;
+    for (int i = 0; i < 1000; ++i) {
+        map.insert("key-" + std::to_string(i), i);
+    }
+
+    CountingEqual::calls = 0;
+    for (int i = 1000; i < 2000; ++i) {
+        EXPECT_EQ(map.find("key-" + std::to_string(i)), map.end());
+    }
+    EXPECT_LT(CountingEqual::calls, 10);
+}
+
+struct CountingHash {
+    static inline size_t calls = 0;
+
+    size_t operator()(const std::string &value) const {
+        ++calls;
+        return std::hash<std::string>{}(value);
+    }
+};
+
+TEST(SparseSetStoredHashTest, RehashAndEraseReuseStoredHash) {
+    sparse_set<
+        std::string,
+        CountingHash,
+        std::equal_to<std::string>,
+        std::allocator<std::string>,
+        fibonacci_slot_policy,
+        true>
+        set;
     for (int i = 0; i < 100; ++i) {
-        int_set.insert(i);
+        set.insert(std::to_string(i));
     }
 
+    CountingHash::calls = 0;
+    set.rehash(set.sparse_size() * 4);
+    EXPECT_EQ(CountingHash::calls, 0);
+
     for (int i = 0; i < 100; i += 2) {
-        int_set.erase(i);
+        EXPECT_EQ(set.erase(std::to_string(i)), 1);
     }
+    EXPECT_LE(CountingHash::calls, 100);
 
-    EXPECT_EQ(int_set.size(), 50);
-
+    CountingHash::calls = 0;
+    set.rehash(set.sparse_size() * 2);
+    EXPECT_EQ(CountingHash::calls, 0);
     for (int i = 0; i < 100; ++i) {
-        if (i % 2 == 0) {
-            EXPECT_FALSE(int_set.contains(i));
-        } else {
-            EXPECT_TRUE(int_set.contains(i));
-        }
+        EXPECT_EQ(set.contains(std::to_string(i)), i % 2 == 1);
     }
 }
 
-TEST_F(SparseSetTest, RandomOperations) {
-    std::unordered_set<int> reference;
+TEST(SparseKeySetStoredHashTest, RehashAndEraseReuseStoredHash) {
+    sparse_key_set<
+        std::string,
+        int,
+        CountingHash,
+        std::equal_to<std::string>,
+        std::allocator<int>,
+        fibonacci_slot_policy,
+        true>
+        map;
+    for (int i = 0; i < 100; ++i) {
+        map.insert(std::to_string(i), i);
+    }
 
-    for (int i = 0; i < 1000; ++i) {
-        int val = i % 200;
+    CountingHash::calls = 0;
+    map.rehash(map.sparse_size() * 4);
+    EXPECT_EQ(CountingHash::calls, 0);
 
+    for (int i = 0; i < 100; i += 3) {
+        EXPECT_EQ(map.erase(std::to_string(i)), 1);
+    }
+    map.rehash(map.sparse_size() * 2);
+
+    for (int i = 0; i < 100; ++i) {
         if (i % 3 == 0) {
-            auto [it, sparse_result] = int_set.insert(val);
-            bool ref_result          = reference.insert(val).second;
-            EXPECT_EQ(sparse_result, ref_result);
-        } else if (i % 3 == 1) {
-            EXPECT_EQ(int_set.contains(val), reference.count(val) > 0);
+            EXPECT_FALSE(map.contains(std::to_string(i)));
         } else {
-            size_t sparse_result = int_set.erase(val);
-            size_t ref_result    = reference.erase(val);
-            EXPECT_EQ(sparse_result, ref_result);
+            EXPECT_EQ(map.at(std::to_string(i)), i);
         }
     }
-
-    EXPECT_EQ(int_set.size(), reference.size());
 }
 
 // ============================================================================
-// Edge Cases
+// Incremental Rehash Tests
 // ============================================================================
 
-TEST_F(SparseSetTest, InsertEraseInsertSameValue) {
-    int_set.insert(42);
-    int_set.erase(42);
-    auto [it, inserted] = int_set.insert(42);
+TEST(SparseSetIncrementalRehashTest, LookupsSpanBothTables) {
+    sparse_set<int> set;
+    set.rehash_step(1);
+    EXPECT_EQ(set.rehash_step(), 1);
 
-    EXPECT_TRUE(inserted);
-    EXPECT_TRUE(int_set.contains(42));
-    EXPECT_EQ(int_set.size(), 1);
-}
+    int n = 0;
+    while (!set.rehashing()) {
+        set.insert(n++);
+    }
+    for (int i = 0; i < n; ++i) {
+        EXPECT_TRUE(set.contains(i));
+    }
+    EXPECT_FALSE(set.contains(n));
 
-TEST_F(SparseSetTest, MultipleErasesOfSameValue) {
-    int_set.insert(42);
-    EXPECT_EQ(int_set.erase(42), 1);
-    EXPECT_EQ(int_set.erase(42), 0);
-    EXPECT_EQ(int_set.erase(42), 0);
+    // Erasing while the old index drains must fix up positions in either table
+    for (int i = 0; i < n; i += 2) {
+        EXPECT_EQ(set.erase(i), 1);
+    }
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(set.contains(i), i % 2 == 1);
+    }
 }
 
-TEST_F(SparseSetTest, EmptyAfterClearingAllElements) {
-    for (int i = 0; i < 10; ++i) {
-        int_set.insert(i);
+TEST(SparseSetIncrementalRehashTest, MatchesStopTheWorld) {
+    sparse_set<int> incremental;
+    sparse_set<int> eager;
+    incremental.rehash_step(2);
+
+    for (int i = 0; i < 5000; ++i) {
+        incremental.insert(i * 7);
+        eager.insert(i * 7);
+        if (i % 3 == 0) {
+            incremental.erase(i * 7 / 2);
+            eager.erase(i * 7 / 2);
+        }
+    }
+    ASSERT_EQ(incremental.size(), eager.size());
+    EXPECT_TRUE(std::equal(incremental.begin(), incremental.end(), eager.begin()));
+    for (int i = 0; i < 5000 * 7; ++i) {
+        EXPECT_EQ(incremental.contains(i), eager.contains(i));
     }
 
-    for (int i = 0; i < 10; ++i) {
-        int_set.erase(i);
+    incremental.rehash_step(0);
+    EXPECT_FALSE(incremental.rehashing());
+    EXPECT_EQ(incremental.size(), eager.size());
+}
+
+TEST(SparseSetIncrementalRehashTest, ClearSwapAndRehashDropOldIndex) {
+    sparse_set<int> set;
+    set.rehash_step(1);
+    int n = 0;
+    while (!set.rehashing()) {
+        set.insert(n++);
     }
 
-    EXPECT_EQ(int_set.size(), 0);
-    EXPECT_TRUE(int_set.empty());
+    sparse_set<int> other;
+    swap(set, other);
+    EXPECT_TRUE(other.rehashing());
+    EXPECT_TRUE(other.contains(n - 1));
+    EXPECT_EQ(other.rehash_step(), 1);
 
-    for (int i = 0; i < 10; ++i) {
-        EXPECT_FALSE(int_set.contains(i));
+    other.rehash(other.sparse_size());
+    EXPECT_FALSE(other.rehashing());
+    EXPECT_TRUE(other.contains(0));
+
+    while (!other.rehashing()) {
+        other.insert(n++);
     }
+    other.clear();
+    EXPECT_FALSE(other.rehashing());
+    EXPECT_FALSE(other.contains(0));
 }
 
-TEST_F(SparseSetTest, InsertAfterClear) {
-    int_set.insert(1);
-    int_set.insert(2);
-    int_set.clear();
-    int_set.insert(3);
+TEST(SparseKeySetIncrementalRehashTest, AccessDuringMigration) {
+    sparse_key_set<std::string, int> map;
+    map.rehash_step(1);
 
-    EXPECT_EQ(int_set.size(), 1);
-    EXPECT_TRUE(int_set.contains(3));
-    EXPECT_FALSE(int_set.contains(1));
-    EXPECT_FALSE(int_set.contains(2));
+    int n = 0;
+    while (!map.rehashing()) {
+        map.insert(std::to_string(n), n);
+        n++;
+    }
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(map.at(std::to_string(i)), i);
+    }
+    map["fresh"] = -1;
+    EXPECT_EQ(map.erase(std::to_string(0)), 1);
+
+    while (map.rehashing()) {
+        map.erase("missing");
+    }
+    EXPECT_EQ(map.at("fresh"), -1);
+    EXPECT_FALSE(map.contains(std::to_string(0)));
+    for (int i = 1; i < n; ++i) {
+        EXPECT_EQ(map[std::to_string(i)], i);
+    }
 }
 
 // ============================================================================
-// Custom Types Tests
+// Parallel Rehash Tests
 // ============================================================================
 
-struct CustomType {
-    int         x;
-    std::string s;
-
-    bool operator==(const CustomType &other) const { return x == other.x && s == other.s; }
+// Three keys share each home slot, so displacement chains run across every range boundary
+struct TripleHash {
+    auto operator()(int v) const -> size_t { return static_cast<size_t>(v / 3 * 3 + 2); }
 };
 
-template <>
-struct std::hash<CustomType> {
-    size_t operator()(const CustomType &ct) const {
-        return std::hash<int>{}(ct.x) ^ std::hash<std::string>{}(ct.s);
+TEST(SparseSetParallelRehashTest, ChainsCrossRangeBoundaries) {
+    sparse_set<int, TripleHash, std::equal_to<int>, std::allocator<int>, mask_slot_policy> set;
+    set.rehash_threads(4);
+    EXPECT_EQ(set.rehash_threads(), 4);
+
+    const int n = PARALLEL_REHASH_MIN * 2;
+    for (int i = 0; i < n; ++i) {
+        set.insert(i);
     }
-};
+    set.rehash(set.sparse_size() * 2);
 
-TEST(SparseSetCustomTypeTest, CustomTypeOperations) {
-    sparse_set<CustomType> custom_set;
+    EXPECT_EQ(set.size(), static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) {
+        ASSERT_TRUE(set.contains(i));
+    }
+    EXPECT_FALSE(set.contains(n));
 
-    CustomType obj1{42, "hello"};
-    CustomType obj2{99, "world"};
-    CustomType obj3{42, "hello"}; // Same as obj1
+    // Erase relies on the back-references the parallel placement recorded
+    for (int i = 0; i < n; i += 2) {
+        EXPECT_EQ(set.erase(i), 1);
+    }
+    for (int i = 0; i < n; ++i) {
+        EXPECT_EQ(set.contains(i), i % 2 == 1);
+    }
+}
 
-    auto [it1, ins1] = custom_set.insert(obj1);
-    auto [it2, ins2] = custom_set.insert(obj2);
-    auto [it3, ins3] = custom_set.insert(obj3);
+TEST(SparseKeySetParallelRehashTest, MatchesSerial) {
+    sparse_key_set<int, int> parallel;
+    sparse_key_set<int, int> serial;
+    parallel.rehash_threads(3);
 
-    EXPECT_TRUE(ins1 && ins2);
-    EXPECT_FALSE(ins3);
+    for (int i = 0; i < PARALLEL_REHASH_MIN * 3; ++i) {
+        parallel.insert(i * 7, i);
+        serial.insert(i * 7, i);
+    }
+    parallel.rehash(parallel.sparse_size() * 4);
 
-    EXPECT_EQ(custom_set.size(), 2);
-    EXPECT_TRUE(custom_set.contains(obj1));
-    EXPECT_TRUE(custom_set.contains(obj2));
-    EXPECT_TRUE(custom_set.contains(obj3));
+    ASSERT_EQ(parallel.size(), serial.size());
+    for (int i = 0; i < PARALLEL_REHASH_MIN * 3; ++i) {
+        ASSERT_EQ(parallel.at(i * 7), serial.at(i * 7));
+    }
+    for (int i = 0; i < PARALLEL_REHASH_MIN * 3; i += 3) {
+        EXPECT_EQ(parallel.erase(i * 7), 1);
+    }
+    EXPECT_EQ(parallel.size(), static_cast<size_t>(PARALLEL_REHASH_MIN * 2));
 
-    EXPECT_EQ(custom_set.erase(obj1), 1);
-    EXPECT_FALSE(custom_set.contains(obj1));
-    EXPECT_EQ(custom_set.size(), 1);
+    // The setting travels with the contents
+    parallel.swap(serial);
+    EXPECT_EQ(parallel.rehash_threads(), REHASH_THREADS);
+    EXPECT_EQ(serial.rehash_threads(), 3);
 }
 
-TEST(SparseSetCustomTypeTest, CustomTypeIteration) {
-    sparse_set<CustomType> custom_set;
-
-    custom_set.insert({1, "a"});
-    custom_set.insert({2, "b"});
-    custom_set.insert({3, "c"});
-
-    std::vector<CustomType> values;
-    for (const auto &obj : custom_set) {
-        values.push_back(obj);
-    }
+TEST(SparseSetParallelRehashTest, SwapExchangesThreadCount) {
+    sparse_set<int> a;
+    sparse_set<int> b;
+    a.rehash_threads(4);
+    a.insert(1);
 
-    EXPECT_EQ(values.size(), 3);
+    swap(a, b);
+    EXPECT_EQ(a.rehash_threads(), REHASH_THREADS);
+    EXPECT_EQ(b.rehash_threads(), 4);
+    EXPECT_TRUE(b.contains(1));
 }
 
-TEST(SparseSetCustomTypeTest, CustomTypeFind) {
-    sparse_set<CustomType> custom_set;
+// ============================================================================
+// Snapshot Set Tests
+// ============================================================================
 
-    CustomType obj1{10, "test"};
-    CustomType obj2{20, "data"};
+TEST(SnapshotSparseSetTest, ReadersSeeOnlyPublishedVersions) {
+    snapshot_sparse_set<int> set;
+    auto                     reader = set.make_reader();
 
-    custom_set.insert(obj1);
-    custom_set.insert(obj2);
+    EXPECT_TRUE(set.insert(1));
+    EXPECT_FALSE(set.insert(1));
+    EXPECT_FALSE(reader.contains(1));
 
-    auto it = custom_set.find(obj1);
-    EXPECT_NE(it, custom_set.end());
-    EXPECT_EQ(it->x, 10);
-    EXPECT_EQ(it->s, "test");
+    set.publish();
+    EXPECT_TRUE(reader.contains(1));
 
-    CustomType obj3{99, "missing"};
-    auto       it2 = custom_set.find(obj3);
-    EXPECT_EQ(it2, custom_set.end());
+    EXPECT_EQ(set.erase(1), 1);
+    set.update([](auto &staged) { staged.insert_range(std::vector<int>{2, 3}); });
+    EXPECT_TRUE(reader.contains(1));
+    set.publish();
+    EXPECT_FALSE(reader.contains(1));
+    EXPECT_EQ(reader.size(), 2);
 }
 
-// ============================================================================
-// Performance Characteristics Tests
-// ============================================================================
+TEST(SnapshotSparseSetTest, PinnedVersionOutlivesPublish) {
+    sparse_set<int> initial;
+    initial.insert({1, 2, 3});
+    snapshot_sparse_set<int> set(std::move(initial));
+    auto                     reader = set.make_reader();
 
-TEST_F(SparseSetTest, DensePackingProperty) {
-    // Insert elements
-    for (int i = 0; i < 10; ++i) {
-        int_set.insert(i);
+    {
+        auto pinned = reader.pin();
+        set.clear();
+        set.publish();
+        set.publish();
+
+        EXPECT_EQ(pinned->size(), 3);
+        EXPECT_TRUE(pinned->contains(2));
+        EXPECT_EQ(set.pending_reclaim(), 2);
     }
 
-    // Erase some elements
+    set.reclaim();
+    EXPECT_EQ(set.pending_reclaim(), 0);
+    EXPECT_EQ(reader.size(), 0);
+}
+
+TEST(SnapshotSparseSetTest, ShortcutsKeepOuterGuardPinned) {
+    sparse_set<int> initial;
+    initial.insert({1, 2, 3});
+    snapshot_sparse_set<int> set(std::move(initial));
+    auto                     reader = set.make_reader();
+
+    {
+        auto pinned = reader.pin();
+        set.insert(4);
+        set.publish();
+
+        // Nested under pinned, so they must not unpin the version it holds
+        EXPECT_TRUE(reader.contains(4));
+        EXPECT_EQ(reader.size(), 4);
+        {
+            auto nested = reader.pin();
+            EXPECT_TRUE(nested->contains(4));
+        }
+
+        set.clear();
+        set.publish();
+        EXPECT_EQ(set.pending_reclaim(), 2);
+        EXPECT_EQ(pinned->size(), 3);
+        EXPECT_FALSE(pinned->contains(4));
+    }
+
+    set.reclaim();
+    EXPECT_EQ(set.pending_reclaim(), 0);
+    EXPECT_EQ(reader.size(), 0);
+}
+
+TEST(SnapshotSparseSetTest, ReaderSlotsAreRecycled) {
+    snapshot_sparse_set<int> set;
+    std::vector<snapshot_sparse_set<int>::reader> readers;
+    for (int i = 0; i < SNAPSHOT_MAX_READERS; ++i) {
+        readers.push_back(set.make_reader());
+    }
+    EXPECT_THROW((void)set.make_reader(), std::length_error);
+
+    readers.pop_back();
+    EXPECT_NO_THROW((void)set.make_reader());
+}
+
+TEST(SnapshotSparseSetTest, ConcurrentReadersAndWriter) {
+    snapshot_sparse_set<int> set;
+    std::atomic<bool>        done{false};
+    std::atomic<int>         torn{0};
+
+    // Every published version holds a contiguous prefix 0..n-1, so a reader that finds n - 1
+    // must also find 0
+    std::vector<std::jthread> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.emplace_back([&] {
+            auto reader = set.make_reader();
+            while (!done.load()) {
+                auto   pinned = reader.pin();
+                size_t n      = pinned->size();
+                if (n > 0 && !(pinned->contains(static_cast<int>(n) - 1) && pinned->contains(0))) {
+                    torn++;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+        set.insert(i);
+        set.publish();
+    }
+    done = true;
+    readers.clear();
+
+    EXPECT_EQ(torn.load(), 0);
+    set.reclaim();
+    EXPECT_EQ(set.pending_reclaim(), 0);
+}
+
+// ============================================================================
+// Concurrent Set Tests
+// ============================================================================
+
+TEST(ConcurrentSparseSetTest, BasicOperations) {
+    concurrent_sparse_set<int> set(6);
+    EXPECT_EQ(set.shard_count(), 8);
+    EXPECT_TRUE(set.empty());
+
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(set.insert(i));
+    }
+    EXPECT_FALSE(set.insert(10));
+    EXPECT_FALSE(set.emplace(20));
+    EXPECT_EQ(set.size(), 1000);
+    EXPECT_TRUE(set.contains(999));
+    EXPECT_EQ(set.count(1000), 0);
+
+    EXPECT_EQ(set.erase(999), 1);
+    EXPECT_EQ(set.erase(999), 0);
+    EXPECT_FALSE(set.contains(999));
+
+    long long sum = 0;
+    set.for_each([&](int val) { sum += val; });
+    EXPECT_EQ(sum, 998LL * 999 / 2);
+
+    set.clear();
+    EXPECT_TRUE(set.empty());
+}
+
+TEST(ConcurrentSparseSetTest, ParallelInsertAndForEach) {
+    concurrent_sparse_set<int> set;
+    set.reserve(40000);
+
+    // Overlapping ranges, so the same key races in from two threads
+    std::vector<std::jthread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&set, t] {
+            for (int i = t * 5000; i < t * 5000 + 10000; ++i) {
+                set.insert(i);
+            }
+        });
+    }
+    writers.clear();
+    EXPECT_EQ(set.size(), 25000);
+
+    std::atomic<long long> sum{0};
+    std::atomic<int>       visited{0};
+    set.for_each(
+        [&](int val) {
+            sum += val;
+            visited++;
+        },
+        4
+    );
+    EXPECT_EQ(visited.load(), 25000);
+    EXPECT_EQ(sum.load(), 24999LL * 25000 / 2);
+}
+
+TEST(ConcurrentSparseSetTest, HashesEachValueOnce) {
+    concurrent_sparse_set<std::string, CountingHash> set(4);
+
+    CountingHash::calls = 0;
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(set.insert(std::to_string(i)));
+    }
+    EXPECT_EQ(CountingHash::calls, 10);
+
+    CountingHash::calls = 0;
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(set.contains(std::to_string(i)), i < 10);
+    }
+    EXPECT_EQ(set.erase("3"), 1);
+    EXPECT_EQ(CountingHash::calls, 21);
+
+    concurrent_sparse_key_set<std::string, int, CountingHash> map(4);
+    CountingHash::calls = 0;
+    EXPECT_TRUE(map.try_emplace("a", 1));
+    EXPECT_FALSE(map.insert_or_assign("a", 2));
+    EXPECT_EQ(map.find("a"), 2);
+    EXPECT_TRUE(map.visit("a", [](int &val) { val++; }));
+    EXPECT_TRUE(map.contains("a"));
+    EXPECT_EQ(map.erase("a"), 1);
+    EXPECT_EQ(CountingHash::calls, 6);
+}
+
+TEST(ConcurrentSparseKeySetTest, BasicOperations) {
+    concurrent_sparse_key_set<std::string, int> map(4);
+
+    EXPECT_TRUE(map.insert("a", 1));
+    EXPECT_FALSE(map.insert("a", 2));
+    EXPECT_TRUE(map.try_emplace("b", 2));
+    EXPECT_FALSE(map.insert_or_assign("a", 10));
+    EXPECT_TRUE(map.insert_or_assign("c", 3));
+
+    EXPECT_EQ(map.find("a"), 10);
+    EXPECT_EQ(map.find("z"), std::nullopt);
+    EXPECT_TRUE(map.visit("b", [](int &val) { val *= 10; }));
+    EXPECT_FALSE(map.visit("z", [](int &) {}));
+    EXPECT_EQ(map.find("b"), 20);
+
+    std::vector<std::pair<std::string, int>> seen;
+    map.for_each([&](const std::string &key, int val) { seen.emplace_back(key, val); });
+    std::ranges::sort(seen);
+    EXPECT_EQ(seen, (std::vector<std::pair<std::string, int>>{{"a", 10}, {"b", 20}, {"c", 3}}));
+
+    EXPECT_EQ(map.erase("a"), 1);
+    EXPECT_FALSE(map.contains("a"));
+    EXPECT_EQ(map.size(), 2);
+}
+
+TEST(ConcurrentSparseKeySetTest, ParallelCounters) {
+    concurrent_sparse_key_set<int, int> counters;
+    for (int key = 0; key < 64; ++key) {
+        counters.insert(key, 0);
+    }
+
+    std::vector<std::jthread> workers;
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&counters] {
+            for (int i = 0; i < 6400; ++i) {
+                counters.visit(i % 64, [](int &val) { val++; });
+            }
+        });
+    }
+    workers.clear();
+
+    for (int key = 0; key < 64; ++key) {
+        EXPECT_EQ(counters.find(key), 400);
+    }
+}
+
+// ============================================================================
+// Lock-Free Set Tests
+// ============================================================================
+
+TEST(LockFreeSparseSetTest, BasicOperations) {
+    lockfree_sparse_set<std::string> set(4);
+
+    EXPECT_TRUE(set.insert("apple"));
+    EXPECT_FALSE(set.insert("apple"));
+    std::string banana = "banana";
+    EXPECT_TRUE(set.insert(banana));
+    EXPECT_TRUE(set.emplace(size_t{3}, 'c'));
+    EXPECT_FALSE(set.emplace("ccc"));
+
+    EXPECT_TRUE(set.contains("banana"));
+    EXPECT_EQ(set.count("ccc"), 1);
+    EXPECT_FALSE(set.contains("durian"));
+    EXPECT_EQ(set.size(), 3);
+
+    std::vector<std::string> order;
+    set.for_each([&](const std::string &val) { order.push_back(val); });
+    EXPECT_EQ(order, (std::vector<std::string>{"apple", "banana", "ccc"}));
+}
+
+TEST(LockFreeSparseSetTest, GrowsThroughManyTables) {
+    lockfree_sparse_set<int> set(0);
+    size_t                   initial = set.sparse_size();
+
+    for (int i = 0; i < 100000; ++i) {
+        EXPECT_TRUE(set.insert(i));
+    }
+    EXPECT_GT(set.sparse_size(), initial);
+    EXPECT_EQ(set.size(), 100000);
+    for (int i = 0; i < 100000; ++i) {
+        ASSERT_TRUE(set.contains(i));
+        ASSERT_FALSE(set.insert(i));
+    }
+    EXPECT_FALSE(set.contains(100000));
+}
+
+TEST(LockFreeSparseSetTest, ParallelDeduplication) {
+    // Every thread inserts the same overlapping keys while the index keeps growing underneath
+    lockfree_sparse_set<int>  set(16);
+    std::atomic<int>          inserted{0};
+    std::vector<std::jthread> workers;
+    for (int t = 0; t < 8; ++t) {
+        workers.emplace_back([&set, &inserted, t] {
+            for (int i = 0; i < 20000; ++i) {
+                int val = (i * 7 + t * 1000) % 30000;
+                if (set.insert(val)) inserted++;
+                EXPECT_TRUE(set.contains(val));
+            }
+        });
+    }
+    workers.clear();
+
+    std::unordered_set<int> expected;
+    for (int t = 0; t < 8; ++t) {
+        for (int i = 0; i < 20000; ++i) {
+            expected.insert((i * 7 + t * 1000) % 30000);
+        }
+    }
+    EXPECT_EQ(set.size(), expected.size());
+    EXPECT_EQ(static_cast<size_t>(inserted.load()), expected.size());
+
+    std::vector<std::atomic<int>> seen(30000);
+    set.for_each([&](int val) { seen[static_cast<size_t>(val)]++; }, 4);
+    for (int val = 0; val < 30000; ++val) {
+        ASSERT_EQ(seen[static_cast<size_t>(val)].load(), expected.contains(val) ? 1 : 0);
+    }
+}
+
+// ============================================================================
+// Stateful Hasher Tests
+// ============================================================================
+
+struct ModHash {
+    int  mod;
+    auto operator()(int value) const -> size_t { return std::hash<int>{}(value % mod); }
+};
+
+struct ModEqual {
+    int  mod;
+    auto operator()(int lhs, int rhs) const -> bool { return lhs % mod == rhs % mod; }
+};
+
+TEST(SparseSetStatefulHashTest, UsesAndSwapsInstanceFunctors) {
+    sparse_set<int, ModHash, ModEqual> set(64, ModHash{10}, ModEqual{10});
+    EXPECT_EQ(set.hash_function().mod, 10);
+    EXPECT_EQ(set.key_eq().mod, 10);
+
+    EXPECT_TRUE(set.insert(3).second);
+    EXPECT_FALSE(set.insert(13).second);
+    EXPECT_TRUE(set.contains(23));
+
+    sparse_set<int, ModHash, ModEqual> other(0, ModHash{7}, ModEqual{7});
+    other.insert(3);
+    swap(set, other);
+    EXPECT_EQ(set.key_eq().mod, 7);
+    EXPECT_TRUE(set.contains(10));
+    EXPECT_FALSE(set.contains(13));
+    EXPECT_TRUE(other.contains(13));
+}
+
+TEST(SparseSetStatefulHashTest, EmptyFunctorsTakeNoSpace) {
+    EXPECT_EQ(
+        sizeof(sparse_set<int, seeded_hash<int>>),
+        sizeof(sparse_set<int>) + sizeof(seeded_hash<int>)
+    );
+}
+
+TEST(SparseSetStatefulHashTest, SeededHashIsPerInstance) {
+    seeded_hash<std::string> fixed(1, 2);
+    EXPECT_EQ(fixed("key"), seeded_hash<std::string>(1, 2)("key"));
+    EXPECT_NE(fixed("key"), seeded_hash<std::string>(1, 3)("key"));
+    EXPECT_NE(seeded_hash<int>()(42), seeded_hash<int>()(42));
+
+    sparse_set<std::string, seeded_hash<std::string>> set;
+    for (int i = 0; i < 1000; ++i) {
+        set.insert(std::to_string(i));
+    }
+    sparse_set<std::string, seeded_hash<std::string>> copy = set;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(copy.contains(std::to_string(i)));
+    }
+    EXPECT_FALSE(copy.contains("1000"));
+}
+
+TEST(SparseKeySetStatefulHashTest, UsesInstanceFunctors) {
+    sparse_key_set<int, std::string, ModHash, ModEqual> map(0, ModHash{100}, ModEqual{100});
+    map.insert(1, "one");
+    map[101] = "hundred and one";
+    EXPECT_EQ(map.size(), 1);
+    EXPECT_EQ(map.at(201), "hundred and one");
+    EXPECT_EQ(map.hash_function().mod, 100);
+}
+
+// ============================================================================
+// Transparent Lookup Tests
+// ============================================================================
+
+TEST(SparseSetTransparentTest, StringViewLookup) {
+    sparse_set<std::string, string_hash, std::equal_to<>> set;
+    set.insert("apple");
+    set.insert("banana");
+
+    std::string_view banana = "banana";
+    EXPECT_TRUE(set.contains(banana));
+    EXPECT_TRUE(set.contains("apple"));
+    EXPECT_FALSE(set.contains(std::string_view("cherry")));
+    EXPECT_EQ(set.count(banana), 1);
+    EXPECT_EQ(*set.find(banana), "banana");
+
+    const auto &cset = set;
+    EXPECT_EQ(cset.find(std::string_view("cherry")), cset.end());
+
+    EXPECT_EQ(set.erase(banana), 1);
+    EXPECT_EQ(set.erase("banana"), 0);
+    EXPECT_EQ(set.size(), 1);
+}
+
+TEST(SparseKeySetTransparentTest, StringViewAccess) {
+    sparse_key_set<std::string, int, string_hash, std::equal_to<>> map;
+    map.insert("one", 1);
+
+    std::string_view one = "one";
+    EXPECT_EQ(map.at(one), 1);
+    EXPECT_THROW(map.at(std::string_view("two")), std::out_of_range);
+    EXPECT_TRUE(map.contains(one));
+
+    map[std::string_view("two")] = 2;
+    map[one]                     = 10;
+    EXPECT_EQ(map.size(), 2);
+    EXPECT_EQ(map.at("two"), 2);
+    EXPECT_EQ(map.at(one), 10);
+
+    EXPECT_EQ(map.erase(one), 1);
+    EXPECT_FALSE(map.contains("one"));
+}
+
+// ============================================================================
+// Batched Lookup Tests
+// ============================================================================
+
+TEST(SparseSetBatchTest, ContainsAndFindMany) {
+    sparse_set<int> set;
+    set.rehash_step(2);
+    for (int i = 0; i < 500; i += 2) {
+        set.insert(i);
+    }
+
+    std::vector<int> keys;
+    for (int i = 0; i < 101; ++i) {
+        keys.push_back(i * 5);
+    }
+    std::array<bool, 101>                  hits{};
+    std::vector<sparse_set<int>::iterator> found(keys.size());
+    set.contains_many(keys, hits);
+    set.find_many(keys, found);
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        EXPECT_EQ(hits[i], set.contains(keys[i]));
+        EXPECT_EQ(found[i], set.find(keys[i]));
+    }
+
+    std::array<bool, 4> short_out{};
+    EXPECT_THROW(set.contains_many(keys, short_out), std::invalid_argument);
+}
+
+TEST(SparseKeySetBatchTest, FindMany) {
+    sparse_key_set<std::string, int> map;
+    for (int i = 0; i < 300; ++i) {
+        map.insert(std::to_string(i), i);
+    }
+
+    std::vector<std::string> keys;
+    for (int i = 250; i < 350; ++i) {
+        keys.push_back(std::to_string(i));
+    }
+    const auto &cmap = map;
+    std::vector<sparse_key_set<std::string, int>::const_iterator> found(keys.size());
+    cmap.find_many(keys, found);
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i < 50) {
+            ASSERT_NE(found[i], cmap.end());
+            EXPECT_EQ(*found[i], static_cast<int>(i) + 250);
+        } else {
+            EXPECT_EQ(found[i], cmap.end());
+        }
+    }
+}
+
+// ============================================================================
+// Lazy Construction Tests
+// ============================================================================
+
+struct Counted {
+    static inline int constructions = 0;
+
+    int value;
+
+    Counted(int v) : value(v) { ++constructions; }
+    Counted(const Counted &other) : value(other.value) { ++constructions; }
+    Counted(Counted &&other) noexcept : value(other.value) {}
+    auto operator=(const Counted &) -> Counted & = default;
+    auto operator=(Counted &&) noexcept -> Counted & = default;
+};
+
+struct CountedHash {
+    using is_transparent = void;
+    auto operator()(const Counted &c) const -> size_t { return std::hash<int>{}(c.value); }
+    auto operator()(int v) const -> size_t { return std::hash<int>{}(v); }
+};
+
+struct CountedEqual {
+    using is_transparent = void;
+    auto operator()(const Counted &a, const Counted &b) const -> bool {
+        return a.value == b.value;
+    }
+    auto operator()(const Counted &a, int b) const -> bool { return a.value == b; }
+    auto operator()(int a, const Counted &b) const -> bool { return a == b.value; }
+};
+
+TEST(SparseKeySetLazyTest, TryEmplace) {
+    sparse_key_set<int, Counted> map;
+    Counted::constructions = 0;
+
+    auto [it, inserted] = map.try_emplace(1, 10);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(it->value, 10);
+    EXPECT_EQ(Counted::constructions, 1);
+
+    auto [dup, dup_inserted] = map.try_emplace(1, 20);
+    EXPECT_FALSE(dup_inserted);
+    EXPECT_EQ(dup, it);
+    EXPECT_EQ(dup->value, 10);
+    EXPECT_EQ(Counted::constructions, 1);
+}
+
+TEST(SparseKeySetLazyTest, InsertOrAssign) {
+    sparse_key_set<std::string, int, string_hash, std::equal_to<>> map;
+
+    auto [it, inserted] = map.insert_or_assign("a", 1);
+    EXPECT_TRUE(inserted);
+    EXPECT_EQ(*it, 1);
+
+    auto [again, again_inserted] = map.insert_or_assign(std::string_view("a"), 2);
+    EXPECT_FALSE(again_inserted);
+    EXPECT_EQ(again, it);
+    EXPECT_EQ(map.at("a"), 2);
+    EXPECT_EQ(map.size(), 1);
+
+    std::string key = "b";
+    EXPECT_TRUE(map.insert_or_assign(std::move(key), 3).second);
+    EXPECT_EQ(map.at("b"), 3);
+}
+
+TEST(SparseSetLazyTest, TransparentEmplaceSkipsDuplicates) {
+    sparse_set<Counted, CountedHash, CountedEqual> set;
+    Counted::constructions = 0;
+
+    EXPECT_TRUE(set.emplace(5).second);
+    EXPECT_EQ(Counted::constructions, 1);
+
+    auto [it, inserted] = set.emplace(5);
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ(it->value, 5);
+    EXPECT_EQ(Counted::constructions, 1);
+    EXPECT_EQ(set.size(), 1);
+}
+
+// ============================================================================
+// Slot Policy Tests
+// ============================================================================
+
+template <class Policy>
+class SparseSetSlotPolicyTest : public ::testing::Test {};
+
+using SlotPolicies = ::testing::Types<modulo_slot_policy, mask_slot_policy, fibonacci_slot_policy>;
+TYPED_TEST_SUITE(SparseSetSlotPolicyTest, SlotPolicies);
+
+TYPED_TEST(SparseSetSlotPolicyTest, InsertFindErase) {
+    sparse_set<int, std::hash<int>, std::equal_to<int>, std::allocator<int>, TypeParam> set;
+    for (int i = 0; i < 1000; ++i) {
+        set.insert(i * 64);
+    }
+    for (int i = 0; i < 1000; i += 3) {
+        EXPECT_EQ(set.erase(i * 64), 1);
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(set.contains(i * 64), i % 3 != 0);
+    }
+    EXPECT_EQ(set.sparse_size(), TypeParam::valid_size(set.sparse_size()));
+}
+
+TYPED_TEST(SparseSetSlotPolicyTest, RehashRoundsToValidSize) {
+    sparse_key_set<int, int, std::hash<int>, std::equal_to<int>, std::allocator<int>, TypeParam>
+        map;
+    map.insert({1, 10});
+    map.rehash(100);
+
+    EXPECT_EQ(map.sparse_size(), TypeParam::valid_size(100));
+    EXPECT_EQ(map.at(1), 10);
+}
+
+// ============================================================================
+// Dense Storage Tests
+// ============================================================================
+
+template <class T>
+using segmented_set = sparse_set<
+    T, std::hash<T>, std::equal_to<T>, std::allocator<T>, fibonacci_slot_policy, false,
+    segmented_storage<16>>;
+
+TEST(SegmentedVectorTest, GrowthNeverMovesElements) {
+    segmented_vector<std::string, std::allocator<std::string>, 8> vec;
+    vec.push_back("first");
+    const std::string *first = &vec[0];
+
+    for (int i = 1; i < 1000; ++i) {
+        vec.emplace_back(std::to_string(i));
+    }
+    EXPECT_EQ(&vec[0], first);
+    EXPECT_EQ(vec.size(), 1000);
+    EXPECT_EQ(vec.capacity(), 1000);
+    EXPECT_EQ(vec.segment_count(), 125);
+
+    vec.pop_back();
+    EXPECT_EQ(vec.back(), "998");
+    vec.clear();
+    EXPECT_TRUE(vec.empty());
+    EXPECT_EQ(vec.capacity(), 1000);
+    vec.shrink_to_fit();
+    EXPECT_EQ(vec.capacity(), 0);
+}
+
+TEST(SegmentedVectorTest, RandomAccessIterators) {
+    segmented_vector<int, std::allocator<int>, 4> vec;
+    for (int i = 0; i < 37; ++i) {
+        vec.push_back(36 - i);
+    }
+    static_assert(std::random_access_iterator<decltype(vec.begin())>);
+
+    std::sort(vec.begin(), vec.end());
+    EXPECT_TRUE(std::is_sorted(vec.cbegin(), vec.cend()));
+    EXPECT_EQ(vec.end() - vec.begin(), 37);
+    EXPECT_EQ(vec.begin()[9], 9);
+    EXPECT_EQ(*vec.rbegin(), 36);
+
+    segmented_vector<int, std::allocator<int>, 4> copy(vec);
+    EXPECT_TRUE(std::equal(copy.begin(), copy.end(), vec.begin(), vec.end()));
+}
+
+// Memory resource that fails the test when asked to free a block it never handed out
+struct tracking_resource : std::pmr::memory_resource {
+    std::set<void *> live;
+
+    ~tracking_resource() override { EXPECT_TRUE(live.empty()); }
+
+    auto do_allocate(size_t bytes, size_t align) -> void * override {
+        void *ptr = std::pmr::new_delete_resource()->allocate(bytes, align);
+        live.insert(ptr);
+        return ptr;
+    }
+    auto do_deallocate(void *ptr, size_t bytes, size_t align) -> void override {
+        EXPECT_EQ(live.erase(ptr), 1);
+        std::pmr::new_delete_resource()->deallocate(ptr, bytes, align);
+    }
+    auto do_is_equal(const std::pmr::memory_resource &other) const noexcept -> bool override {
+        return this == &other;
+    }
+};
+
+TEST(SegmentedVectorTest, MoveAssignAcrossUnequalAllocators) {
+    using pmr_vector = segmented_vector<int, std::pmr::polymorphic_allocator<int>, 4>;
+    static_assert(!std::is_nothrow_move_assignable_v<pmr_vector>);
+    static_assert(std::is_nothrow_move_assignable_v<segmented_vector<int>>);
+
+    tracking_resource first;
+    tracking_resource second;
+    {
+        pmr_vector target(&first);
+        pmr_vector source(&second);
+        for (int i = 0; i < 37; ++i) {
+            source.push_back(i);
+        }
+
+        // polymorphic_allocator never propagates, so the elements must move into first
+        target = std::move(source);
+        EXPECT_EQ(target.get_allocator().resource(), &first);
+        EXPECT_EQ(target.size(), 37);
+        EXPECT_EQ(target.back(), 36);
+        EXPECT_TRUE(source.empty());
+
+        pmr_vector same(&first);
+        same = std::move(target);
+        EXPECT_EQ(same.size(), 37);
+        EXPECT_EQ(target.segment_count(), 0);
+    }
+}
+
+TEST(SegmentedStorageTest, SparseSetOperations) {
+    segmented_set<int> set;
+    for (int i = 0; i < 1000; ++i) {
+        set.insert(i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        EXPECT_EQ(set.erase(i), 1);
+    }
+
+    EXPECT_EQ(set.size(), 500);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(set.contains(i), i % 2 == 1);
+    }
+    EXPECT_EQ(*set.find(501), 501);
+    EXPECT_EQ(std::accumulate(set.begin(), set.end(), 0), 250000);
+
+    segmented_set<int> copy = set;
+    EXPECT_EQ(copy.size(), 500);
+    EXPECT_TRUE(copy.contains(999));
+}
+
+TEST(SegmentedStorageTest, ValueReferencesSurviveInserts) {
+    sparse_key_set<
+        int, std::string, std::hash<int>, std::equal_to<int>, std::allocator<std::string>,
+        fibonacci_slot_policy, false, segmented_storage<16>>
+        map;
+    map.insert({0, "zero"});
+    const std::string *zero = &map.at(0);
+
+    for (int i = 1; i < 5000; ++i) {
+        map.insert({i, std::to_string(i)});
+    }
+    EXPECT_EQ(&map.at(0), zero);
+    EXPECT_EQ(map.at(4321), "4321");
+}
+
+// ============================================================================
+// Small Set Tests
+// ============================================================================
+
+TEST(SmallSetTest, BuildsIndexOncePastSmallSize) {
+    sparse_set<int> set;
+    EXPECT_FALSE(set.indexed());
+    EXPECT_EQ(set.sparse_size(), 0);
+
+    for (int i = 0; i < SMALL_SET_SIZE; ++i) {
+        EXPECT_TRUE(set.insert(i).second);
+        EXPECT_FALSE(set.insert(i).second);
+    }
+    EXPECT_FALSE(set.indexed());
+    EXPECT_EQ(set.size(), SMALL_SET_SIZE);
+
+    set.insert(SMALL_SET_SIZE);
+    EXPECT_TRUE(set.indexed());
+    for (int i = 0; i <= SMALL_SET_SIZE; ++i) {
+        EXPECT_TRUE(set.contains(i));
+    }
+    EXPECT_FALSE(set.contains(SMALL_SET_SIZE + 1));
+}
+
+TEST(SmallSetTest, EraseAndFindWithoutIndex) {
+    sparse_set<std::string> set;
+    set.insert("a");
+    set.insert("b");
+    set.insert("c");
+
+    EXPECT_EQ(set.erase("a"), 1);
+    EXPECT_EQ(set.erase("a"), 0);
+    EXPECT_EQ(set.size(), 2);
+    EXPECT_EQ(*set.find("c"), "c");
+    EXPECT_EQ(set.find("a"), set.end());
+
+    set.erase(set.find("b"));
+    EXPECT_EQ(set.size(), 1);
+    EXPECT_EQ(*set.begin(), "c");
+
+    std::array<std::string, 3> keys{"a", "b", "c"};
+    bool                       found[3];
+    set.contains_many(keys, found);
+    EXPECT_FALSE(found[0]);
+    EXPECT_FALSE(found[1]);
+    EXPECT_TRUE(found[2]);
+    EXPECT_FALSE(set.indexed());
+}
+
+TEST(SmallSetTest, KeySetWithoutIndex) {
+    sparse_key_set<int, std::string> map;
+    map.insert({1, "one"});
+    map.insert({2, "two"});
+    EXPECT_FALSE(map.insert({1, "uno"}).second);
+    EXPECT_FALSE(map.insert_or_assign(2, "dos").second);
+    EXPECT_FALSE(map.indexed());
+
+    EXPECT_EQ(map.at(1), "one");
+    EXPECT_EQ(map.at(2), "dos");
+    EXPECT_THROW(map.at(3), std::out_of_range);
+    EXPECT_EQ(map.erase(1), 1);
+    EXPECT_FALSE(map.contains(1));
+    EXPECT_EQ(map.at(2), "dos");
+
+    for (int i = 10; i < 100; ++i) {
+        map.insert({i, std::to_string(i)});
+    }
+    EXPECT_TRUE(map.indexed());
+    EXPECT_EQ(map.at(2), "dos");
+    EXPECT_EQ(map.at(42), "42");
+}
+
+TEST(SmallSetTest, InlineStorageKeepsElementsInObject) {
+    sparse_set<
+        std::string, std::hash<std::string>, std::equal_to<std::string>,
+        std::allocator<std::string>, fibonacci_slot_policy, false, inline_storage<4>>
+        set;
+    set.insert("x");
+    set.insert("y");
+    const auto *object = reinterpret_cast<const std::byte *>(&set);
+    const auto *first  = reinterpret_cast<const std::byte *>(&*set.begin());
+    EXPECT_TRUE(first >= object && first < object + sizeof(set));
+
+    for (int i = 0; i < 100; ++i) {
+        set.insert(std::to_string(i));
+    }
+    EXPECT_EQ(set.size(), 102);
+    EXPECT_TRUE(set.contains("y"));
+    EXPECT_TRUE(set.contains("57"));
+
+    auto moved = std::move(set);
+    EXPECT_EQ(moved.size(), 102);
+    EXPECT_TRUE(moved.contains("x"));
+}
+
+TEST(SmallSetTest, InlineStorageKeepsKeysInObject) {
+    using inline_key_set = sparse_key_set<
+        int, std::string, std::hash<int>, std::equal_to<int>,
+        std::pmr::polymorphic_allocator<std::string>, fibonacci_slot_policy, false,
+        inline_storage<SMALL_SET_SIZE>>;
+
+    tracking_resource resource;
+    {
+        inline_key_set map(0, {}, {}, &resource);
+        for (int i = 0; i < SMALL_SET_SIZE; ++i) {
+            map.insert(i, std::to_string(i));
+        }
+        EXPECT_FALSE(map.indexed());
+        EXPECT_TRUE(resource.live.empty());
+
+        const auto *object = reinterpret_cast<const std::byte *>(&map);
+        const auto *keys   = reinterpret_cast<const std::byte *>(map.keys().data());
+        EXPECT_TRUE(keys >= object && keys < object + sizeof(map));
+
+        map.insert(SMALL_SET_SIZE, "indexed");
+        EXPECT_TRUE(map.indexed());
+        EXPECT_FALSE(resource.live.empty());
+        EXPECT_EQ(map.at(3), "3");
+    }
+}
+
+TEST(SmallVectorTest, SpillsToHeapAndBack) {
+    small_vector<std::string, 2> vec;
+    vec.push_back("a");
+    vec.push_back("b");
+    EXPECT_TRUE(vec.is_inline());
+    vec.push_back(vec[0]);
+    EXPECT_FALSE(vec.is_inline());
+    EXPECT_EQ(vec.back(), "a");
+
+    small_vector<std::string, 2> copy(vec);
+    EXPECT_TRUE(std::equal(copy.begin(), copy.end(), vec.begin(), vec.end()));
+
+    small_vector<std::string, 2> small;
+    small.push_back("z");
+    small.swap(vec);
+    EXPECT_EQ(small.size(), 3);
+    EXPECT_TRUE(vec.is_inline());
+    EXPECT_EQ(vec[0], "z");
+}
+
+TEST(SmallVectorTest, MoveAssignAcrossUnequalAllocators) {
+    using pmr_vector = small_vector<int, 2, std::pmr::polymorphic_allocator<int>>;
+    static_assert(!std::is_nothrow_move_assignable_v<pmr_vector>);
+    static_assert(std::is_nothrow_move_assignable_v<small_vector<int, 2>>);
+
+    tracking_resource first;
+    tracking_resource second;
+    {
+        pmr_vector target(&first);
+        pmr_vector source(&second);
+        for (int i = 0; i < 9; ++i) {
+            source.push_back(i);
+        }
+
+        // polymorphic_allocator never propagates, so the elements must move into first
+        target = std::move(source);
+        EXPECT_EQ(target.get_allocator().resource(), &first);
+        EXPECT_EQ(target.size(), 9);
+        EXPECT_EQ(target.back(), 8);
+        EXPECT_TRUE(source.empty());
+
+        source.push_back(-1);
+        source.swap(target);
+        EXPECT_EQ(source.size(), 9);
+        EXPECT_EQ(target.size(), 1);
+        EXPECT_EQ(target.get_allocator().resource(), &first);
+
+        pmr_vector same(&second);
+        same = std::move(source);
+        EXPECT_EQ(same.size(), 9);
+        EXPECT_TRUE(source.is_inline());
+    }
+}
+
+// ============================================================================
+// Binary Image Tests
+// ============================================================================
+
+TEST(BinaryImageTest, ImageRoundTripKeepsIndex) {
+    sparse_set<int> set;
+    for (int i = 0; i < 1000; ++i) {
+        set.insert(i * 7);
+    }
+    set.erase(14);
+
+    std::stringstream stream;
+    set.save(stream);
+    sparse_set<int> loaded;
+    loaded.load(stream);
+
+    EXPECT_EQ(loaded.size(), set.size());
+    EXPECT_EQ(loaded.sparse_size(), set.sparse_size());
+    EXPECT_TRUE(std::equal(loaded.begin(), loaded.end(), set.begin(), set.end()));
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(loaded.contains(i * 7), i != 2);
+    }
+    EXPECT_FALSE(loaded.contains(3));
+
+    loaded.insert(-1);
+    loaded.erase(0);
+    EXPECT_TRUE(loaded.contains(-1));
+    EXPECT_FALSE(loaded.contains(0));
+}
+
+TEST(BinaryImageTest, CompactImageRebuildsIndex) {
+    sparse_set<int, std::hash<int>, std::equal_to<int>, std::allocator<int>,
+               fibonacci_slot_policy, true>
+        set;
+    for (int i = 0; i < 500; ++i) {
+        set.insert(i);
+    }
+
+    std::stringstream image;
+    std::stringstream compact;
+    set.save(image);
+    set.save(compact, sparse_image_encoding::compact);
+    EXPECT_LT(compact.str().size(), image.str().size());
+
+    decltype(set) loaded;
+    loaded.load(compact);
+    EXPECT_TRUE(std::equal(loaded.begin(), loaded.end(), set.begin(), set.end()));
+    for (int i = 0; i < 500; ++i) {
+        EXPECT_TRUE(loaded.contains(i));
+    }
+
+    decltype(set) from_image;
+    from_image.load(image);
+    EXPECT_EQ(from_image.sparse_size(), set.sparse_size());
+    EXPECT_TRUE(from_image.contains(499));
+}
+
+TEST(BinaryImageTest, KeySetAndSmallSet) {
+    struct point {
+        int x, y;
+    };
+    sparse_key_set<int, point> map;
+    for (int i = 0; i < 100; ++i) {
+        map.insert({i, point{i, -i}});
+    }
+    std::stringstream stream;
+    map.save(stream);
+    sparse_key_set<int, point> loaded;
+    loaded.load(stream);
+    EXPECT_EQ(loaded.size(), 100);
+    EXPECT_EQ(loaded.at(42).y, -42);
+    EXPECT_FALSE(loaded.contains(100));
+
+    sparse_key_set<int, point> small;
+    small.insert({5, point{1, 2}});
+    std::stringstream small_stream;
+    small.save(small_stream);
+    loaded.load(small_stream);
+    EXPECT_FALSE(loaded.indexed());
+    EXPECT_EQ(loaded.size(), 1);
+    EXPECT_EQ(loaded.at(5).x, 1);
+
+    // A key set image does not load into a plain set
+    std::stringstream keyed;
+    map.save(keyed);
+    sparse_set<int> set;
+    EXPECT_THROW(set.load(keyed), std::runtime_error);
+}
+
+TEST(BinaryImageTest, CorruptImageLeavesSetUnchanged) {
+    sparse_set<int> set;
+    for (int i = 0; i < 100; ++i) {
+        set.insert(i);
+    }
+    std::stringstream stream;
+    set.save(stream);
+    std::string bytes = stream.str();
+
+    sparse_set<int> target;
+    target.insert(-5);
+    for (size_t at : {size_t{0}, size_t{20}, bytes.size() / 2, bytes.size() - 1}) {
+        std::string corrupt = bytes;
+        corrupt[at] = static_cast<char>(corrupt[at] ^ 0x40);
+        std::stringstream in(corrupt);
+        EXPECT_THROW(target.load(in), std::runtime_error);
+        EXPECT_EQ(target.size(), 1);
+        EXPECT_TRUE(target.contains(-5));
+    }
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 9));
+    EXPECT_THROW(target.load(truncated), std::runtime_error);
+    EXPECT_TRUE(target.contains(-5));
+}
+
+TEST(BinaryImageTest, DifferentHasherRebuildsIndex) {
+    sparse_set<int, seeded_hash<int>> set;
+    for (int i = 0; i < 1000; ++i) {
+        set.insert(i);
+    }
+    std::stringstream stream;
+    set.save(stream);
+
+    // Seeded per instance, so the saved index does not match this set's hasher
+    sparse_set<int, seeded_hash<int>> loaded;
+    loaded.load(stream);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(loaded.contains(i));
+    }
+    EXPECT_FALSE(loaded.contains(1000));
+}
+
+TEST(BinaryImageTest, OutOfRangeIndexRebuildsIndex) {
+    sparse_set<int> set;
+    for (int i = 0; i < 100; ++i) {
+        set.insert(i);
+    }
+    std::stringstream stream;
+    set.save(stream);
+    std::string bytes = stream.str();
+
+    // Point every entry far past the elements, then reseal the image so only the index is wrong
+    size_t entries_at = sizeof(sparse_image_header) + set.size() * (sizeof(int) + sizeof(size_t));
+    for (size_t hashed = 0; hashed < set.sparse_size(); ++hashed) {
+        char        *raw = bytes.data() + entries_at + hashed * sizeof(sparse_entry);
+        sparse_entry entry;
+        std::memcpy(&entry, raw, sizeof(entry));
+        if (entry.dist != 0) entry.pos = sparse_entry::pos_type{1} << 30U;
+        std::memcpy(raw, &entry, sizeof(entry));
+    }
+    size_t payload = bytes.size() - sizeof(sparse_image_header) - sizeof(std::uint64_t);
+    sparse_image_checksum checksum;
+    checksum.update(bytes.data() + sizeof(sparse_image_header), payload);
+    std::uint64_t value = checksum.value();
+    std::memcpy(bytes.data() + bytes.size() - sizeof(value), &value, sizeof(value));
+
+    std::stringstream in(bytes);
+    sparse_set<int>   loaded;
+    loaded.load(in);
+    EXPECT_EQ(loaded.size(), 100);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(loaded.contains(i));
+    }
+    EXPECT_FALSE(loaded.contains(100));
+    loaded.erase(50);
+    EXPECT_FALSE(loaded.contains(50));
+    EXPECT_TRUE(loaded.contains(99));
+}
+
+#ifdef SPARSE_IMAGE_FD
+TEST(BinaryImageTest, FileDescriptorRoundTrip) {
+    sparse_set<unsigned> set;
+    for (unsigned i = 0; i < 10'000; ++i) {
+        set.insert(i * 3);
+    }
+
+    std::FILE *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+    int fd = fileno(file);
+    set.save(fd);
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+
+    sparse_set<unsigned> loaded;
+    loaded.load(fd);
+    std::fclose(file);
+
+    EXPECT_EQ(loaded.size(), set.size());
+    EXPECT_TRUE(loaded.contains(29'997));
+    EXPECT_FALSE(loaded.contains(29'998));
+}
+#endif
+
+// ============================================================================
+// Mapped Arena Tests
+// ============================================================================
+
+using mapped_key_set = sparse_key_set<
+    std::uint64_t, std::uint64_t, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>,
+    mapped_allocator<std::uint64_t>>;
+
+// Arena file removed again when the test ends
+struct arena_file {
+    std::filesystem::path path;
+
+    explicit arena_file(const std::string &name)
+        : path(std::filesystem::temp_directory_path()
+               / ("sparse-arena-" + std::to_string(::getpid()) + "-" + name)) {
+        std::filesystem::remove(path);
+    }
+    ~arena_file() { std::filesystem::remove(path); }
+};
+
+static auto arena_root(mapped_arena &arena) -> mapped_key_set & {
+    return arena.root<mapped_key_set>(
+        size_t{0}, std::hash<std::uint64_t>{}, std::equal_to<std::uint64_t>{},
+        arena.get_allocator<std::uint64_t>()
+    );
+}
+
+TEST(MappedArenaTest, ReopenedSetKeepsContents) {
+    arena_file file("reopen");
+    {
+        mapped_arena arena(file.path, size_t{1} << 30U);
+        EXPECT_FALSE(arena.reopened());
+        mapped_key_set &map = arena_root(arena);
+        for (std::uint64_t i = 0; i < 100'000; ++i) {
+            map.insert({i, i * i});
+        }
+        map.erase(7);
+        arena.sync();
+    }
+    {
+        mapped_arena arena(file.path);
+        EXPECT_TRUE(arena.reopened());
+        mapped_key_set &map = arena_root(arena);
+        EXPECT_EQ(map.size(), 99'999);
+        EXPECT_EQ(map.at(300), 90'000);
+        EXPECT_FALSE(map.contains(7));
+
+        // Growth after reopening keeps extending the same file
+        size_t file_size = arena.file_size();
+        for (std::uint64_t i = 100'000; i < 400'000; ++i) {
+            map.insert({i, i});
+        }
+        EXPECT_GT(arena.file_size(), file_size);
+        EXPECT_EQ(map.at(399'999), 399'999);
+    }
+    mapped_arena arena(file.path);
+    EXPECT_EQ(arena_root(arena).size(), 399'999);
+}
+
+TEST(MappedArenaTest, FreedBlocksAreReused) {
+    arena_file   file("reuse");
+    mapped_arena arena(file.path, size_t{1} << 30U);
+
+    size_t used = 0;
+    for (int round = 0; round < 5; ++round) {
+        mapped_key_set map(0, {}, {}, arena.get_allocator<std::uint64_t>());
+        for (std::uint64_t i = 0; i < 50'000; ++i) {
+            map.insert({i, i});
+        }
+        if (round == 0) used = arena.used();
+    }
+    EXPECT_EQ(arena.used(), used);
+}
+
+TEST(MappedArenaTest, RejectsSecondOpenAndOtherRootType) {
+    arena_file file("lock");
+    {
+        mapped_arena arena(file.path, size_t{1} << 30U);
+        arena_root(arena).insert({1, 2});
+        EXPECT_THROW(mapped_arena(file.path), std::system_error);
+    }
+    mapped_arena arena(file.path);
+    EXPECT_THROW(arena.root<std::uint64_t>(), std::runtime_error);
+    EXPECT_EQ(arena_root(arena).at(1), 2);
+}
+
+TEST(MappedArenaTest, CapacityExhaustedThrowsBadAlloc) {
+    arena_file   file("full");
+    mapped_arena arena(file.path, size_t{1} << 20U);
+
+    mapped_key_set &map  = arena_root(arena);
+    std::uint64_t   i    = 0;
+    auto            fill = [&] {
+        for (;; ++i) {
+            map.insert({i, i});
+        }
+    };
+    EXPECT_THROW(fill(), std::bad_alloc);
+    EXPECT_GT(i, 0);
+    EXPECT_EQ(map.size(), i);
+    EXPECT_TRUE(map.contains(i - 1));
+
+    // The bulk path must roll back the same way
+    arena_file   bulk_file("full-bulk");
+    mapped_arena bulk_arena(bulk_file.path, size_t{1} << 20U);
+
+    mapped_key_set                                    &bulk = arena_root(bulk_arena);
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> batch;
+    auto                                               fill_bulk = [&] {
+        for (std::uint64_t next = 0;; next += 100) {
+            batch.clear();
+            for (std::uint64_t k = next; k < next + 100; ++k) {
+                batch.emplace_back(k, k);
+            }
+            // Not a sized range, so nothing is reserved up front and each push may fail
+            bulk.insert_unique_unchecked(batch | std::views::filter([](auto &) { return true; }));
+        }
+    };
+    EXPECT_THROW(fill_bulk(), std::bad_alloc);
+    EXPECT_GT(bulk.size(), 0);
+    EXPECT_EQ(bulk.keys().size(), bulk.size());
+    for (std::uint64_t k = 0; k < bulk.size(); ++k) {
+        EXPECT_EQ(bulk.at(k), k);
+    }
+    EXPECT_FALSE(bulk.contains(bulk.size()));
+}
+
+// ============================================================================
+// Shared Set Tests
+// ============================================================================
+
+static auto shared_set_name(const std::string &name) -> std::string {
+    return "/sparse-test-" + std::to_string(::getpid()) + "-" + name;
+}
+
+TEST(SharedSetTest, ReaderSeesWriterUpdates) {
+    std::string name   = shared_set_name("updates");
+    auto        writer = shared_sparse_set<std::uint64_t>::create(name, size_t{1} << 30U);
+    for (std::uint64_t i = 0; i < 10'000; ++i) {
+        EXPECT_TRUE(writer.insert(i * 3));
+    }
+
+    // A second mapping of the segment, at another address
+    auto reader = shared_sparse_set<std::uint64_t>::open(name);
+    EXPECT_FALSE(reader.writable());
+    EXPECT_NE(&*reader.read(), &*writer.read());
+    EXPECT_EQ(reader.size(), 10'000);
+    EXPECT_TRUE(reader.contains(29'997));
+    EXPECT_FALSE(reader.contains(29'998));
+
+    // Grows the segment well past what was mapped in when the reader opened it
+    writer.erase(0);
+    for (std::uint64_t i = 100'000; i < 300'000; ++i) {
+        writer.insert(i);
+    }
+    {
+        auto set = reader.read();
+        EXPECT_EQ(set->size(), 209'999);
+        EXPECT_FALSE(set->contains(0));
+        EXPECT_TRUE(set->contains(299'999));
+        EXPECT_TRUE(std::equal(set->begin(), set->end(), writer.read()->begin()));
+    }
+    EXPECT_TRUE(shared_sparse_set<std::uint64_t>::remove(name));
+    EXPECT_TRUE(reader.contains(3));
+}
+
+TEST(SharedSetTest, ReaderInAnotherProcess) {
+    std::string name   = shared_set_name("fork");
+    auto        writer = shared_sparse_set<std::uint64_t>::create(name, size_t{1} << 30U);
+    for (std::uint64_t i = 0; i < 50'000; ++i) {
+        writer.insert(i * 2);
+    }
+
+    pid_t child = ::fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        auto reader = shared_sparse_set<std::uint64_t>::open(name);
+        bool ok     = reader.size() == 50'000 && reader.contains(99'998) && !reader.contains(1);
+        ::_exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    ASSERT_EQ(::waitpid(child, &status, 0), child);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    shared_sparse_set<std::uint64_t>::remove(name);
+}
+
+TEST(SharedSetTest, WriteAccessAndErrors) {
+    std::string name = shared_set_name("access");
+    EXPECT_THROW(shared_sparse_set<std::uint64_t>::open(name), std::system_error);
+
+    auto writer = shared_sparse_set<std::uint64_t>::create(name, size_t{1} << 30U);
+    writer.insert(1);
+
+    auto reader = shared_sparse_set<std::uint64_t>::open(name);
+    EXPECT_THROW(reader.insert(2), std::logic_error);
+    EXPECT_THROW(shared_sparse_set<std::uint32_t>::open(name), std::runtime_error);
+
+    // A second writer takes over updates through its own descriptor
+    auto takeover = shared_sparse_set<std::uint64_t>::open(name, true);
+    for (std::uint64_t i = 2; i < 100'000; ++i) {
+        takeover.insert(i);
+    }
+    takeover.update([](auto &set) { set.erase(50); });
+    EXPECT_EQ(reader.size(), 99'998);
+    EXPECT_FALSE(writer.contains(50));
+    writer.clear();
+    EXPECT_EQ(reader.size(), 0);
+    shared_sparse_set<std::uint64_t>::remove(name);
+}
+
+// ============================================================================
+// Stress Tests
+// ============================================================================
+
+TEST_F(SparseSetTest, LargeNumberOfInserts) {
+    const int N = 10000;
+    for (int i = 0; i < N; ++i) {
+        int_set.insert(i);
+    }
+
+    EXPECT_EQ(int_set.size(), N);
+
+    for (int i = 0; i < N; ++i) {
+        EXPECT_TRUE(int_set.contains(i));
+    }
+}
+
+TEST_F(SparseSetTest, InterleavedInsertAndErase) {
+    for (int i = 0; i < 100; ++i) {
+        int_set.insert(i);
+    }
+
+    for (int i = 0; i < 100; i += 2) {
+        int_set.erase(i);
+    }
+
+    EXPECT_EQ(int_set.size(), 50);
+
+    for (int i = 0; i < 100; ++i) {
+        if (i % 2 == 0) {
+            EXPECT_FALSE(int_set.contains(i));
+        } else {
+            EXPECT_TRUE(int_set.contains(i));
+        }
+    }
+}
+
+TEST_F(SparseSetTest, RandomOperations) {
+    std::unordered_set<int> reference;
+
+    for (int i = 0; i < 1000; ++i) {
+        int val = i % 200;
+
+        if (i % 3 == 0) {
+            auto [it, sparse_result] = int_set.insert(val);
+            bool ref_result          = reference.insert(val).second;
+            EXPECT_EQ(sparse_result, ref_result);
+        } else if (i % 3 == 1) {
+            EXPECT_EQ(int_set.contains(val), reference.count(val) > 0);
+        } else {
+            size_t sparse_result = int_set.erase(val);
+            size_t ref_result    = reference.erase(val);
+            EXPECT_EQ(sparse_result, ref_result);
+        }
+    }
+
+    EXPECT_EQ(int_set.size(), reference.size());
+}
+
+// ============================================================================
+// Edge Cases
+// ============================================================================
+
+TEST_F(SparseSetTest, InsertEraseInsertSameValue) {
+    int_set.insert(42);
+    int_set.erase(42);
+    auto [it, inserted] = int_set.insert(42);
+
+    EXPECT_TRUE(inserted);
+    EXPECT_TRUE(int_set.contains(42));
+    EXPECT_EQ(int_set.size(), 1);
+}
+
+TEST_F(SparseSetTest, MultipleErasesOfSameValue) {
+    int_set.insert(42);
+    EXPECT_EQ(int_set.erase(42), 1);
+    EXPECT_EQ(int_set.erase(42), 0);
+    EXPECT_EQ(int_set.erase(42), 0);
+}
+
+TEST_F(SparseSetTest, EmptyAfterClearingAllElements) {
+    for (int i = 0; i < 10; ++i) {
+        int_set.insert(i);
+    }
+
+    for (int i = 0; i < 10; ++i) {
+        int_set.erase(i);
+    }
+
+    EXPECT_EQ(int_set.size(), 0);
+    EXPECT_TRUE(int_set.empty());
+
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_FALSE(int_set.contains(i));
+    }
+}
+
+TEST_F(SparseSetTest, InsertAfterClear) {
+    int_set.insert(1);
+    int_set.insert(2);
+    int_set.clear();
+    int_set.insert(3);
+
+    EXPECT_EQ(int_set.size(), 1);
+    EXPECT_TRUE(int_set.contains(3));
+    EXPECT_FALSE(int_set.contains(1));
+    EXPECT_FALSE(int_set.contains(2));
+}
+
+// ============================================================================
+// Custom Types Tests
+// ============================================================================
+
+struct CustomType {
+    int         x;
+    std::string s;
+
+    bool operator==(const CustomType &other) const { return x == other.x && s == other.s; }
+};
+
+template <>
+struct std::hash<CustomType> {
+    size_t operator()(const CustomType &ct) const {
+        return std::hash<int>{}(ct.x) ^ std::hash<std::string>{}(ct.s);
+    }
+};
+
+TEST(SparseSetCustomTypeTest, CustomTypeOperations) {
+    sparse_set<CustomType> custom_set;
+
+    CustomType obj1{42, "hello"};
+    CustomType obj2{99, "world"};
+    CustomType obj3{42, "hello"}; // Same as obj1
+
+    auto [it1, ins1] = custom_set.insert(obj1);
+    auto [it2, ins2] = custom_set.insert(obj2);
+    auto [it3, ins3] = custom_set.insert(obj3);
+
+    EXPECT_TRUE(ins1 && ins2);
+    EXPECT_FALSE(ins3);
+
+    EXPECT_EQ(custom_set.size(), 2);
+    EXPECT_TRUE(custom_set.contains(obj1));
+    EXPECT_TRUE(custom_set.contains(obj2));
+    EXPECT_TRUE(custom_set.contains(obj3));
+
+    EXPECT_EQ(custom_set.erase(obj1), 1);
+    EXPECT_FALSE(custom_set.contains(obj1));
+    EXPECT_EQ(custom_set.size(), 1);
+}
+
+TEST(SparseSetCustomTypeTest, CustomTypeIteration) {
+    sparse_set<CustomType> custom_set;
+
+    custom_set.insert({1, "a"});
+    custom_set.insert({2, "b"});
+    custom_set.insert({3, "c"});
+
+    std::vector<CustomType> values;
+    for (const auto &obj : custom_set) {
+        values.push_back(obj);
+    }
+
+    EXPECT_EQ(values.size(), 3);
+}
+
+TEST(SparseSetCustomTypeTest, CustomTypeFind) {
+    sparse_set<CustomType> custom_set;
+
+    CustomType obj1{10, "test"};
+    CustomType obj2{20, "data"};
+
+    custom_set.insert(obj1);
+    custom_set.insert(obj2);
+
+    auto it = custom_set.find(obj1);
+    EXPECT_NE(it, custom_set.end());
+    EXPECT_EQ(it->x, 10);
+    EXPECT_EQ(it->s, "test");
+
+    CustomType obj3{99, "missing"};
+    auto       it2 = custom_set.find(obj3);
+    EXPECT_EQ(it2, custom_set.end());
+}
+
+// ============================================================================
+// Performance Characteristics Tests
+// ============================================================================
+
+TEST_F(SparseSetTest, DensePackingProperty) {
+    // Insert elements
+    for (int i = 0; i < 10; ++i) {
+        int_set.insert(i);
+    }
+
+    // Erase some elements
     int_set.erase(2);
     int_set.erase(5);
     int_set.erase(7);
@@ -1486,6 +3246,7 @@ TEST_F(SparseKeySetTest, InsertDuplicate) {
     int_map.insert({1, 100});
     auto [it, inserted] = int_map.insert({1, 200});
     EXPECT_FALSE(inserted);
+    EXPECT_EQ(*it, 100);
     EXPECT_EQ(int_map.at(1), 100);
 }
 
@@ -1600,6 +3361,21 @@ TEST_F(SparseKeySetTest, EraseMultiple) {
     EXPECT_TRUE(int_map.contains(3));
 }
 
+TEST_F(SparseKeySetTest, EraseIterator) {
+    for (int i = 0; i < 50; ++i) {
+        int_map.insert(i, i * 100);
+    }
+
+    auto it = int_map.erase(int_map.find(5));
+    EXPECT_EQ(*it, 4900);
+    int_map.erase(int_map.begin() + 10, int_map.begin() + 20);
+    EXPECT_EQ(int_map.size(), 39);
+    EXPECT_FALSE(int_map.contains(5));
+    for (const auto &value : int_map) {
+        EXPECT_EQ(int_map.at(value / 100), value);
+    }
+}
+
 TEST_F(SparseKeySetTest, Clear) {
     int_map.insert({1, 100});
     int_map.insert({2, 200});
@@ -1654,10 +3430,29 @@ TEST_F(SparseKeySetTest, Reserve) {
     EXPECT_GE(int_map.capacity(), 100);
 }
 
+TEST_F(SparseKeySetTest, InsertUniqueUnchecked) {
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < 3000; ++i) {
+        pairs.emplace_back(i, i * 2);
+    }
+    int_map.insert_unique_unchecked(pairs);
+
+    EXPECT_EQ(int_map.size(), 3000);
+    for (int i = 0; i < 3000; ++i) {
+        EXPECT_EQ(int_map.at(i), i * 2);
+    }
+
+    int_map.insert_range(pairs);
+    EXPECT_EQ(int_map.size(), 3000);
+}
+
 TEST_F(SparseKeySetTest, Rehash) {
     int_map.insert({1, 100});
+    int_map.rehash(INIT_SPARSE_SIZE);
+    ASSERT_TRUE(int_map.indexed());
     size_t old_sparse_size = int_map.sparse_size();
     int_map.rehash(old_sparse_size * 2);
+    EXPECT_TRUE(int_map.indexed());
     EXPECT_EQ(int_map.sparse_size(), old_sparse_size * 2);
     EXPECT_TRUE(int_map.contains(1));
 }
@@ -1732,6 +3527,431 @@ TEST_F(SparseKeySetTest, LargeInsertionAndErasure) {
     EXPECT_TRUE(int_map.contains(600));
 }
 
+// ============================================================================
+// GROUP SPARSE SET
+// ============================================================================
+
+TEST(GroupSparseSetTest, InsertFindErase) {
+    group_sparse_set<int> set;
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(set.insert(i).second);
+    }
+    EXPECT_FALSE(set.insert(10).second);
+    EXPECT_EQ(set.size(), 1000);
+
+    for (int i = 0; i < 1000; i += 2) {
+        EXPECT_EQ(set.erase(i), 1);
+    }
+    EXPECT_EQ(set.erase(0), 0);
+
+    EXPECT_EQ(set.size(), 500);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(set.contains(i), i % 2 == 1);
+        if (i % 2 == 1) {
+            EXPECT_EQ(*set.find(i), i);
+        }
+    }
+}
+
+TEST(GroupSparseSetTest, MatchesSparseSetIterationOrder) {
+    sparse_set<int>       robin_hood;
+    group_sparse_set<int> grouped;
+    for (int i = 0; i < 300; ++i) {
+        robin_hood.insert(i * 7);
+        grouped.insert(i * 7);
+    }
+    for (int i = 0; i < 300; i += 3) {
+        robin_hood.erase(i * 7);
+        grouped.erase(i * 7);
+    }
+
+    EXPECT_TRUE(std::equal(robin_hood.begin(), robin_hood.end(), grouped.begin(), grouped.end()));
+}
+
+TEST(GroupSparseSetTest, TombstoneChurn) {
+    group_sparse_set<int> set;
+    for (int round = 0; round < 50; ++round) {
+        for (int i = 0; i < 100; ++i) {
+            set.insert(round * 100 + i);
+        }
+        for (int i = 0; i < 100; ++i) {
+            set.erase(round * 100 + i);
+        }
+    }
+
+    EXPECT_TRUE(set.empty());
+    EXPECT_LE(set.sparse_size(), 256);
+    EXPECT_FALSE(set.contains(4999));
+}
+
+TEST(GroupSparseSetTest, CollidingHashes) {
+    group_sparse_set<int, ConstantHash> set;
+    for (int i = 0; i < 100; ++i) {
+        set.insert(i);
+    }
+    for (int i = 0; i < 100; i += 4) {
+        set.erase(i);
+    }
+
+    EXPECT_EQ(set.size(), 75);
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(set.contains(i), i % 4 != 0);
+    }
+}
+
+TEST(GroupSparseSetTest, CopySwapAndStrings) {
+    group_sparse_set<std::string> a;
+    a.insert({"alpha", "beta", "gamma"});
+    a.emplace("delta");
+
+    group_sparse_set<std::string> b(a);
+    b.erase("alpha");
+    swap(a, b);
+
+    EXPECT_EQ(a.size(), 3);
+    EXPECT_EQ(b.size(), 4);
+    EXPECT_FALSE(a.contains("alpha"));
+    EXPECT_TRUE(b.contains("alpha"));
+    EXPECT_EQ(a.count("delta"), 1);
+}
+
+TEST(GroupSparseSetTest, DuplicateInsertReturnsExisting) {
+    group_sparse_set<std::string, CountingHash> set;
+    set.insert({"alpha", "beta", "gamma"});
+
+    // Each insert probes once, so it hashes once while the table does not grow
+    CountingHash::calls = 0;
+    auto [it, inserted] = set.insert("beta");
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ(it, set.find("beta"));
+    EXPECT_EQ(*set.emplace("gamma").first, "gamma");
+    EXPECT_FALSE(set.emplace("gamma").second);
+    CountingHash::calls = 0;
+    EXPECT_TRUE(set.insert("delta").second);
+    EXPECT_EQ(CountingHash::calls, 1);
+    EXPECT_EQ(set.size(), 4);
+
+    group_sparse_set<std::string, CountingHash> moved(std::move(set));
+    EXPECT_FALSE(set.contains("delta"));
+    EXPECT_EQ(set.find("delta"), set.end());
+    set.clear();
+    EXPECT_FALSE(set.contains("delta"));
+    EXPECT_EQ(set.find("delta"), set.end());
+    EXPECT_TRUE(set.insert("after move").second);
+    EXPECT_EQ(set.insert("after move").first, set.begin());
+    EXPECT_TRUE(moved.contains("delta"));
+}
+
+TEST(GroupSparseKeySetTest, MatchesSparseKeySet) {
+    sparse_key_set<int, std::string>       robin_hood;
+    group_sparse_key_set<int, std::string> grouped;
+    for (int i = 0; i < 300; ++i) {
+        robin_hood.insert(i * 7, std::to_string(i));
+        grouped.insert(i * 7, std::to_string(i));
+    }
+    for (int i = 0; i < 300; i += 3) {
+        robin_hood.erase(i * 7);
+        EXPECT_EQ(grouped.erase(i * 7), 1);
+    }
+
+    EXPECT_TRUE(std::equal(robin_hood.begin(), robin_hood.end(), grouped.begin(), grouped.end()));
+    EXPECT_TRUE(std::ranges::equal(robin_hood.keys(), grouped.keys()));
+    EXPECT_EQ(grouped.at(7), "1");
+    EXPECT_THROW((void)grouped.at(0), std::out_of_range);
+}
+
+TEST(GroupSparseKeySetTest, TryEmplaceAndAssign) {
+    group_sparse_key_set<std::string, int> set;
+    EXPECT_TRUE(set.try_emplace("a", 1).second);
+    EXPECT_FALSE(set.try_emplace("a", 2).second);
+    EXPECT_EQ(set.at("a"), 1);
+
+    EXPECT_FALSE(set.insert_or_assign("a", 3).second);
+    EXPECT_TRUE(set.insert_or_assign("b", 4).second);
+    set["c"] += 5;
+
+    EXPECT_EQ(set.size(), 3);
+    EXPECT_EQ(set.at("a"), 3);
+    EXPECT_EQ(*set.find("b"), 4);
+    EXPECT_EQ(set.at("c"), 5);
+    EXPECT_EQ(set.find("d"), set.end());
+}
+
+TEST(GroupSparseKeySetTest, InsertOrAssignProbesOnce) {
+    group_sparse_key_set<std::string, int, CountingHash> set;
+    set.try_emplace("a", 1);
+
+    CountingHash::calls = 0;
+    auto [it, inserted] = set.insert_or_assign("a", 2);
+    EXPECT_FALSE(inserted);
+    EXPECT_EQ(*it, 2);
+    EXPECT_TRUE(set.insert_or_assign("b", 3).second);
+    EXPECT_EQ(set.try_emplace("b", 4).first, set.find("b"));
+    EXPECT_EQ(CountingHash::calls, 4);
+    EXPECT_EQ(set.at("b"), 3);
+}
+
+TEST(GroupSparseKeySetTest, LookupAfterMove) {
+    group_sparse_key_set<std::string, int> set;
+    set.try_emplace("a", 1);
+
+    group_sparse_key_set<std::string, int> moved(std::move(set));
+    EXPECT_FALSE(set.contains("a"));
+    EXPECT_EQ(set.find("a"), set.end());
+    set.clear();
+    EXPECT_FALSE(set.contains("a"));
+    EXPECT_EQ(set.find("a"), set.end());
+    EXPECT_TRUE(set.try_emplace("b", 2).second);
+    EXPECT_EQ(set.at("b"), 2);
+    EXPECT_EQ(moved.at("a"), 1);
+}
+
+// ============================================================================
+// DIRECT SPARSE SET
+// ============================================================================
+
+TEST(DirectSparseSetTest, InsertFindErase) {
+    direct_sparse_set<unsigned> set;
+    for (unsigned i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(set.insert(i * 3).second);
+    }
+    EXPECT_FALSE(set.insert(30).second);
+    EXPECT_EQ(set.size(), 1000);
+    EXPECT_GE(set.sparse_size(), 2998);
+
+    for (unsigned i = 0; i < 1000; i += 2) {
+        EXPECT_EQ(set.erase(i * 3), 1);
+    }
+    EXPECT_EQ(set.erase(0), 0);
+    EXPECT_EQ(set.erase(1u << 20), 0);
+
+    EXPECT_EQ(set.size(), 500);
+    for (unsigned i = 0; i < 3000; ++i) {
+        EXPECT_EQ(set.contains(i), i % 6 == 3);
+    }
+    EXPECT_EQ(*set.find(2997), 2997);
+    EXPECT_EQ(set.find(2998), set.end());
+}
+
+TEST(DirectSparseSetTest, MatchesSparseSetIterationOrder) {
+    sparse_set<unsigned>        hashed;
+    direct_sparse_set<unsigned> direct;
+    for (unsigned i = 0; i < 300; ++i) {
+        hashed.insert(i * 7);
+        direct.insert(i * 7);
+    }
+    for (unsigned i = 0; i < 300; i += 3) {
+        hashed.erase(i * 7);
+        direct.erase(i * 7);
+    }
+    direct.erase(direct.begin() + 5);
+    hashed.erase(hashed.begin() + 5);
+
+    EXPECT_TRUE(std::equal(hashed.begin(), hashed.end(), direct.begin(), direct.end()));
+}
+
+TEST(DirectSparseSetTest, StaleEntriesAfterClear) {
+    direct_sparse_set<std::uint16_t> set(64);
+    set.insert({5, 9, 40});
+    size_t covered = set.sparse_size();
+    set.clear();
+
+    EXPECT_TRUE(set.empty());
+    EXPECT_EQ(set.sparse_size(), covered);
+    EXPECT_FALSE(set.contains(5));
+    EXPECT_FALSE(set.contains(40));
+
+    set.insert(40);
+    EXPECT_TRUE(set.contains(40));
+    EXPECT_FALSE(set.contains(5));
+    EXPECT_FALSE(set.contains(9));
+    EXPECT_EQ(set.count(65535), 0);
+}
+
+TEST(DirectSparseSetTest, PagesFollowOccupiedRanges) {
+    direct_sparse_set<std::uint32_t, std::allocator<std::uint32_t>, vector_storage, 1024> set;
+    const std::uint32_t low  = 1024U * 976'562;
+    const std::uint32_t high = 1024U * 3'906'250;
+    for (std::uint32_t i = 0; i < 1024; ++i) {
+        set.insert(low + i * 2);
+        set.insert(high + i);
+    }
+    EXPECT_EQ(set.page_count(), 3);
+    EXPECT_GT(set.sparse_size(), size_t{high});
+    EXPECT_FALSE(set.contains(low + 1));
+    EXPECT_FALSE(set.contains(2'000'000'000));
+
+    auto copy = set;
+    for (std::uint32_t i = 0; i < 1024; ++i) {
+        set.erase(high + i);
+    }
+    EXPECT_EQ(set.page_count(), 2);
+    EXPECT_FALSE(set.contains(high));
+    EXPECT_TRUE(set.contains(low + 2046));
+
+    EXPECT_EQ(copy.page_count(), 3);
+    EXPECT_TRUE(copy.contains(high + 1023));
+    copy.clear();
+    EXPECT_EQ(copy.page_count(), 0);
+    EXPECT_FALSE(copy.contains(low));
+}
+
+TEST(DirectSparseSetTest, CopyAndSwap) {
+    direct_sparse_set<std::uint64_t> a;
+    a.insert_range(std::vector<std::uint64_t>{1, 2, 3, 100000});
+
+    direct_sparse_set<std::uint64_t> b(a);
+    b.erase(100000);
+    swap(a, b);
+
+    EXPECT_EQ(a.size(), 3);
+    EXPECT_EQ(b.size(), 4);
+    EXPECT_FALSE(a.contains(100000));
+    EXPECT_TRUE(b.contains(100000));
+}
+
+TEST(DirectSparseSetTest, MoveAssignAcrossUnequalAllocators) {
+    using pmr_alloc = std::pmr::polymorphic_allocator<std::uint32_t>;
+    using pmr_pages = paged_array<std::uint32_t, pmr_alloc>;
+    using pmr_set   = direct_sparse_set<std::uint32_t, pmr_alloc>;
+    static_assert(!std::is_nothrow_move_assignable_v<pmr_pages>);
+    static_assert(std::is_nothrow_move_assignable_v<paged_array<std::uint32_t>>);
+    static_assert(!std::is_nothrow_move_assignable_v<pmr_set>);
+
+    tracking_resource first;
+    tracking_resource second;
+    {
+        pmr_set target(16, &first);
+        pmr_set source(16, &second);
+        for (std::uint32_t i = 0; i < 100; ++i) {
+            source.insert(i * 5000);
+        }
+
+        // polymorphic_allocator never propagates, so the pages must be copied into first
+        target = std::move(source);
+        EXPECT_EQ(target.size(), 100);
+        EXPECT_EQ(target.page_count(), 100);
+        EXPECT_TRUE(target.contains(495'000));
+        EXPECT_FALSE(target.contains(5001));
+        EXPECT_EQ(source.page_count(), 0);
+
+        pmr_set copy(16, &second);
+        copy = target;
+        target.erase(0);
+        EXPECT_TRUE(copy.contains(0));
+        EXPECT_EQ(copy.page_count(), 100);
+    }
+}
+
+// ============================================================================
+// HANDLE KEY SET
+// ============================================================================
+
+TEST(HandleKeySetTest, StaleHandlesMissAfterReuse) {
+    handle_key_set<std::string> set;
+    auto                        first  = set.create("first");
+    auto                        second = set.create(size_t{3}, 'x');
+    EXPECT_EQ(first.index(), 0);
+    EXPECT_EQ(first.generation(), 1);
+    EXPECT_EQ(set.at(second), "xxx");
+
+    EXPECT_TRUE(set.destroy(first));
+    EXPECT_FALSE(set.destroy(first));
+    EXPECT_EQ(set.free_count(), 1);
+
+    auto reused = set.create("reused");
+    EXPECT_EQ(reused.index(), first.index());
+    EXPECT_EQ(reused.generation(), 2);
+    EXPECT_EQ(set.free_count(), 0);
+
+    EXPECT_FALSE(set.contains(first));
+    EXPECT_EQ(set.find(first), set.end());
+    EXPECT_THROW(set.at(first), std::out_of_range);
+    EXPECT_EQ(set.at(reused), "reused");
+    EXPECT_FALSE(set.contains(sparse_handle<>{}));
+}
+
+TEST(HandleKeySetTest, ClearRecyclesEveryIndex) {
+    handle_key_set<int, sparse_handle<std::uint32_t, 20>> set;
+    std::vector<sparse_handle<std::uint32_t, 20>>        old;
+    for (int i = 0; i < 100; ++i) {
+        old.push_back(set.create(i));
+    }
+    EXPECT_EQ(set.handles().size(), 100);
+    set.clear();
+    EXPECT_TRUE(set.empty());
+    EXPECT_EQ(set.free_count(), 100);
+
+    for (int i = 0; i < 100; ++i) {
+        auto handle = set.create(i);
+        EXPECT_LT(handle.index(), 100);
+        EXPECT_EQ(handle.generation(), 2);
+    }
+    for (auto handle : old) {
+        EXPECT_FALSE(set.contains(handle));
+    }
+    EXPECT_EQ(std::accumulate(set.begin(), set.end(), 0), 4950);
+}
+
+TEST(HandleKeySetTest, DoubleReleaseIsIgnored) {
+    handle_pool<> pool;
+    auto          handle = pool.acquire();
+    pool.release(handle);
+    pool.release(handle);
+    pool.release(sparse_handle<>{});
+    pool.release(sparse_handle<>(7, 1));
+    EXPECT_EQ(pool.free_count(), 1);
+
+    auto first  = pool.acquire();
+    auto second = pool.acquire();
+    EXPECT_NE(first, second);
+    EXPECT_NE(first.index(), second.index());
+
+    // A stale handle cannot release the live one now holding its index
+    pool.release(handle);
+    EXPECT_EQ(pool.free_count(), 0);
+}
+
+TEST(HandleKeySetTest, PoolClearInvalidatesIssuedHandles) {
+    using tiny_handle = sparse_handle<std::uint8_t, 6>;
+    handle_pool<tiny_handle> pool;
+    tiny_handle              live     = pool.acquire();
+    tiny_handle              released = pool.acquire();
+    tiny_handle              retired  = pool.acquire();
+    pool.release(released);
+    for (int round = 1; round < 3; ++round) {
+        pool.release(retired);
+        retired = pool.acquire();
+    }
+    EXPECT_EQ(retired.generation(), tiny_handle::max_generation);
+
+    pool.clear();
+    EXPECT_EQ(pool.free_count(), 2);
+    std::vector<tiny_handle> reissued{pool.acquire(), pool.acquire()};
+    for (tiny_handle old : {live, released, retired}) {
+        EXPECT_EQ(std::ranges::count(reissued, old), 0);
+    }
+    EXPECT_EQ(reissued[0], tiny_handle(live.index(), 2));
+    EXPECT_EQ(reissued[1], tiny_handle(released.index(), 3));
+    EXPECT_EQ(pool.acquire().index(), 3);
+}
+
+TEST(HandleKeySetTest, ExhaustedGenerationIsRetired) {
+    using tiny_handle = sparse_handle<std::uint8_t, 6>;
+    handle_pool<tiny_handle> pool;
+    tiny_handle              handle = pool.acquire();
+    for (int round = 1; round < 3; ++round) {
+        pool.release(handle);
+        handle = pool.acquire();
+        EXPECT_EQ(handle.index(), 0);
+    }
+    EXPECT_EQ(handle.generation(), tiny_handle::max_generation);
+
+    pool.release(handle);
+    EXPECT_EQ(pool.free_count(), 0);
+    EXPECT_EQ(pool.acquire().index(), 1);
+}
+
 // ============================================================================
 // Main
 // ============================================================================